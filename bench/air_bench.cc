@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "station.h"
+
+/* a deck of rooms x rooms rooms, each next to its neighbours across a
+ * single wall with a vent in it -- and every fourth wall an open door as
+ * well -- and one room vented to the outside: the cost of the first
+ * mix_air(), which finds the links, then of each one after, and of a door
+ * opening or closing between ticks.
+ */
+
+/* walls around every ROOM_SIZE^3 cell of the deck, on both sides; surfaces
+ * written directly, as build_station does */
+static ship_space *
+build_deck(int rooms)
+{
+    ship_space *ship = new ship_space;
+    glm::ivec3 extent = ROOM_SIZE * glm::ivec3(rooms, rooms, 1);
+
+    for (int z = 0; z < extent.z; z++) {
+        for (int y = 0; y < extent.y; y++) {
+            for (int x = 0; x < extent.x; x++) {
+                glm::ivec3 p(x, y, z);
+                block *bl = ship->ensure_block(p);
+                bl->type = block_support;
+
+                for (int face = 0; face < face_count; face++) {
+                    glm::ivec3 q = p + surface_index_to_normal(face);
+                    int axis = face >> 1;
+                    bool edge = (face & 1) ? p[axis] % ROOM_SIZE == 0 : q[axis] % ROOM_SIZE == 0;
+                    if (edge) {
+                        bl->surfs[face] = surface_wall;
+                        ship->ensure_block(q)->surfs[face ^ 1] = surface_wall;
+                    }
+                }
+            }
+        }
+    }
+
+    return ship;
+}
+
+/* put s on the wall between the block p and the one across face */
+static void
+put(ship_space *ship, glm::ivec3 p, int face, surface_type s)
+{
+    ship->get_block(p)->surfs[face] = s;
+    ship->get_block(p + surface_index_to_normal(face))->surfs[face ^ 1] = s;
+}
+
+static void
+run(int rooms)
+{
+    ship_space *ship = build_deck(rooms);
+
+    int n = 0;
+    for (int ry = 0; ry < rooms; ry++) {
+        for (int rx = 0; rx < rooms; rx++) {
+            glm::ivec3 p = ROOM_SIZE * glm::ivec3(rx, ry, 0) + glm::ivec3(ROOM_SIZE - 1, 3, 3);
+            glm::ivec3 q = ROOM_SIZE * glm::ivec3(rx, ry, 0) + glm::ivec3(3, ROOM_SIZE - 1, 3);
+            if (rx < rooms - 1) {
+                put(ship, p, surface_xp, surface_vent);
+                if (n++ % 4 == 0)
+                    put(ship, p + glm::ivec3(0, 1, 0), surface_xp, surface_door_open);
+            }
+            if (ry < rooms - 1) {
+                put(ship, q, surface_yp, surface_vent);
+                if (n++ % 4 == 0)
+                    put(ship, q + glm::ivec3(1, 0, 0), surface_yp, surface_door_open);
+            }
+        }
+    }
+    put(ship, glm::ivec3(3, 3, 0), surface_zm, surface_vent);
+    ship->rebuild_topology();
+
+    srand(1);
+    for (int ry = 0; ry < rooms; ry++) {
+        for (int rx = 0; rx < rooms; rx++) {
+            topo_info *t = topo_find(ship->get_topo_info(ROOM_SIZE * glm::ivec3(rx, ry, 0) + glm::ivec3(3)));
+            ship->insert_zone(t, (float)(rand() % 100) * t->size);
+        }
+    }
+
+    bench_timer t;
+    ship->mix_air();
+    double first = t.elapsed();
+
+    const int ticks = 100;
+    t = bench_timer();
+    for (int i = 0; i < ticks; i++) {
+        ship->mix_air();
+    }
+    double tick = t.elapsed() / ticks;
+
+    /* a door shutting and opening again between ticks */
+    glm::ivec3 door(ROOM_SIZE - 1, 4, 3);
+    t = bench_timer();
+    for (int i = 0; i < ticks; i++) {
+        ship->set_surface(door, door + glm::ivec3(1, 0, 0), surface_xp, surface_door);
+        ship->set_surface(door, door + glm::ivec3(1, 0, 0), surface_xp, surface_door_open);
+        ship->mix_air();
+    }
+    double toggled = t.elapsed() / ticks;
+
+    float total = 0;
+    for (auto const &z : ship->zones) {
+        total += z.air_amount;
+    }
+    bench_consume(total);
+
+    printf("%2dx%2d rooms, %5zu zones, %5zu links: first mix_air %7.3f ms, then %7.3f ms/tick; "
+           "door shut and opened between ticks %7.3f ms/tick\n",
+           rooms, rooms, ship->zones.size(), ship->links.a.size(),
+           first * 1e3, tick * 1e3, toggled * 1e3);
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    run(16);
+    run(32);
+    run(64);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <stdio.h>
+
+/* tiny helpers shared by the microbenchmarks in bench/
+ *
+ * these are plain executables (not registered with ctest); run them
+ * from bench_bin/ and read the output.
+ */
+
+struct bench_timer {
+    std::chrono::steady_clock::time_point start;
+
+    bench_timer() : start(std::chrono::steady_clock::now()) {}
+
+    /* seconds since construction */
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+/* keeps the optimizer from discarding a result we computed only to time it */
+template<typename T>
+static inline void
+bench_consume(T const &v)
+{
+    static volatile T sink;
+    sink = v;
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "station.h"
+
+/* neighbour walks over a large generated station: every block and each of
+ * its six neighbours, first through ship_space::get_block and then through
+ * a block_cursor. also times the passes which were ported to the cursor.
+ */
+
+static glm::ivec3 const dirs[] = {
+    glm::ivec3(1, 0, 0),
+    glm::ivec3(-1, 0, 0),
+    glm::ivec3(0, 1, 0),
+    glm::ivec3(0, -1, 0),
+    glm::ivec3(0, 0, 1),
+    glm::ivec3(0, 0, -1),
+};
+
+int
+main(void)
+{
+    ship_space *ship = build_station(16, 16, 2);
+    glm::ivec3 lo = CHUNK_SIZE * ship->mins;
+    glm::ivec3 hi = CHUNK_SIZE * (ship->maxs + glm::ivec3(1));
+
+    printf("station: %zu chunks\n", ship->chunks.size());
+
+    unsigned open_get = 0;
+    bench_timer t_get;
+    for (int z = lo.z; z < hi.z; z++) {
+        for (int y = lo.y; y < hi.y; y++) {
+            for (int x = lo.x; x < hi.x; x++) {
+                glm::ivec3 p(x, y, z);
+                for (int face = 0; face < face_count; face++) {
+                    block *bl = ship->get_block(p + dirs[face]);
+                    open_get += bl && air_permeable(bl->surfs[face ^ 1]);
+                }
+            }
+        }
+    }
+    double get_s = t_get.elapsed();
+
+    unsigned open_cur = 0;
+    bench_timer t_cur;
+    for (int z = lo.z; z < hi.z; z++) {
+        for (int y = lo.y; y < hi.y; y++) {
+            block_cursor cur(ship, glm::ivec3(lo.x, y, z));
+            for (int x = lo.x; x < hi.x; x++, cur.step(surface_xp)) {
+                for (int face = 0; face < face_count; face++) {
+                    block *bl = cur.neighbour(face).get();
+                    open_cur += bl && air_permeable(bl->surfs[face ^ 1]);
+                }
+            }
+        }
+    }
+    double cur_s = t_cur.elapsed();
+
+    bench_consume(open_get + open_cur);
+    if (open_get != open_cur)
+        printf("MISMATCH: %u vs %u\n", open_get, open_cur);
+
+    printf("neighbour walk: get_block %.2f ms, block_cursor %.2f ms (%.1fx)\n",
+            get_s * 1e3, cur_s * 1e3, get_s / cur_s);
+
+    bench_timer t_topo;
+    ship->rebuild_topology();
+    printf("rebuild_topology: %.2f ms\n", t_topo.elapsed() * 1e3);
+
+    bench_timer t_validate;
+    ship->validate();
+    printf("validate: %.2f ms\n", t_validate.elapsed() * 1e3);
+
+    raycast_info rc;
+    unsigned hits = 0;
+    bench_timer t_ray;
+    for (int i = 0; i < 1000000; i++) {
+        glm::vec3 o(4.5f + (i % 97), 4.5f + (i % 89), 4.5f);
+        glm::vec3 d = glm::normalize(glm::vec3((i % 7) - 3.1f, (i % 5) - 2.1f, (i % 3) - 1.1f));
+        ship->raycast(o, d, &rc);
+        hits += rc.hit;
+    }
+    bench_consume(hits);
+    printf("raycast: %.1f ns/ray\n", t_ray.elapsed() * 1e9 / 1000000);
+
+    delete ship;
+}
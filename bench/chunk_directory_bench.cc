@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "../src/ship_space.h"
+
+/* compares chunk lookup through the old hashed map against the dense
+ * chunk_directory, on cubic ships of 8, 512 and 32k chunks.
+ *
+ * lookups are a mix of hits and near misses (one chunk outside the ship
+ * on some axis), which is what the border passes in rebuild_topology and
+ * the raycast see.
+ */
+
+static const int num_lookups = 1 << 24;
+
+static void
+run(int side)
+{
+    std::unordered_map<glm::ivec3, chunk *, ivec3_hash> map;
+    chunk_directory dir;
+
+    /* the chunk pointers are never dereferenced; any distinct non-null value will do */
+    size_t n = 0;
+    for (int k = 0; k < side; k++) {
+        for (int j = 0; j < side; j++) {
+            for (int i = 0; i < side; i++) {
+                chunk *fake = (chunk *)(uintptr_t)(++n * 64);
+                map[glm::ivec3(i, j, k)] = fake;
+                dir.set(glm::ivec3(i, j, k), fake);
+            }
+        }
+    }
+
+    std::vector<glm::ivec3> probes(4096);
+    srand(side);
+    for (auto &p : probes) {
+        p = glm::ivec3(rand() % (side + 2) - 1, rand() % (side + 2) - 1, rand() % (side + 2) - 1);
+    }
+
+    size_t mask = probes.size() - 1;
+    uintptr_t acc = 0;
+
+    bench_timer t_map;
+    for (int i = 0; i < num_lookups; i++) {
+        auto it = map.find(probes[i & mask]);
+        if (it != map.end())
+            acc += (uintptr_t)it->second;
+    }
+    double map_s = t_map.elapsed();
+
+    bench_timer t_dir;
+    for (int i = 0; i < num_lookups; i++) {
+        acc += (uintptr_t)dir.get(probes[i & mask]);
+    }
+    double dir_s = t_dir.elapsed();
+
+    bench_consume(acc);
+
+    printf("%6zu chunks: unordered_map %6.2f ns/lookup, chunk_directory %6.2f ns/lookup (%.1fx)\n",
+            dir.size(),
+            map_s * 1e9 / num_lookups,
+            dir_s * 1e9 / num_lookups,
+            map_s / dir_s);
+}
+
+int
+main(void)
+{
+    run(2);     /* 8 chunks */
+    run(8);     /* 512 chunks */
+    run(32);    /* 32k chunks */
+}
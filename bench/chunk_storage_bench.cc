@@ -0,0 +1,42 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "station.h"
+
+/* block storage footprint and full-ship pass times, with every chunk
+ * expanded versus after compact_chunks() collapses the uniform ones.
+ */
+
+static void
+run(char const *name, ship_space *ship)
+{
+    for (auto ch : ship->chunks) {
+        ch.second->blocks.expand();
+    }
+
+    size_t dense_bytes = ship->block_memory_used();
+
+    bench_timer t_topo_dense;
+    ship->rebuild_topology();
+    double topo_dense = t_topo_dense.elapsed();
+
+    unsigned uniform = ship->compact_chunks();
+    size_t compact_bytes = ship->block_memory_used();
+
+    bench_timer t_topo_compact;
+    ship->rebuild_topology();
+    double topo_compact = t_topo_compact.elapsed();
+
+    printf("%s: %zu chunks, %u uniform\n", name, ship->chunks.size(), uniform);
+    printf("  block memory: %.2f MB expanded, %.2f MB compact\n",
+            dense_bytes / 1048576.0, compact_bytes / 1048576.0);
+    printf("  rebuild_topology: %.2f ms expanded, %.2f ms compact\n",
+            topo_dense * 1e3, topo_compact * 1e3);
+}
+
+int
+main(void)
+{
+    run("packed station", build_station(16, 16, 2));
+    run("sparse station", build_station(16, 16, 8, 4));
+}
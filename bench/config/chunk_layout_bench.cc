@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <stdio.h>
+
+#include "../bench.h"
+#include "../fake_mesh.h"
+#include "../station.h"
+
+/* the full-ship passes whose cost depends on how blocks and topo are laid
+ * out within a chunk: rebuild_topology, validate and chunk meshing.
+ *
+ * this is built once per layout (see CMakeLists.txt), with CHUNK_LAYOUT
+ * defined for the whole build; run each of the chunk_layout_bench_*
+ * binaries and compare.
+ */
+
+#define STR2(x) #x
+#define STR(x) STR2(x)
+
+#define REPS 5
+
+static void
+run(char const *name, ship_space *ship)
+{
+    mesh_parts scaffold(fake_scaffold_mesh());
+    sw_mesh *surfs[6];
+    for (int i = 0; i < 6; i++)
+        surfs[i] = fake_surface_mesh();
+
+    double topo = 1e9, valid = 1e9, mesh = 1e9;
+    size_t num_verts = 0;
+
+    std::vector<vertex> verts;
+    std::vector<unsigned> indices;
+
+    for (int rep = 0; rep < REPS; rep++) {
+        bench_timer t_topo;
+        ship->rebuild_topology();
+        topo = std::min(topo, t_topo.elapsed());
+
+        bench_timer t_valid;
+        bench_consume(ship->validate());
+        valid = std::min(valid, t_valid.elapsed());
+
+        num_verts = 0;
+        bench_timer t_mesh;
+        ship->update_seals();
+        for (auto ch : ship->chunks) {
+            verts.clear();
+            indices.clear();
+            chunk const *neighbours[face_count];
+            ship->get_mesh_neighbours(ch.first, neighbours);
+            ch.second->build_mesh(&scaffold, surfs, neighbours, &verts, &indices);
+            num_verts += verts.size();
+        }
+        mesh = std::min(mesh, t_mesh.elapsed());
+    }
+
+    printf("%s (%s): %zu chunks, %zu verts\n", name, STR(CHUNK_LAYOUT),
+            ship->chunks.size(), num_verts);
+    printf("  rebuild_topology: %.2f ms\n", topo * 1e3);
+    printf("  validate: %.2f ms\n", valid * 1e3);
+    printf("  build_mesh: %.2f ms\n", mesh * 1e3);
+}
+
+int
+main(void)
+{
+    mesher_init();
+
+    run("packed station", build_station(16, 16, 2));
+    run("sparse station", build_station(16, 16, 8, 4));
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <stdio.h>
+
+#include "../bench.h"
+#include "../fake_mesh.h"
+#include "../station.h"
+
+/* what the chunk size trades off: bigger chunks mean fewer draw calls and
+ * static rigid bodies (one per chunk with geometry), but more to remesh
+ * and re-upload when any block in the chunk is edited.
+ *
+ * this is built once per CHUNK_SIZE (see CMakeLists.txt); run each of the
+ * chunk_size_bench_* binaries and compare.
+ */
+
+#define REPS 5
+
+static void
+run(char const *name, ship_space *ship)
+{
+    mesh_parts scaffold(fake_scaffold_mesh());
+    sw_mesh *surfs[6];
+    for (int i = 0; i < 6; i++)
+        surfs[i] = fake_surface_mesh();
+
+    ship->compact_chunks();
+
+    double topo = 1e9, mesh_all = 1e9, mesh_worst = 0;
+    unsigned draw_calls = 0;
+
+    std::vector<vertex> verts;
+    std::vector<unsigned> indices;
+
+    for (int rep = 0; rep < REPS; rep++) {
+        bench_timer t_topo;
+        ship->rebuild_topology();
+        topo = std::min(topo, t_topo.elapsed());
+
+        draw_calls = 0;
+        bench_timer t_mesh_all;
+        ship->update_seals();
+        for (auto ch : ship->chunks) {
+            verts.clear();
+            indices.clear();
+
+            bench_timer t_mesh;
+            chunk const *neighbours[face_count];
+            ship->get_mesh_neighbours(ch.first, neighbours);
+            ch.second->build_mesh(&scaffold, surfs, neighbours, &verts, &indices);
+            mesh_worst = std::max(mesh_worst, t_mesh.elapsed());
+
+            draw_calls += !verts.empty();
+        }
+        mesh_all = std::min(mesh_all, t_mesh_all.elapsed());
+    }
+
+    size_t blocks = ship->block_memory_used();
+    size_t topo_bytes = 0;
+    for (auto ch : ship->chunks) {
+        topo_bytes += sizeof(ch.second->group) +
+                      ch.second->groups.size() * (sizeof(chunk_group) + sizeof(topo_info));
+        for (int face = 0; face < face_count; face++) {
+            topo_bytes += ch.second->portals[face].size() * sizeof(chunk_portal);
+        }
+    }
+    size_t directory = ship->chunks.entries.size() * sizeof(chunk *);
+
+    printf("%s (CHUNK_SIZE %d): %zu chunks\n", name, CHUNK_SIZE, ship->chunks.size());
+    printf("  draw calls / static bodies: %u\n", draw_calls);
+    printf("  memory: %.2f MB blocks, %.2f MB topo, %.2f KB directory\n",
+            blocks / 1048576.0, topo_bytes / 1048576.0, directory / 1024.0);
+    printf("  rebuild_topology: %.2f ms\n", topo * 1e3);
+    printf("  remesh whole ship: %.2f ms\n", mesh_all * 1e3);
+    printf("  remesh one chunk (edit latency): %.1f us avg, %.1f us worst\n",
+            mesh_all * 1e6 / std::max(draw_calls, 1u), mesh_worst * 1e6);
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    mesher_init();
+
+    run("packed station", build_station(16, 16, 2));
+    run("sparse station", build_station(16, 16, 8, 4));
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "station.h"
+
+/* a door from every room of a station out into the bulkheads, shut and
+ * opened over and over: the cost per door as it was done before, putting
+ * in a surface_door and taking it out again, against switching it between
+ * surface_door and surface_door_open, which leaves the topology alone. and
+ * the cost of a mix_air() with every door open.
+ */
+
+static void
+fill_with_air(ship_space *ship)
+{
+    for (auto ch : ship->chunks) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    topo_info *t = topo_find(ch.second->topo(x, y, z));
+                    if (t != &ship->outside_topo_info && !ship->get_zone_info(t))
+                        ship->insert_zone(t, t->size);
+                }
+            }
+        }
+    }
+}
+
+/* set the door out of every room to st, or take it out if st is
+ * surface_none */
+static void
+doors(ship_space *ship, int rooms, surface_type st)
+{
+    for (int deck = 0; deck < 2; deck++) {
+        for (int ry = 0; ry < rooms; ry++) {
+            for (int rx = 0; rx < rooms; rx++) {
+                glm::ivec3 a = ROOM_SIZE * glm::ivec3(rx, ry, deck) + glm::ivec3(ROOM_SIZE - 2, 3, 3);
+                ship->set_surface(a, a + glm::ivec3(1, 0, 0), surface_xp, st);
+            }
+        }
+    }
+}
+
+static void
+run(int rooms, int cycles)
+{
+    ship_space *ship = build_station(rooms, rooms, 2);
+    fill_with_air(ship);
+    int num_doors = 2 * rooms * rooms;
+
+    /* the old way: the door is a surface while shut, and nothing at all
+     * while open */
+    int rebuilds = ship->num_full_rebuilds;
+    int solves = ship->num_chunk_solves;
+    bench_timer t;
+    for (int i = 0; i < cycles; i++) {
+        doors(ship, rooms, surface_door);
+        doors(ship, rooms, surface_none);
+    }
+    double old_way = t.elapsed() / (2.0 * cycles * num_doors);
+    int old_solves = ship->num_chunk_solves - solves;
+
+    /* as a switchable edge */
+    doors(ship, rooms, surface_door);
+    solves = ship->num_chunk_solves;
+    t = bench_timer();
+    for (int i = 0; i < cycles; i++) {
+        doors(ship, rooms, surface_door_open);
+        doors(ship, rooms, surface_door);
+    }
+    double new_way = t.elapsed() / (2.0 * cycles * num_doors);
+    int new_solves = ship->num_chunk_solves - solves;
+
+    doors(ship, rooms, surface_door_open);
+    t = bench_timer();
+    for (int i = 0; i < cycles; i++) {
+        ship->mix_air();
+    }
+    double mix = t.elapsed() / cycles;
+
+    printf("%2dx%2d rooms, %4d doors: as a surface %7.2f us/door (%6d chunk solves); "
+           "switched %6.3f us/door (%d chunk solves); mix_air %7.3f ms; %d full rebuilds\n",
+           rooms, rooms, num_doors, old_way * 1e6, old_solves, new_way * 1e6, new_solves,
+           mix * 1e3, ship->num_full_rebuilds - rebuilds);
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    run(4, 20);
+    run(8, 20);
+    run(16, 10);
+    run(32, 4);
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "station.h"
+
+/* splitting every room on the bottom deck of a station in two, with a
+ * wall across its middle: first one surface at a time, then as a single
+ * edit transaction.
+ */
+
+static void
+fill_with_air(ship_space *ship)
+{
+    for (auto ch : ship->chunks) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    topo_info *t = topo_find(ch.second->topo(x, y, z));
+                    if (t != &ship->outside_topo_info && !ship->get_zone_info(t))
+                        ship->insert_zone(t, t->size);
+                }
+            }
+        }
+    }
+}
+
+static void
+split_rooms(ship_space *ship, int rooms_x, int rooms_y)
+{
+    for (int ry = 0; ry < rooms_y; ry++) {
+        for (int rx = 0; rx < rooms_x; rx++) {
+            glm::ivec3 room = ROOM_SIZE * glm::ivec3(rx, ry, 0);
+            for (int z = 1; z < ROOM_SIZE - 1; z++) {
+                for (int y = 1; y < ROOM_SIZE - 1; y++) {
+                    glm::ivec3 a = room + glm::ivec3(ROOM_SIZE / 2 - 1, y, z);
+                    ship->set_block_type(a, block_support);
+                    ship->set_surface(a, a + glm::ivec3(1, 0, 0), surface_xp, surface_wall);
+                }
+            }
+        }
+    }
+}
+
+static void
+run(char const *name, int rooms, bool batched)
+{
+    ship_space *ship = build_station(rooms, rooms, 2);
+    fill_with_air(ship);
+
+    int rebuilds = ship->num_full_rebuilds;
+
+    bench_timer t;
+    if (batched)
+        ship->begin_edit();
+    split_rooms(ship, rooms, rooms);
+    if (batched)
+        ship->commit();
+    double s = t.elapsed();
+
+    printf("  %-12s %8.2f ms, %5d full rebuilds, %zu zones\n", name, s * 1e3,
+            ship->num_full_rebuilds - rebuilds, ship->zones.size());
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    int sizes[] = { 4, 8, 16 };
+
+    for (int rooms : sizes) {
+        printf("%dx%d rooms, 2 decks, %d surfaces:\n", rooms, rooms,
+                rooms * rooms * (ROOM_SIZE - 2) * (ROOM_SIZE - 2));
+        run("one by one", rooms, false);
+        run("batched", rooms, true);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../src/mesh.h"
+
+/* stand-ins for the loaded scaffold and surface meshes, for benchmarking
+ * the mesher without assets or GL: only the vertex and index counts matter.
+ * sizes are roughly those of the real meshes.
+ */
+static inline sw_mesh *
+fake_mesh(unsigned num_vertices, unsigned num_indices)
+{
+    sw_mesh *m = new sw_mesh();
+    m->verts = new vertex[num_vertices];
+    m->indices = new unsigned[num_indices];
+    m->num_vertices = num_vertices;
+    m->num_indices = num_indices;
+
+    for (unsigned i = 0; i < num_indices; i++)
+        m->indices[i] = i % num_vertices;
+
+    return m;
+}
+
+/* the faces of the box lo..hi, each wound to face out, into m from vertex
+ * and index v and i */
+static inline void
+fake_box(sw_mesh *m, unsigned *v, unsigned *i, glm::vec3 lo, glm::vec3 hi)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        int u = (axis + 1) % 3, w = (axis + 2) % 3;
+
+        for (int side = 0; side < 2; side++) {
+            float c[4][2] = { { lo[u], lo[w] }, { hi[u], lo[w] }, { hi[u], hi[w] }, { lo[u], hi[w] } };
+            unsigned base = *v;
+
+            for (int k = 0; k < 4; k++) {
+                int n = side ? 3 - k : k;
+                vertex &out = m->verts[(*v)++];
+                glm::vec3 p;
+                p[axis] = side ? lo[axis] : hi[axis];
+                p[u] = c[n][0];
+                p[w] = c[n][1];
+                out.x = p.x; out.y = p.y; out.z = p.z;
+            }
+
+            unsigned const quad[] = { 0, 1, 2, 0, 2, 3 };
+            for (unsigned q : quad)
+                m->indices[(*i)++] = base + q;
+        }
+    }
+}
+
+/* twelve struts, 0.1 across, along the edges of the unit cube: the shape
+ * of the real scaffold, as the mesher leaves parts of it out by where they
+ * lie */
+static inline sw_mesh *
+fake_scaffold_mesh()
+{
+    sw_mesh *m = fake_mesh(12 * 24, 12 * 36);
+    unsigned v = 0, i = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        for (int corner = 0; corner < 4; corner++) {
+            glm::vec3 lo, hi;
+            lo[axis] = 0;
+            hi[axis] = 1;
+            for (int k = 0; k < 2; k++) {
+                int other = (axis + 1 + k) % 3;
+                lo[other] = (corner >> k & 1) ? 0.9f : 0;
+                hi[other] = lo[other] + 0.1f;
+            }
+            fake_box(m, &v, &i, lo, hi);
+        }
+    }
+
+    return m;
+}
+
+static inline sw_mesh *
+fake_surface_mesh()
+{
+    return fake_mesh(4, 6);
+}
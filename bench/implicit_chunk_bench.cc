@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <stdio.h>
+
+#include "bench.h"
+#include "station.h"
+
+/* ships whose bounding box is mostly empty, with the possibly-enclosed
+ * chunks left implicit versus all materialised (as ensure_chunk used to).
+ */
+
+#define REPS 5
+
+/* a long spine of chunks along x, with a mast at one end which stretches
+ * the bounding box up and out */
+static ship_space *
+build_spine(int length, int mast)
+{
+    ship_space *ship = new ship_space;
+
+    for (int x = 0; x < length; x++) {
+        ship->ensure_block(glm::ivec3(x * CHUNK_SIZE, 0, 0))->type = block_support;
+    }
+
+    for (int i = 1; i <= mast; i++) {
+        ship->ensure_block(CHUNK_SIZE * glm::ivec3(0, i, i))->type = block_support;
+    }
+
+    ship->rebuild_topology();
+    return ship;
+}
+
+static void
+materialise_all(ship_space *ship)
+{
+    for (int k = ship->mins.z + 1; k < ship->maxs.z; k++) {
+        for (int j = ship->mins.y + 1; j < ship->maxs.y; j++) {
+            for (int i = ship->mins.x + 1; i < ship->maxs.x; i++) {
+                ship->ensure_chunk(glm::ivec3(i, j, k));
+            }
+        }
+    }
+
+    ship->compact_chunks();
+}
+
+static void
+run(char const *name, ship_space *ship)
+{
+    double topo = 1e9, valid = 1e9;
+
+    for (int rep = 0; rep < REPS; rep++) {
+        bench_timer t_topo;
+        ship->rebuild_topology();
+        topo = std::min(topo, t_topo.elapsed());
+
+        bench_timer t_valid;
+        bench_consume(ship->validate());
+        valid = std::min(valid, t_valid.elapsed());
+    }
+
+    size_t bytes = ship->chunks.size() * sizeof(chunk) +
+        ship->block_memory_used() - ship->chunks.size() * sizeof(chunk_blocks);
+
+    printf("  %-12s %6zu chunks, %5zu implicit nodes, %7.2f MB, rebuild %7.2f ms, validate %6.2f ms\n",
+            name, ship->chunks.size(), ship->implicit_topo.size(), bytes / 1048576.0,
+            topo * 1e3, valid * 1e3);
+}
+
+int
+main(void)
+{
+    printf("spine of 64 chunks, 6 chunk mast:\n");
+    {
+        ship_space *ship = build_spine(64, 6);
+        run("implicit", ship);
+        materialise_all(ship);
+        run("materialised", ship);
+        delete ship;
+    }
+
+    printf("sparse station (16x16x8 room slots, every 4th built):\n");
+    {
+        ship_space *ship = build_station(16, 16, 8, 4);
+        run("implicit", ship);
+        materialise_all(ship);
+        run("materialised", ship);
+        delete ship;
+    }
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <vector>
+
+#include "bench.h"
+#include "fake_mesh.h"
+#include "station.h"
+
+/* what the mesher draws for a whole ship, and what that costs in VRAM: a
+ * copy of the scaffold for every scaffolding block and a quad for every
+ * surface, as it was, against what's left once the faces which can't be
+ * seen are culled and like surfaces are merged. and the time to mesh
+ * every chunk.
+ */
+
+struct mesh_size {
+    size_t verts = 0, indices = 0;
+
+    void add(size_t v, size_t i)
+    {
+        verts += v;
+        indices += i;
+    }
+
+    double vram_mb() const
+    {
+        return (verts * sizeof(vertex) + indices * sizeof(unsigned)) / 1048576.0;
+    }
+};
+
+/* everything, with nothing culled */
+static mesh_size
+unculled(ship_space *ship, sw_mesh const *scaffold, sw_mesh *const *surfs)
+{
+    mesh_size size;
+
+    for (auto ch : ship->chunks) {
+        for (int k = 0; k < CHUNK_SIZE; k++) {
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                for (int i = 0; i < CHUNK_SIZE; i++) {
+                    block const *b = ch.second->blocks.peek(i, j, k);
+                    if (b->type == block_support)
+                        size.add(scaffold->num_vertices, scaffold->num_indices);
+
+                    for (int face = 0; face < face_count; face++) {
+                        if (b->surfs[face] != surface_none && b->surfs[face] != surface_door_open)
+                            size.add(surfs[face]->num_vertices, surfs[face]->num_indices);
+                    }
+                }
+            }
+        }
+    }
+
+    return size;
+}
+
+/* a size x size deck of scaffolding, walled above and below: nothing
+ * but flat surfaces */
+static ship_space *
+build_deck(int size)
+{
+    ship_space *ship = new ship_space;
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            glm::ivec3 p(x, y, 0);
+            block *bl = ship->ensure_block(p);
+            bl->type = block_support;
+            bl->surfs[surface_zp] = surface_wall;
+            bl->surfs[surface_zm] = surface_wall;
+            ship->ensure_block(p + glm::ivec3(0, 0, 1))->surfs[surface_zm] = surface_wall;
+            ship->ensure_block(p - glm::ivec3(0, 0, 1))->surfs[surface_zp] = surface_wall;
+        }
+    }
+
+    ship->rebuild_topology();
+    return ship;
+}
+
+static void
+run(char const *name, ship_space *ship)
+{
+    sw_mesh *scaffold_sw = fake_scaffold_mesh();
+    mesh_parts scaffold(scaffold_sw);
+    sw_mesh *surfs[6];
+    for (int i = 0; i < 6; i++)
+        surfs[i] = fake_surface_mesh();
+
+    mesh_size before = unculled(ship, scaffold_sw, surfs);
+    mesh_size after;
+
+    std::vector<vertex> verts;
+    std::vector<unsigned> indices;
+
+    bench_timer t;
+    ship->update_seals();
+    for (auto ch : ship->chunks) {
+        verts.clear();
+        indices.clear();
+
+        chunk const *neighbours[face_count];
+        ship->get_mesh_neighbours(ch.first, neighbours);
+        ch.second->build_mesh(&scaffold, surfs, neighbours, &verts, &indices);
+        after.add(verts.size(), indices.size());
+    }
+    double mesh = t.elapsed();
+
+    printf("%-16s %6zu chunks: %9zu -> %9zu triangles, %9zu -> %8zu verts, "
+           "VRAM %8.2f -> %8.2f MB; meshed in %7.2f ms\n",
+           name, ship->chunks.size(), before.indices / 3, after.indices / 3,
+           before.verts, after.verts, before.vram_mb(), after.vram_mb(), mesh * 1e3);
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    mesher_init();
+
+    run("mock ship", ship_space::mock_ship_space());
+    run("32x32 deck", build_deck(32));
+    run("16x16x2 station", build_station(16, 16, 2));
+    run("64x64x2 station", build_station(64, 64, 2));
+    run("sparse station", build_station(16, 16, 8, 4));
+}
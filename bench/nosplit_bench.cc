@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "bench.h"
+#include "station.h"
+
+/* a made-up edit trace -- walls put up at random in the rooms of a
+ * station, and across the bulkheads between them -- replayed with each of
+ * a range of ship_space::nosplit_radius: the cost per surface, how often
+ * the bounded search proved a surface didn't split anything and what that
+ * cost in blocks visited, and how much was left to the slower ways.
+ */
+
+struct edit {
+    glm::ivec3 a, b;
+    int face;
+};
+
+/* walls_per_room random walls inside each room, and as many again across
+ * the bulkheads, where neighbouring rooms' chunks meet */
+static std::vector<edit>
+make_trace(int rooms, int walls_per_room)
+{
+    std::vector<edit> trace;
+    srand(1);
+
+    for (int ry = 0; ry < rooms; ry++) {
+        for (int rx = 0; rx < rooms; rx++) {
+            glm::ivec3 room = ROOM_SIZE * glm::ivec3(rx, ry, 0);
+
+            for (int i = 0; i < walls_per_room; i++) {
+                int face = 2 * (rand() % 3);
+                glm::ivec3 a = room + glm::ivec3(1 + rand() % (ROOM_SIZE - 2),
+                                                 1 + rand() % (ROOM_SIZE - 2),
+                                                 1 + rand() % (ROOM_SIZE - 2));
+                glm::ivec3 b = a + surface_index_to_normal(face);
+                if (b[face >> 1] % ROOM_SIZE == ROOM_SIZE - 1)
+                    continue;   /* that's the shell */
+                trace.push_back(edit{ a, b, face });
+            }
+
+            if (rx == rooms - 1)
+                continue;
+
+            for (int i = 0; i < walls_per_room; i++) {
+                glm::ivec3 a = room + glm::ivec3(ROOM_SIZE - 1, rand() % ROOM_SIZE, rand() % ROOM_SIZE);
+                trace.push_back(edit{ a, a + glm::ivec3(1, 0, 0), surface_xp });
+            }
+        }
+    }
+
+    return trace;
+}
+
+static void
+run(int rooms, int walls_per_room, int radius)
+{
+    ship_space *ship = build_station(rooms, rooms, 1);
+    ship->nosplit_radius = radius;
+    std::vector<edit> trace = make_trace(rooms, walls_per_room);
+    int solves = ship->num_chunk_solves;
+
+    bench_timer t;
+    for (auto const &e : trace) {
+        ship->set_surface(e.a, e.b, (surface_index)e.face, surface_wall);
+    }
+    double add = t.elapsed();
+
+    int tries = ship->num_bounded_nosplits + ship->num_bounded_misses;
+    printf("%2dx%2d rooms, %6zu walls, radius %d: add %6.2f us/surface; "
+           "%5d fast nosplits, %5d/%5d bounded nosplits (%6.1f blocks/try), "
+           "%5d local nosplits, %4d local splits, %5d chunk solves\n",
+           rooms, rooms, trace.size(), radius, add / trace.size() * 1e6,
+           ship->num_fast_nosplits, ship->num_bounded_nosplits, tries,
+           tries ? (double)ship->num_bounded_visits / tries : 0.0,
+           ship->num_local_nosplits, ship->num_local_splits, ship->num_chunk_solves - solves);
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    int const radii[] = { 0, 1, 2, 4, CHUNK_SIZE };
+
+    for (int walls : { 16, 64 }) {
+        for (int radius : radii) {
+            run(16, walls, radius);
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "station.h"
+
+/* long rays -- sensors, line of sight, projectiles -- over a station built
+ * solid, and over one with its rooms spread out. some are fired at the
+ * station from all around it, and some from sensors scattered through it,
+ * in every direction.
+ *
+ * each lot is walked a block at a time through get_block, as the player's
+ * reach used to be; through ship_space::raycast one at a time, which skips
+ * the chunks with nothing in them; and all at once through
+ * ship_space::raycast_many.
+ */
+
+static float
+frand(void)
+{
+    return rand() / (float)RAND_MAX;
+}
+
+static bool
+step_raycast(ship_space *ship, glm::vec3 o, glm::vec3 d, float max_dist, glm::ivec3 *hit)
+{
+    d = glm::normalize(d);
+    glm::ivec3 v((int)floorf(o.x), (int)floorf(o.y), (int)floorf(o.z));
+    glm::ivec3 step;
+    glm::vec3 t_max;
+
+    for (int a = 0; a < 3; a++) {
+        step[a] = d[a] > 0 ? 1 : -1;
+        t_max[a] = (v[a] + (d[a] > 0) - o[a]) / d[a];
+    }
+
+    for (;;) {
+        int a = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+        if (t_max[a] > max_dist)
+            return false;
+
+        v[a] += step[a];
+        t_max[a] = (v[a] + (d[a] > 0) - o[a]) / d[a];
+
+        block *bl = ship->get_block(v);
+        if (bl && bl->type != block_empty) {
+            *hit = v;
+            return true;
+        }
+    }
+}
+
+/* from anywhere in a box twice the size of the ship, towards anywhere in
+ * the ship */
+static std::vector<ray>
+rays_from_outside(ship_space *ship, float max_dist)
+{
+    glm::vec3 lo(CHUNK_SIZE * ship->mins);
+    glm::vec3 size(CHUNK_SIZE * (ship->maxs + glm::ivec3(1) - ship->mins));
+    std::vector<ray> rays;
+
+    for (int i = 0; i < 20000; i++) {
+        glm::vec3 from, to;
+        for (int a = 0; a < 3; a++) {
+            from[a] = lo[a] - size[a] / 2 + 2 * size[a] * frand();
+            to[a] = lo[a] + size[a] * frand();
+        }
+        rays.push_back(ray{ from, to - from, max_dist });
+    }
+
+    return rays;
+}
+
+/* 64 each from 320 sensors in the middle of rooms */
+static std::vector<ray>
+rays_from_sensors(ship_space *ship, float max_dist)
+{
+    glm::ivec3 rooms = CHUNK_SIZE * (ship->maxs + glm::ivec3(1) - ship->mins) / ROOM_SIZE;
+    std::vector<ray> rays;
+
+    for (int i = 0; i < 320; i++) {
+        glm::ivec3 room(rand() % rooms.x, rand() % rooms.y, rand() % rooms.z);
+        glm::vec3 from = glm::vec3(ROOM_SIZE * room) + glm::vec3(ROOM_SIZE / 2 + frand());
+        for (int j = 0; j < 64; j++) {
+            rays.push_back(ray{ from, glm::vec3(frand() - 0.5f, frand() - 0.5f, frand() - 0.5f), max_dist });
+        }
+    }
+
+    return rays;
+}
+
+static void
+run(char const *name, ship_space *ship, std::vector<ray> const &rays)
+{
+    ray_filter filter = { 1 << block_support | 1 << block_entity, 0 };
+    size_t n = rays.size();
+    int step_hits = 0, hits = 0, batch_hits = 0, disagree = 0;
+    std::vector<glm::ivec3> step_at(n);
+    std::vector<raycast_info> one(n), batch(n);
+
+    bench_timer t;
+    for (size_t i = 0; i < n; i++) {
+        step_hits += step_raycast(ship, rays[i].o, rays[i].d, rays[i].max_dist, &step_at[i]);
+    }
+    double stepped = t.elapsed();
+
+    t = bench_timer();
+    for (size_t i = 0; i < n; i++) {
+        ship->raycast(rays[i].o, rays[i].d, rays[i].max_dist, filter, &one[i]);
+    }
+    double single = t.elapsed();
+
+    t = bench_timer();
+    ship->raycast_many(rays.data(), batch.data(), n, filter);
+    double batched = t.elapsed();
+
+    for (size_t i = 0; i < n; i++) {
+        hits += one[i].hit;
+        batch_hits += batch[i].hit;
+        disagree += one[i].hit && (one[i].bl != step_at[i] || batch[i].bl != one[i].bl);
+    }
+
+    bench_consume(step_hits + hits + batch_hits);
+    printf("%-38s %5zu rays of up to %3.0f blocks, %5d hit: block steps %8.0f rays/s, "
+           "raycast %8.0f rays/s, raycast_many %8.0f rays/s (%4.2fx)%s\n",
+           name, n, rays[0].max_dist, hits, n / stepped, n / single, n / batched, single / batched,
+           step_hits != hits || batch_hits != hits || disagree ? " -- DISAGREE" : "");
+}
+
+int
+main(void)
+{
+    ship_space *solid = build_station(16, 16, 2);
+    ship_space *spread = build_station(16, 16, 4, 4);
+
+    srand(1);
+    for (float max_dist : { 64.0f, 512.0f }) {
+        run("16x16x2 rooms, solid, from outside", solid, rays_from_outside(solid, max_dist));
+        run("16x16x4 rooms, spread, from outside", spread, rays_from_outside(spread, max_dist));
+        run("16x16x2 rooms, solid, from sensors", solid, rays_from_sensors(solid, max_dist));
+        run("16x16x4 rooms, spread, from sensors", spread, rays_from_sensors(spread, max_dist));
+    }
+
+    delete solid;
+    delete spread;
+}
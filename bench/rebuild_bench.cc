@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+#include "bench.h"
+#include "station.h"
+
+/* a full rebuild_topology() of stations of various sizes, spread across
+ * 1, 2, 4, ... worker threads up to the number of hardware threads: the
+ * time for each, and the speedup over a single thread.
+ */
+
+static double
+time_rebuilds(ship_space *ship, int reps)
+{
+    double best = 1e9;
+    for (int i = 0; i < reps; i++) {
+        bench_timer t;
+        ship->rebuild_topology();
+        double e = t.elapsed();
+        if (e < best)
+            best = e;
+    }
+
+    return best;
+}
+
+static void
+run(int rooms, unsigned max_threads)
+{
+    ship_space *ship = build_station(rooms, rooms, 2);
+    double serial = 0;
+
+    for (unsigned threads = 1; ; threads *= 2) {
+        if (threads > max_threads)
+            threads = max_threads;
+
+        ship->set_worker_threads(threads);
+        double t = time_rebuilds(ship, 5);
+        if (threads == 1)
+            serial = t;
+
+        printf("%2dx%2d rooms, %6zu chunks, %2u threads: %8.3f ms (x%.2f)\n",
+               rooms, rooms, ship->chunks.size(), threads, t * 1e3, serial / t);
+
+        if (threads >= max_threads)
+            break;
+    }
+
+    bench_consume(ship->num_full_rebuilds);
+    delete ship;
+}
+
+/* bench [max threads], defaulting to the number of hardware threads */
+int
+main(int argc, char **argv)
+{
+    unsigned max_threads = argc > 1 ? (unsigned)atoi(argv[1]) : std::thread::hardware_concurrency();
+    if (max_threads < 1)
+        max_threads = 1;
+
+    run(16, max_threads);
+    run(32, max_threads);
+    run(64, max_threads);
+}
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <algorithm>
+#include <thread>
+
+#include "bench.h"
+#include "station.h"
+#include "../src/chunk_store.h"
+
+/* a player walking across a station with chunk streaming on, a block a
+ * frame at 60 frames a second: the block memory kept against having the
+ * whole station resident, the per-frame cost of update_residency(), and how
+ * many of the chunks around the player weren't back yet when they were
+ * wanted. the first frame pages out everything far away, so is reported
+ * on its own
+ */
+
+static void
+run(int rooms, unsigned max_resident)
+{
+    ship_space *ship = build_station(rooms, rooms, 2);
+    size_t all_resident = ship->block_memory_used();
+    size_t num_chunks = ship->chunks.size();
+
+    ship->enable_streaming("residency_bench.tmp", max_resident);
+
+    const int radius = 2;
+    int frames = 0, misses = 0;
+    double first = 0, total = 0, worst = 0;
+    size_t peak = 0;
+
+    int extent = ROOM_SIZE * rooms;
+    for (int i = 0; i < extent; i++, frames++) {
+        glm::ivec3 player(i, i, ROOM_SIZE / 2);
+        bench_timer frame;
+
+        bench_timer t;
+        ship->update_residency(&player, 1, radius);
+        double update = t.elapsed();
+        if (i) {
+            total += update;
+            worst = std::max(worst, update);
+        }
+        else {
+            first = update;
+        }
+
+        /* what the player is about to touch */
+        glm::ivec3 ch = player / CHUNK_SIZE;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                chunk *c = ship->chunks.get(ch + glm::ivec3(dx, dy, 0));
+                if (c && !c->resident) {
+                    misses++;
+                    ship->ensure_resident(ch + glm::ivec3(dx, dy, 0), c);
+                }
+            }
+        }
+
+        peak = std::max(peak, ship->block_memory_used());
+
+        double left = 1 / 60.0 - frame.elapsed();
+        if (left > 0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(left));
+    }
+
+    printf("%2dx%2d rooms, %5zu chunks, %4u resident: blocks %6.2f MB of %6.2f MB; "
+           "first update %7.3f ms, then %6.3f ms/frame (worst %6.3f ms); "
+           "%d misses in %d frames; store %6.2f MB\n",
+           rooms, rooms, num_chunks, max_resident, peak / 1048576.0, all_resident / 1048576.0,
+           first * 1e3, total / (frames - 1) * 1e3, worst * 1e3, misses, frames,
+           ship->store->file_size() / 1048576.0);
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    run(16, 256);
+    run(32, 256);
+    run(64, 256);
+    run(64, 1024);
+}
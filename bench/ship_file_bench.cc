@@ -0,0 +1,63 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "station.h"
+#include "../src/ship_file.h"
+
+/* saving and loading a station of about 100k blocks. loading is split into
+ * the mapping and fixups, and the topology rebuild which follows, since
+ * the latter is the same work however the blocks got there.
+ */
+
+static char const *filename = "ship_file_bench.ship";
+
+int
+main(void)
+{
+    /* 13x13 rooms, 2 decks: 338 rooms of 296 blocks each */
+    ship_space *ship = build_station(13, 13, 2);
+
+    size_t blocks = 0;
+    for (auto ch : ship->chunks) {
+        for (int z = 0; z < CHUNK_SIZE; z++)
+            for (int y = 0; y < CHUNK_SIZE; y++)
+                for (int x = 0; x < CHUNK_SIZE; x++)
+                    blocks += ch.second->blocks.peek(x, y, z)->type != block_empty;
+    }
+
+    const int reps = 10;
+
+    bench_timer t_save;
+    for (int i = 0; i < reps; i++) {
+        save_ship(ship, filename);
+    }
+    double save = t_save.elapsed() / reps;
+
+    FILE *f = fopen(filename, "rb");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+
+    double load = 0, rebuild = 0;
+    for (int i = 0; i < reps; i++) {
+        bench_timer t_load;
+        ship_space *loaded = load_ship(filename);
+        load += t_load.elapsed();
+
+        bench_timer t_rebuild;
+        loaded->rebuild_topology();
+        rebuild += t_rebuild.elapsed();
+
+        bench_consume(loaded->chunks.size());
+        delete loaded;
+    }
+    load /= reps;
+    rebuild /= reps;
+
+    printf("%zu blocks in %zu chunks, %.2f MB file\n", blocks, ship->chunks.size(), size / 1048576.0);
+    printf("  save %8.2f ms\n", save * 1e3);
+    printf("  load %8.2f ms, of which topology rebuild ~%.2f ms\n", load * 1e3, rebuild * 1e3);
+
+    remove(filename);
+    delete ship;
+}
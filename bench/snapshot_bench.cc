@@ -0,0 +1,68 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "station.h"
+
+/* taking a snapshot of a station, against copying every chunk's blocks
+ * outright, and what the copy-on-write costs the next edits
+ */
+
+static void
+run(int rooms)
+{
+    ship_space *ship = build_station(rooms, rooms, 2);
+
+    const int reps = 20;
+
+    bench_timer t_snap;
+    for (int i = 0; i < reps; i++) {
+        ship_snapshot *snap = ship->snapshot();
+        bench_consume(snap->chunks.size());
+        delete snap;
+    }
+    double snap = t_snap.elapsed() / reps;
+
+    bench_timer t_copy;
+    for (int i = 0; i < reps; i++) {
+        ship_snapshot *snap = ship->snapshot();
+        for (auto &ch : snap->chunks) {
+            ch.second.unshare();
+        }
+        bench_consume(snap->chunks.size());
+        delete snap;
+    }
+    double copy = t_copy.elapsed() / reps;
+
+    /* one edit in each room on the bottom deck, with and without a
+     * snapshot holding on to the old blocks */
+    double edits[2];
+    for (int with_snap = 0; with_snap < 2; with_snap++) {
+        ship_snapshot *snap = with_snap ? ship->snapshot() : nullptr;
+        bench_timer t;
+        for (int ry = 0; ry < rooms; ry++) {
+            for (int rx = 0; rx < rooms; rx++) {
+                glm::ivec3 p = ROOM_SIZE * glm::ivec3(rx, ry, 0) + glm::ivec3(3, 3 + with_snap, 1);
+                ship->set_block_type(p, block_support);
+            }
+        }
+        edits[with_snap] = t.elapsed();
+        delete snap;
+    }
+
+    printf("%2dx%2d rooms, %5zu chunks: snapshot %7.3f ms, full copy %7.3f ms; "
+           "%d edits %6.3f ms, after snapshot %6.3f ms\n",
+           rooms, rooms, ship->chunks.size(), snap * 1e3, copy * 1e3,
+           rooms * rooms, edits[0] * 1e3, edits[1] * 1e3);
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    int sizes[] = { 4, 8, 16 };
+
+    for (int rooms : sizes) {
+        run(rooms);
+    }
+}
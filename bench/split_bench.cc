@@ -0,0 +1,94 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "station.h"
+
+/* putting a wall across the middle of every room on the bottom deck of a
+ * station, one surface at a time, then taking the walls out again: the
+ * cost per surface, and how each new surface was found to split the room
+ * or not, against the cost of a single full rebuild_topology().
+ */
+
+static void
+fill_with_air(ship_space *ship)
+{
+    for (auto ch : ship->chunks) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    topo_info *t = topo_find(ch.second->topo(x, y, z));
+                    if (t != &ship->outside_topo_info && !ship->get_zone_info(t))
+                        ship->insert_zone(t, t->size);
+                }
+            }
+        }
+    }
+}
+
+/* put in (or take out) the walls across the middle of every room */
+static void
+walls(ship_space *ship, int rooms, bool add)
+{
+    for (int ry = 0; ry < rooms; ry++) {
+        for (int rx = 0; rx < rooms; rx++) {
+            glm::ivec3 room = ROOM_SIZE * glm::ivec3(rx, ry, 0);
+            for (int z = 1; z < ROOM_SIZE - 1; z++) {
+                for (int y = 1; y < ROOM_SIZE - 1; y++) {
+                    glm::ivec3 a = room + glm::ivec3(ROOM_SIZE / 2 - 1, y, z);
+                    glm::ivec3 b = a + glm::ivec3(1, 0, 0);
+                    if (add)
+                        ship->set_surface(a, b, surface_xp, surface_wall);
+                    else
+                        ship->remove_surface(a, b, surface_xp);
+                }
+            }
+        }
+    }
+}
+
+static void
+run(int rooms)
+{
+    ship_space *ship = build_station(rooms, rooms, 2);
+    fill_with_air(ship);
+
+    int surfaces = rooms * rooms * (ROOM_SIZE - 2) * (ROOM_SIZE - 2);
+    int rebuilds = ship->num_full_rebuilds;
+    int fast = ship->num_fast_nosplits;
+    int bounded = ship->num_bounded_nosplits;
+    int nosplits = ship->num_local_nosplits;
+    int splits = ship->num_local_splits;
+
+    bench_timer t;
+    walls(ship, rooms, true);
+    double add = t.elapsed();
+    size_t zones = ship->zones.size();
+
+    t = bench_timer();
+    walls(ship, rooms, false);
+    double remove = t.elapsed();
+
+    t = bench_timer();
+    ship->rebuild_topology();
+    double rebuild = t.elapsed();
+
+    printf("%2dx%2d rooms, %6d surfaces: add %6.2f us/surface, remove %6.2f us/surface; "
+           "%5d fast nosplits, %5d bounded nosplits, %5d local nosplits, %4d local splits, %d full rebuilds; "
+           "%zu zones with the walls in; one rebuild_topology %8.2f ms\n",
+           rooms, rooms, surfaces, add / surfaces * 1e6, remove / surfaces * 1e6,
+           ship->num_fast_nosplits - fast, ship->num_bounded_nosplits - bounded,
+           ship->num_local_nosplits - nosplits,
+           ship->num_local_splits - splits, ship->num_full_rebuilds - rebuilds - 1,
+           zones, rebuild * 1e3);
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    run(4);
+    run(8);
+    run(16);
+    run(32);
+}
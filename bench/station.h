@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../src/ship_space.h"
+
+/* builds a large, regular station for the benchmarks to chew on:
+ * rooms_x * rooms_y rooms per deck, decks decks high. every room is a
+ * ROOM_SIZE^3 shell of scaffolding with walls on both faces of the shell,
+ * so neighbouring rooms are separated by a double thickness bulkhead.
+ *
+ * with a spacing > 1, only every spacing'th room slot along each axis is
+ * built, leaving open space between the rooms.
+ *
+ * surfaces are written directly (on both sides) rather than through
+ * set_surface, and the topology is rebuilt once at the end.
+ */
+
+#define ROOM_SIZE 8
+
+static inline bool
+station_is_shell(glm::ivec3 p, glm::ivec3 extent, int spacing)
+{
+    if (p.x < 0 || p.y < 0 || p.z < 0 ||
+        p.x >= extent.x || p.y >= extent.y || p.z >= extent.z) {
+        return false;
+    }
+
+    glm::ivec3 room = p / ROOM_SIZE;
+    if (room.x % spacing || room.y % spacing || room.z % spacing)
+        return false;
+
+    glm::ivec3 l(p.x % ROOM_SIZE, p.y % ROOM_SIZE, p.z % ROOM_SIZE);
+    return l.x == 0 || l.x == ROOM_SIZE - 1 ||
+           l.y == 0 || l.y == ROOM_SIZE - 1 ||
+           l.z == 0 || l.z == ROOM_SIZE - 1;
+}
+
+static inline ship_space *
+build_station(int rooms_x, int rooms_y, int decks, int spacing = 1)
+{
+    ship_space *ship = new ship_space;
+    glm::ivec3 extent = ROOM_SIZE * glm::ivec3(rooms_x, rooms_y, decks);
+
+    for (int z = 0; z < extent.z; z++) {
+        for (int y = 0; y < extent.y; y++) {
+            for (int x = 0; x < extent.x; x++) {
+                glm::ivec3 p(x, y, z);
+                if (!station_is_shell(p, extent, spacing))
+                    continue;
+
+                block *bl = ship->ensure_block(p);
+                bl->type = block_support;
+
+                for (int face = 0; face < face_count; face++) {
+                    glm::ivec3 q = p + surface_index_to_normal(face);
+                    if (station_is_shell(q, extent, spacing))
+                        continue;   /* inside the bulkhead */
+
+                    bl->surfs[face] = surface_wall;
+                    ship->ensure_block(q)->surfs[face ^ 1] = surface_wall;
+                }
+            }
+        }
+    }
+
+    ship->rebuild_topology();
+    return ship;
+}
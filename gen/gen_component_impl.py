@@ -27,6 +27,8 @@ header_template_3="""    } instance_pool;
     void create_component_instance_data(unsigned count) override;
     void destroy_instance(instance i) override;
     void entity(c_entity e) override;
+    char const * name() const override;
+    std::vector<column> columns() override;
 
 """
 
@@ -125,6 +127,25 @@ void
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+%s_component_manager::name() const {
+    return "%s";
+}
+
+std::vector<component_manager::column>
+%s_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+"""
+
+impl_template_10="""    c.push_back({ "%(name)s", instance_pool.%(name)s, sizeof(%(type)s), %(persistent)s });
+"""
+
+impl_template_11="""
+    return c;
+}
 """
 
 import os
@@ -142,7 +163,8 @@ def main():
             prev = 'entity';
             for l in f:
                 parts = l.strip().split(',')
-                fields.append({'type': parts[0], 'name': parts[1], 'prev': prev})
+                fields.append({'type': parts[0], 'name': parts[1], 'prev': prev,
+                               'persistent': 'false' if '*' in parts[0] else 'true'})
                 prev = parts[1]
 
         with open("src/component/%s_component.h" % component_name, "w") as g:
@@ -170,7 +192,10 @@ def main():
             g.write(impl_template_7 % component_name)
             for fi in fields:
                 g.write(impl_template_8 % fi)
-            g.write(impl_template_9 % (component_name, component_name))
+            g.write(impl_template_9 % ((component_name,) * 5))
+            for fi in fields:
+                g.write(impl_template_10 % fi)
+            g.write(impl_template_11)
 
     return 0;
 
@@ -10,6 +10,8 @@
 #include <glm/glm.hpp>
 #include <stdio.h>
 #include <SDL.h>
+#include <string>
+#include <thread>
 #include <unordered_map>
 
 #include "src/common.h"
@@ -46,6 +48,15 @@
 
 #define INITIAL_MAX_COMPONENTS 20
 
+/* chunk residency (see ship_space::update_residency): once the ship has
+ * more than MAX_RESIDENT_CHUNKS chunks, the chunks within
+ * RESIDENT_CHUNK_RADIUS chunks of the player are always kept, and read back
+ * ahead of time; beyond those, up to MAX_RESIDENT_CHUNKS are. the rest go
+ * to CHUNK_STORE_FILE in the user's data directory */
+#define CHUNK_STORE_FILE        "chunk_store.tmp"
+#define RESIDENT_CHUNK_RADIUS   4
+#define MAX_RESIDENT_CHUNKS     4096
+
 bool exit_requested = false;
 
 bool draw_hud = true;
@@ -116,6 +127,7 @@ frame_data *frames, *frame;
 unsigned frame_index;
 
 sw_mesh *scaffold_sw;
+mesh_parts *scaffold_parts;
 sw_mesh *surfs_sw[6];
 GLuint simple_shader, unlit_shader, add_overlay_shader, remove_overlay_shader, ui_shader, ui_sprites_shader;
 GLuint sky_shader, unlit_instanced_shader, lit_instanced_shader, particle_shader, modelspace_uv_shader;
@@ -505,23 +517,36 @@ void
 mark_lightfield_update(glm::ivec3 center)
 {
     glm::ivec3 half_extent = glm::ivec3(max_light_prop, max_light_prop, max_light_prop);
-    if (need_lightfield_update) {
+    if (!need_lightfield_update) {
         lightfield_update_mins = center - half_extent;
         lightfield_update_maxs = center + half_extent;
+        need_lightfield_update = true;
     }
     else {
         lightfield_update_mins = glm::min(lightfield_update_mins,
                 center - half_extent);
         lightfield_update_maxs = glm::max(lightfield_update_maxs,
                 center + half_extent);
-        need_lightfield_update = true;
     }
 }
 
 
+/* the lightfield's subscription to the ship's edit journal */
+unsigned lightfield_journal;
+
+
 void
 update_lightfield()
 {
+    /* only surfaces which changed whether they let light through matter;
+     * the update box grows to cover them all */
+    ship->consume(lightfield_journal, [](block_delta const &d) {
+        if (d.face >= 0 &&
+            light_permeable((surface_type)d.old_value) != light_permeable((surface_type)d.new_value)) {
+            mark_lightfield_update(d.p);
+        }
+    });
+
     if (!need_lightfield_update) {
         /* nothing to do here */
         return;
@@ -553,26 +578,28 @@ update_lightfield()
     for (int pass = 0; pass < max_light_prop; pass++) {
         for (int k = lightfield_update_mins.z; k <= lightfield_update_maxs.z; k++) {
             for (int j = lightfield_update_mins.y; j <= lightfield_update_maxs.y; j++) {
-                for (int i = lightfield_update_mins.x; i <= lightfield_update_maxs.x; i++) {
+                /* walk the row with a cursor; it only looks up a chunk when it crosses into one.
+                 * only the masks are read, so paged-out chunks are left on disk */
+                block_cursor cur(ship, glm::ivec3(lightfield_update_mins.x, j, k), true);
+                for (int i = lightfield_update_mins.x; i <= lightfield_update_maxs.x; i++, cur.step(surface_xp)) {
                     int level = get_light_level(i, j, k);
 
-                    block *b = ship->get_block(glm::ivec3(i, j, k));
-                    if (!b)
+                    if (!cur.ch)
                         continue;
 
-                    if (light_permeable(b->surfs[surface_xm]))
+                    if (!cur.blocks_light(surface_xm))
                         level = std::max(level, get_light_level(i - 1, j, k) - light_atten);
-                    if (light_permeable(b->surfs[surface_xp]))
+                    if (!cur.blocks_light(surface_xp))
                         level = std::max(level, get_light_level(i + 1, j, k) - light_atten);
 
-                    if (light_permeable(b->surfs[surface_ym]))
+                    if (!cur.blocks_light(surface_ym))
                         level = std::max(level, get_light_level(i, j - 1, k) - light_atten);
-                    if (light_permeable(b->surfs[surface_yp]))
+                    if (!cur.blocks_light(surface_yp))
                         level = std::max(level, get_light_level(i, j + 1, k) - light_atten);
 
-                    if (light_permeable(b->surfs[surface_zm]))
+                    if (!cur.blocks_light(surface_zm))
                         level = std::max(level, get_light_level(i, j, k - 1) - light_atten);
-                    if (light_permeable(b->surfs[surface_zp]))
+                    if (!cur.blocks_light(surface_zp))
                         level = std::max(level, get_light_level(i, j, k + 1) - light_atten);
 
                     set_light_level(i, j, k, level);
@@ -613,22 +640,100 @@ set_game_state(game_state *s)
     pl.ui_dirty = true; /* state change always requires a ui rebuild. */
 }
 
+/* the mesher's subscription to the ship's edit journal. the static physics
+ * meshes are built from the render meshes, so this covers both */
+unsigned mesher_journal;
+
+
+/* a change to the block at p can show or hide faces up to two blocks away
+ * (see chunk::build_mesh): redo its chunk, and the one across any chunk
+ * face that close. paged-out chunks are redone when they come back anyway */
+static void
+invalidate_around(glm::ivec3 p)
+{
+    glm::ivec3 ch(p.x >> CHUNK_SHIFT, p.y >> CHUNK_SHIFT, p.z >> CHUNK_SHIFT);
+    chunk *c = ship->chunks.get(ch);
+    if (c)
+        c->render_chunk.valid = false;
+
+    for (int face = 0; face < face_count; face++) {
+        glm::ivec3 q = p + 2 * surface_index_to_normal(face);
+        glm::ivec3 qc(q.x >> CHUNK_SHIFT, q.y >> CHUNK_SHIFT, q.z >> CHUNK_SHIFT);
+        c = qc != ch ? ship->chunks.get(qc) : nullptr;
+        if (c)
+            c->render_chunk.valid = false;
+    }
+}
+
+
 void
 prepare_chunks()
 {
-    /* walk all the chunks -- TODO: only walk chunks that might contribute to the view */
-    for (int k = ship->mins.z; k <= ship->maxs.z; k++) {
-        for (int j = ship->mins.y; j <= ship->maxs.y; j++) {
-            for (int i = ship->mins.x; i <= ship->maxs.x; i++) {
-                chunk *ch = ship->get_chunk(glm::ivec3(i, j, k));
-                if (ch) {
-                    ch->prepare_render(i, j, k);
-                }
-            }
+    /* every change invalidates the chunks on both sides of it; a chunk
+     * changed many times since the last frame is still rebuilt once */
+    ship->consume(mesher_journal, [](block_delta const &d) {
+        invalidate_around(d.p);
+        if (d.face >= 0) {
+            invalidate_around(d.p + surface_index_to_normal(d.face));
+        }
+    });
+
+    /* and what can't be seen changes with them */
+    ship->update_seals();
+
+    /* walk all the chunks -- TODO: only walk chunks that might contribute to the view.
+     * implicit chunks have nothing to draw, and aren't visited; nor are
+     * paged-out ones, until they're back */
+    for (auto it : ship->chunks) {
+        if (it.second->resident) {
+            chunk const *neighbours[face_count];
+            ship->get_mesh_neighbours(it.first, neighbours);
+            it.second->prepare_render(it.first.x, it.first.y, it.first.z, neighbours);
         }
     }
 }
 
+/* a chunk is being paged out: drop its mesh and static physics. they're
+ * rebuilt by prepare_chunks() once it's back */
+void
+teardown_chunk(chunk *c)
+{
+    if (c->render_chunk.mesh) {
+        free_mesh(c->render_chunk.mesh);
+        delete c->render_chunk.mesh;
+        c->render_chunk.mesh = nullptr;
+    }
+
+    teardown_static_physics_setup(nullptr,
+                                  &c->render_chunk.phys_shape,
+                                  &c->render_chunk.phys_body);
+}
+
+/* start paging chunks out once the ship no longer fits in memory; a ship
+ * which does never touches the disk */
+void
+update_streaming()
+{
+    static bool no_store = false;
+    if (ship->store || no_store || ship->chunks.size() <= MAX_RESIDENT_CHUNKS)
+        return;
+
+    char *dir = SDL_GetPrefPath("engineers-nightmare", "engineers-nightmare");
+    if (!dir) {
+        printf("Not paging chunks out, as there is nowhere to put them: %s\n", SDL_GetError());
+        no_store = true;
+        return;
+    }
+
+    std::string filename = std::string(dir) + CHUNK_STORE_FILE;
+    SDL_free(dir);
+
+    printf("Ship is %u chunks; paging chunks out to %s\n",
+            (unsigned) ship->chunks.size(), filename.c_str());
+    ship->enable_streaming(filename.c_str(), MAX_RESIDENT_CHUNKS);
+    ship->on_page_out = teardown_chunk;
+}
+
 void
 init()
 {
@@ -703,6 +808,7 @@ init()
     door_hw = upload_mesh(door_sw);
 
     scaffold_sw = load_mesh("mesh/initial_scaffold.dae");
+    scaffold_parts = new mesh_parts(scaffold_sw);
 
     surfs_sw[surface_xp] = load_mesh("mesh/x_quad_p.dae");
     surfs_sw[surface_xm] = load_mesh("mesh/x_quad.dae");
@@ -769,7 +875,11 @@ init()
     if( ! ship )
         errx(1, "Ship_space::mock_ship_space failed\n");
 
+    ship->set_worker_threads(std::thread::hardware_concurrency());
     ship->rebuild_topology();
+    update_streaming();
+    mesher_journal = ship->subscribe();
+    lightfield_journal = ship->subscribe();
 
     printf("Ship is %u chunks, %d..%d %d..%d %d..%d\n",
             (unsigned) ship->chunks.size(),
@@ -777,6 +887,10 @@ init()
             ship->mins.y, ship->maxs.y,
             ship->mins.z, ship->maxs.z);
 
+    slab_pool_stats pool_stats = chunk_pool_stats();
+    printf("Chunk pool: %u chunks live in %u slabs (%zu bytes reserved)\n",
+            pool_stats.live, pool_stats.slabs, pool_stats.reserved_bytes);
+
     ship->validate();
 
     game_settings = load_settings(en_config_base);
@@ -844,7 +958,7 @@ destroy_entity(entity *e)
             assert(bl);
             if (bl->type == block_entity) {
                 printf("emptying %d,%d,%d on remove of ent\n", p.x, p.y, p.z);
-                bl->type = block_empty;
+                ship->set_block_type(p, block_empty);
 
                 for (auto face = 0; face < 6; face++) {
                     /* unreserve all the space */
@@ -935,7 +1049,7 @@ struct add_block_entity_tool : tool
         }
 
         for (auto i = 0; i < entity_types[type].height; i++) {
-            block *bl = ship->get_block(rc->p + glm::ivec3(0, 0, i));
+            block const *bl = ship->peek_block(rc->p + glm::ivec3(0, 0, i));
             if (bl) {
                 /* check for surface ents that would conflict */
                 for (int face = 0; face < face_count; face++)
@@ -951,14 +1065,17 @@ struct add_block_entity_tool : tool
         if (!can_use(rc))
             return;
 
+        /* the chunk may only be implicit so far */
+        ship->ensure_block(rc->p);
+
         chunk *ch = ship->get_chunk_containing(rc->p);
         auto e = new entity(rc->p, type, surface_zm);
         ch->entities.push_back(e);
 
         for (auto i = 0; i < entity_types[type].height; i++) {
             auto p = rc->p + glm::ivec3(0, 0, i);
-            block *bl = ship->ensure_block(p);
-            bl->type = block_entity;
+            ship->set_block_type(p, block_entity);
+            block *bl = ship->get_block(p);
             printf("taking block %d,%d,%d\n", p.x, p.y, p.z);
 
             /* consume ALL the space on the surfaces */
@@ -1014,7 +1131,7 @@ struct add_surface_entity_tool : tool
         if (!rc->hit)
             return false;
 
-        block *bl = rc->block;
+        block const *bl = rc->block;
 
         if (!bl)
             return false;
@@ -1024,7 +1141,7 @@ struct add_surface_entity_tool : tool
         if (bl->surfs[index] == surface_none)
             return false;
 
-        block *other_side = ship->get_block(rc->p);
+        block const *other_side = ship->peek_block(rc->p);
         unsigned short required_space = ~0; /* TODO: make this a prop of the type + subblock placement */
 
         if (other_side->surf_space[index ^ 1] & required_space) {
@@ -1130,7 +1247,7 @@ struct remove_surface_entity_tool : tool
             return;
 
         int index = normal_to_surface_index(rc);
-        block *other_side = ship->get_block(rc->p);
+        block const *other_side = ship->peek_block(rc->p);
 
         if (!other_side || !other_side->surf_space[index ^ 1]) {
             return;
@@ -1693,7 +1810,7 @@ struct flashlight_tool : tool
                                                             phy->ghostObj, phy->dynamicsWorld);
 
             if (hit.hit) {
-                assert(ship->get_block(hit.hitCoord)); /* must be a block */
+                assert(ship->peek_block(hit.hitCoord)); /* must be a block */
 
                 /* The goal is to not place the lighting within the block. The
                  * perfect solution would put the light exactly on the
@@ -1871,19 +1988,15 @@ void render() {
 
     prepare_chunks();
 
-    for (int k = ship->mins.z; k <= ship->maxs.z; k++) {
-        for (int j = ship->mins.y; j <= ship->maxs.y; j++) {
-            for (int i = ship->mins.x; i <= ship->maxs.x; i++) {
-                /* TODO: prepare all the matrices first, and do ONE upload */
-                chunk *ch = ship->get_chunk(glm::ivec3(i, j, k));
-                if (ch) {
-                    auto chunk_matrix = frame->alloc_aligned<glm::mat4>(1);
-                    *chunk_matrix.ptr = mat_position(CHUNK_SIZE * glm::ivec3(i, j, k));
-                    chunk_matrix.bind(1, frame);
-                    draw_mesh(ch->render_chunk.mesh);
-                }
-            }
-        }
+    for (auto it : ship->chunks) {
+        if (!it.second->render_chunk.mesh)
+            continue;
+
+        /* TODO: prepare all the matrices first, and do ONE upload */
+        auto chunk_matrix = frame->alloc_aligned<glm::mat4>(1);
+        *chunk_matrix.ptr = mat_position(CHUNK_SIZE * it.first);
+        chunk_matrix.bind(1, frame);
+        draw_mesh(it.second->render_chunk.mesh);
     }
 
     state->render(frame);
@@ -1979,6 +2092,14 @@ update()
         tick_proximity_sensors(ship, &pl);
         tick_doors(ship);
 
+        /* and let the air through the open doors and vents */
+        ship->mix_air();
+
+        /* keep the blocks around the player in memory, and let the rest go */
+        glm::ivec3 player_block = get_coord_containing(pl.pos);
+        update_streaming();
+        ship->update_residency(&player_block, 1, RESIDENT_CHUNK_RADIUS);
+
         /* rebuild lighting if needed */
         update_lightfield();
 
@@ -2110,11 +2231,17 @@ struct play_state : game_state {
             add_text_with_outline(buf2, -w/2, -100);
 
             w = 0; h = 0;
-            sprintf(buf2, "full: %d fast-unify: %d fast-nosplit: %d false-split: %d",
+            sprintf(buf2, "full: %d fast-unify: %d fast-nosplit: %d bounded-nosplit: %d/%d (%d blocks) "
+                    "local-nosplit: %d local-split: %d chunk-solve: %d",
                     ship->num_full_rebuilds,
                     ship->num_fast_unifys,
                     ship->num_fast_nosplits,
-                    ship->num_false_splits);
+                    ship->num_bounded_nosplits,
+                    ship->num_bounded_nosplits + ship->num_bounded_misses,
+                    ship->num_bounded_visits,
+                    ship->num_local_nosplits,
+                    ship->num_local_splits,
+                    ship->num_chunk_solves);
             text->measure(buf2, &w, &h);
             add_text_with_outline(buf2, -w/2, -150);
         }
@@ -2256,6 +2383,8 @@ struct play_state : game_state {
         auto slot9      = get_input(action_slot9)->just_active;
         auto slot0      = get_input(action_slot0)->just_active;
         auto gravity    = get_input(action_gravity)->just_active;
+        auto undo       = get_input(action_undo)->just_active;
+        auto redo       = get_input(action_redo)->just_active;
         auto next_tool  = get_input(action_tool_next)->just_active;
         auto prev_tool  = get_input(action_tool_prev)->just_active;
 
@@ -2315,6 +2444,10 @@ struct play_state : game_state {
         if (slot9) set_slot(9);
         if (slot0) set_slot(0);
 
+        /* undo/redo the build tools' edits */
+        if (undo) ship->undo();
+        if (redo) ship->redo();
+
         /* limit to unit vector */
         float len = glm::length(pl.move);
         if (len > 0.0f)
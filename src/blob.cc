@@ -15,7 +15,7 @@
 #include "blob.h"
 
 
-blob::blob(char const *filename)
+blob::blob(char const *filename, bool writable)
     : fd(-1), data(0), len(0)
 {
 #ifndef _WIN32
@@ -30,9 +30,9 @@ blob::blob(char const *filename)
     fstat(fd, &st);
 
     len = st.st_size;
-    /* client should not expect the memory to be writable, but we'll set this up as CoW
-     * in case they mprotect() it. */
-    data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* unless asked for, client should not expect the memory to be writable, but we'll
+     * set this up as CoW in case they mprotect() it. */
+    data = mmap(NULL, len, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
 
     if (data == MAP_FAILED)
         err(1, "Failed to mmap contents of blob: %s\n", filename);
@@ -5,6 +5,8 @@ struct blob {
     void *data;
     size_t len;
 
-    blob(char const *filename);
+    /* maps the whole of filename. if writable, the mapping is private: writes
+     * go to this process's copy of the pages, never to the file */
+    blob(char const *filename, bool writable = false);
     ~blob();
 };
@@ -15,9 +15,21 @@ enum surface_type : unsigned char {
 
     surface_door,
 
+    /* an open door lets light through, and air -- but not as far as
+     * air_permeable() is concerned: the atmosphere topology divides the
+     * ship into spaces at every door, open or shut, and the air either
+     * side of an open one is joined up by ship_space::open_doors instead.
+     * so a door opening and closing never changes the topology */
+    surface_door_open = surface_door & ~surface_blocks_light,
+
     surface_grate = surface_blocks_light,
 
     surface_glass = surface_blocks_air,
+
+    /* a vent lets air through slowly, between spaces which, like those
+     * either side of an open door, the topology keeps apart. see
+     * ship_space::vents */
+    surface_vent = surface_blocks_air | 0x02,
 };
 
 /* 6 surfaces currently, all axis aligned
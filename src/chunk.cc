@@ -0,0 +1,605 @@
+#include "chunk.h"
+
+#include <math.h>
+#include <new>
+#include <glm/glm.hpp>
+
+
+/* objects per slab, for slabs of about 1M whatever the CHUNK_SIZE.
+ * at the default of 8 that is ~85 expanded block arrays or ~125 chunks */
+static inline constexpr unsigned
+per_slab(size_t size)
+{
+    return size >= (1u << 20) ? 1 : (unsigned)((1u << 20) / size);
+}
+
+static slab_pool<chunk, per_slab(sizeof(chunk))> chunk_pool;
+static slab_pool<dense_blocks, per_slab(sizeof(dense_blocks))> dense_blocks_pool;
+static slab_pool<topo_info, per_slab(sizeof(topo_info))> topo_pool;
+
+
+void *
+chunk::operator new(size_t size)
+{
+    assert(size == sizeof(chunk));
+    return chunk_pool.alloc();
+}
+
+
+void
+chunk::operator delete(void *p)
+{
+    chunk_pool.free(p);
+}
+
+
+chunk::~chunk()
+{
+    for (auto &g : groups) {
+        delete g.node;
+    }
+}
+
+
+void *
+topo_info::operator new(size_t size)
+{
+    assert(size == sizeof(topo_info));
+    return topo_pool.alloc();
+}
+
+
+void
+topo_info::operator delete(void *p)
+{
+    topo_pool.free(p);
+}
+
+
+slab_pool_stats
+chunk_pool_stats()
+{
+    return chunk_pool.stats;
+}
+
+
+slab_pool_stats
+chunk_blocks_pool_stats()
+{
+    return dense_blocks_pool.stats;
+}
+
+
+bool
+blocks_equal(block const *a, block const *b)
+{
+    if (a->type != b->type)
+        return false;
+
+    for (int i = 0; i < face_count; i++) {
+        if (a->surfs[i] != b->surfs[i] || a->surf_space[i] != b->surf_space[i])
+            return false;
+    }
+
+    return true;
+}
+
+
+chunk_blocks::chunk_blocks()
+    : dense(nullptr)
+{
+    memset(&uniform, 0, sizeof(uniform));
+}
+
+
+chunk_blocks::~chunk_blocks()
+{
+    release();
+}
+
+
+chunk_blocks::chunk_blocks(chunk_blocks const &other)
+    : dense(other.dense), uniform(other.uniform)
+{
+    if (dense)
+        dense->refs++;
+}
+
+
+chunk_blocks &
+chunk_blocks::operator=(chunk_blocks const &other)
+{
+    if (other.dense)
+        other.dense->refs++;
+
+    release();
+    dense = other.dense;
+    uniform = other.uniform;
+    return *this;
+}
+
+
+/* drop our reference to the full array, freeing it if we were the last */
+void
+chunk_blocks::release()
+{
+    if (dense && !--dense->refs)
+        dense_blocks_pool.free(dense);
+
+    dense = nullptr;
+}
+
+
+bool
+chunk_blocks::same_storage(chunk_blocks const &other) const
+{
+    if (dense || other.dense)
+        return dense == other.dense;
+
+    return blocks_equal(&uniform, &other.uniform);
+}
+
+
+void
+chunk_blocks::expand()
+{
+    if (dense)
+        return;
+
+    dense = new (dense_blocks_pool.alloc()) dense_blocks();
+    dense->refs = 1;
+
+    block const &u = uniform;
+    dense->cells.for_each([&u](unsigned, unsigned, unsigned, block &b) {
+        b = u;
+    });
+}
+
+
+void
+chunk_blocks::unshare()
+{
+    if (!dense || dense->refs == 1)
+        return;
+
+    dense_blocks *copy = new (dense_blocks_pool.alloc()) dense_blocks();
+    copy->refs = 1;
+    memcpy(&copy->cells, &dense->cells, sizeof(copy->cells));
+
+    dense->refs--;
+    dense = copy;
+}
+
+
+bool
+chunk_blocks::compact()
+{
+    if (!dense)
+        return true;
+
+    block const *first = dense->cells.get(0, 0, 0);
+    bool same = true;
+
+    dense->cells.for_each([first, &same](unsigned, unsigned, unsigned, block const &b) {
+        same = same && blocks_equal(first, &b);
+    });
+
+    if (!same)
+        return false;
+
+    uniform = *first;
+    release();
+    return true;
+}
+
+
+size_t
+chunk_blocks::memory_used() const
+{
+    return sizeof(*this) + (dense ? sizeof(*dense) : 0);
+}
+
+
+void
+chunk_mask::fill(bool on)
+{
+    for (auto &r : rows) {
+        r = on ? chunk_row_full : 0;
+    }
+}
+
+
+bool
+chunk_mask::none() const
+{
+    for (auto r : rows) {
+        if (r)
+            return false;
+    }
+
+    return true;
+}
+
+
+static_assert(surface_blocks_air == 1 << 7 && surface_blocks_light == 1 << 6,
+              "update_masks() shifts the surface type's bits straight into its masks");
+
+void
+chunk::update_masks()
+{
+    if (blocks.is_uniform()) {
+        block const *b = &blocks.uniform;
+        occupied.fill(b->type != block_empty);
+        scaffolding.fill(b->type == block_support);
+        for (int face = 0; face < face_count; face++) {
+            blocks_air[face].fill(!air_permeable(b->surfs[face]));
+            blocks_light[face].fill(!light_permeable(b->surfs[face]));
+        }
+        seals_stale = true;
+        return;
+    }
+
+    /* a row at a time, each mask's row stored once */
+    for (unsigned z = 0; z < CHUNK_SIZE; z++) {
+        for (unsigned y = 0; y < CHUNK_SIZE; y++) {
+            chunk_row occ = 0, sup = 0, air[face_count] = {}, light[face_count] = {};
+
+            /* the surface type's own blocks_air and blocks_light bits are
+             * shifted straight into place */
+            for (unsigned x = 0; x < CHUNK_SIZE; x++) {
+                block const *b = blocks.peek(x, y, z);
+                occ |= (chunk_row)((b->type != block_empty) << x);
+                sup |= (chunk_row)((b->type == block_support) << x);
+
+                for (int face = 0; face < face_count; face++) {
+                    unsigned st = b->surfs[face];
+                    air[face] |= (chunk_row)((st & surface_blocks_air) >> 7 << x);
+                    light[face] |= (chunk_row)((st & surface_blocks_light) >> 6 << x);
+                }
+            }
+
+            unsigned r = y + CHUNK_SIZE * z;
+            occupied.rows[r] = occ;
+            scaffolding.rows[r] = sup;
+            for (int face = 0; face < face_count; face++) {
+                blocks_air[face].rows[r] = air[face];
+                blocks_light[face].rows[r] = light[face];
+            }
+        }
+    }
+
+    seals_stale = true;
+}
+
+
+void
+chunk::update_masks(unsigned x, unsigned y, unsigned z)
+{
+    block const *b = blocks.peek(x, y, z);
+    occupied.set(x, y, z, b->type != block_empty);
+    scaffolding.set(x, y, z, b->type == block_support);
+    for (int face = 0; face < face_count; face++) {
+        blocks_air[face].set(x, y, z, !air_permeable(b->surfs[face]));
+        blocks_light[face].set(x, y, z, !light_permeable(b->surfs[face]));
+    }
+    seals_stale = true;
+}
+
+
+unsigned
+chunk::update_seals(chunk const *const *neighbours)
+{
+    /* whether the block across face from p is sealed */
+    auto sealed_across = [&](glm::ivec3 p, int face) {
+        int axis = face >> 1;
+        p[axis] += (face & 1) ? -1 : 1;
+        if ((unsigned)p[axis] < CHUNK_SIZE)
+            return sealed.test(p.x, p.y, p.z);
+
+        chunk const *n = neighbours[face];
+        p[axis] &= CHUNK_MASK;
+        return n && n->sealed.test(p.x, p.y, p.z);
+    };
+
+    unsigned changed = 0;
+    std::vector<glm::ivec3> open;
+    auto unseal = [&](glm::ivec3 p) {
+        sealed.set(p.x, p.y, p.z, false);
+        open.push_back(p);
+        for (int axis = 0; axis < 3; axis++) {
+            if (p[axis] == CHUNK_SIZE - 1)
+                changed |= 1u << (2 * axis);
+            else if (p[axis] == 0)
+                changed |= 1u << (2 * axis + 1);
+        }
+    };
+
+    /* a sealed block with a face which lets light through onto a block
+     * which isn't sealed can be seen into; and so then can the sealed
+     * blocks which let light through onto it, and so on */
+    for (int k = 0; k < CHUNK_SIZE; k++) {
+        for (int j = 0; j < CHUNK_SIZE; j++) {
+            if (!sealed.row(j, k))
+                continue;
+
+            for (int i = 0; i < CHUNK_SIZE; i++) {
+                glm::ivec3 p(i, j, k);
+                if (!sealed.test(i, j, k))
+                    continue;
+
+                for (int face = 0; face < face_count; face++) {
+                    if (!blocks_light[face].test(i, j, k) && !sealed_across(p, face)) {
+                        unseal(p);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    while (!open.empty()) {
+        glm::ivec3 p = open.back();
+        open.pop_back();
+
+        for (int face = 0; face < face_count; face++) {
+            glm::ivec3 q = p;
+            q[face >> 1] += (face & 1) ? -1 : 1;
+            if ((unsigned)q[face >> 1] >= CHUNK_SIZE)
+                continue;
+
+            if (sealed.test(q.x, q.y, q.z) && !blocks_light[face ^ 1].test(q.x, q.y, q.z))
+                unseal(q);
+        }
+    }
+
+    return changed;
+}
+
+
+/* a copy of src, scaled up from the origin and moved to offset; the
+ * surface meshes are flat unit quads, so stretching one over a rectangle
+ * of blocks makes a quad covering it */
+static void
+stamp_scaled(std::vector<vertex> *verts, std::vector<unsigned> *indices,
+             sw_mesh const *src, glm::vec3 offset, glm::vec3 scale, int mat)
+{
+    unsigned index_base = (unsigned)verts->size();
+
+    for (unsigned int i = 0; i < src->num_vertices; i++) {
+        vertex v = src->verts[i];
+        v.x = v.x * scale.x + offset.x;
+        v.y = v.y * scale.y + offset.y;
+        v.z = v.z * scale.z + offset.z;
+        v.mat = mat;
+        verts->push_back(v);
+    }
+
+    for (unsigned int i = 0; i < src->num_indices; i++)
+        indices->push_back(index_base + src->indices[i]);
+}
+
+static void
+stamp_at_offset(std::vector<vertex> *verts, std::vector<unsigned> *indices,
+                sw_mesh const *src, glm::vec3 offset, int mat)
+{
+    stamp_scaled(verts, indices, src, offset, glm::vec3(1.0f), mat);
+}
+
+
+static int surface_type_to_material[256];
+
+void
+mesher_init()
+{
+    memset(surface_type_to_material, 0, sizeof(surface_type_to_material));
+    surface_type_to_material[surface_none] = 0;
+    surface_type_to_material[surface_wall] = 2;
+    surface_type_to_material[surface_grate] = 4;
+    surface_type_to_material[surface_glass] = 6;
+    surface_type_to_material[surface_door] = 16;
+    surface_type_to_material[surface_vent] = 4;
+}
+
+
+/* which face of the unit cube the triangle a, b, c lies flat against,
+ * facing out; or face_count if none */
+static int
+triangle_face(vertex const &a, vertex const &b, vertex const &c)
+{
+    glm::vec3 pa(a.x, a.y, a.z), pb(b.x, b.y, b.z), pc(c.x, c.y, c.z);
+    glm::vec3 n = glm::cross(pb - pa, pc - pa);
+
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+            float plane = side ? 0.0f : 1.0f;
+            if (fabsf(pa[axis] - plane) < 1e-4f && fabsf(pb[axis] - plane) < 1e-4f &&
+                fabsf(pc[axis] - plane) < 1e-4f && (side ? -n[axis] : n[axis]) > 0) {
+                return 2 * axis + side;
+            }
+        }
+    }
+
+    return face_count;
+}
+
+mesh_parts::mesh_parts(sw_mesh const *src)
+{
+    std::vector<int> remap[face_count + 1];
+
+    for (unsigned int i = 0; i + 2 < src->num_indices; i += 3) {
+        unsigned const *tri = src->indices + i;
+        int face = triangle_face(src->verts[tri[0]], src->verts[tri[1]], src->verts[tri[2]]);
+
+        std::vector<int> &r = remap[face];
+        if (r.empty())
+            r.resize(src->num_vertices, -1);
+
+        for (int v = 0; v < 3; v++) {
+            if (r[tri[v]] < 0) {
+                r[tri[v]] = (int)verts[face].size();
+                verts[face].push_back(src->verts[tri[v]]);
+            }
+            indices[face].push_back((unsigned)r[tri[v]]);
+        }
+    }
+
+    for (int face = 0; face <= face_count; face++) {
+        sw_mesh &m = part[face];
+        m.verts = verts[face].data();
+        m.indices = indices[face].data();
+        m.num_vertices = (unsigned)verts[face].size();
+        m.num_indices = (unsigned)indices[face].size();
+    }
+}
+
+
+void
+chunk::build_mesh(mesh_parts const *scaffold, sw_mesh *const *surfs,
+                  chunk const *const *neighbours,
+                  std::vector<vertex> *verts, std::vector<unsigned> *indices) const
+{
+    /* uniform empty space draws nothing */
+    if (blocks.is_uniform() && blocks.uniform.type == block_empty) {
+        int surf = 0;
+        while (surf < face_count && blocks.uniform.surfs[surf] == surface_none)
+            surf++;
+        if (surf == face_count)
+            return;
+    }
+
+    /* the blocks in and around the chunk, one deep across each face: whether
+     * each is scaffolding, and sealed (see chunk::sealed), and which of its
+     * faces are shut off from light by a surface. a block in a chunk which
+     * isn't there looks empty and unsealed, which only ever means drawing
+     * more. on the heap: at CHUNK_SIZE 32 they are over 100KB together,
+     * too much for the stack */
+    int const pad = CHUNK_SIZE + 2;
+    std::vector<unsigned char> scratch(3 * pad * pad * pad);
+    unsigned char *solid = &scratch[0];
+    unsigned char *shut = solid + pad * pad * pad;
+    unsigned char *sealed = shut + pad * pad * pad;
+    int const step[face_count] = { 1, -1, pad, -pad, pad * pad, -pad * pad };
+
+    auto index = [&](glm::ivec3 p) {
+        return (p.x + 1) + pad * ((p.y + 1) + pad * (p.z + 1));
+    };
+
+    auto fill = [&](chunk const *src, glm::ivec3 lo, glm::ivec3 hi, glm::ivec3 shift) {
+        for (int k = lo.z; k <= hi.z; k++) {
+            for (int j = lo.y; j <= hi.y; j++) {
+                for (int i = lo.x; i <= hi.x; i++) {
+                    block const *b = src->blocks.peek(i, j, k);
+                    int n = index(glm::ivec3(i, j, k) + shift);
+                    solid[n] = b->type == block_support;
+                    sealed[n] = src->sealed.test(i, j, k);
+                    for (int face = 0; face < face_count; face++) {
+                        shut[n] |= !light_permeable(b->surfs[face]) << face;
+                    }
+                }
+            }
+        }
+    };
+
+    fill(this, glm::ivec3(0), glm::ivec3(CHUNK_SIZE - 1), glm::ivec3(0));
+    for (int face = 0; face < face_count; face++) {
+        if (!neighbours[face])
+            continue;
+
+        int axis = face >> 1;
+        glm::ivec3 lo(0), hi(CHUNK_SIZE - 1), shift(0);
+        if (face & 1) {
+            lo[axis] = CHUNK_SIZE - 1;
+            shift[axis] = -CHUNK_SIZE;
+        }
+        else {
+            hi[axis] = 0;
+            shift[axis] = CHUNK_SIZE;
+        }
+        fill(neighbours[face], lo, hi, shift);
+    }
+
+    for (int k = 0; k < CHUNK_SIZE; k++)
+        for (int j = 0; j < CHUNK_SIZE; j++)
+            for (int i = 0; i < CHUNK_SIZE; i++) {
+                glm::ivec3 p(i, j, k);
+                int n = index(p);
+                if (!solid[n] || sealed[n])
+                    continue;
+
+                // TODO: block detail, variants, types, surfaces
+                stamp_at_offset(verts, indices, &scaffold->part[face_count], glm::vec3(p), 1);
+
+                /* the scaffolding on a face is flush against the same on
+                 * the next block over, or under this block's own surface
+                 * there */
+                for (int face = 0; face < face_count; face++) {
+                    if (!solid[n + step[face]] && !((shut[n] >> face) & 1))
+                        stamp_at_offset(verts, indices, &scaffold->part[face], glm::vec3(p), 1);
+                }
+            }
+
+    /* the surfaces, a slice of the chunk at a time for each face, with
+     * those of the same material merged into rectangles: surfs[face] is
+     * stretched over each. texture co-ords come from world position (see
+     * simple_instanced.vert), so they tile across a rectangle just as
+     * they did across its blocks */
+    for (int face = 0; face < face_count; face++) {
+        int axis = face >> 1, u = (axis + 1) % 3, w = (axis + 2) % 3;
+
+        for (int d = 0; d < CHUNK_SIZE; d++) {
+            /* the material of each surface to draw in the slice, plus one;
+             * zero where there is none */
+            int mat[CHUNK_SIZE][CHUNK_SIZE] = {};
+
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                for (int i = 0; i < CHUNK_SIZE; i++) {
+                    glm::ivec3 p;
+                    p[axis] = d;
+                    p[u] = i;
+                    p[w] = j;
+                    surface_type st = this->blocks.peek(p.x, p.y, p.z)->surfs[face];
+
+                    /* an open door is drawn by its entity; and a surface
+                     * faces out of its block, so is seen only from the
+                     * next one */
+                    if (st != surface_none && st != surface_door_open && !sealed[index(p) + step[face]])
+                        mat[j][i] = surface_type_to_material[st] + 1;
+                }
+            }
+
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                for (int i = 0; i < CHUNK_SIZE; i++) {
+                    int m = mat[j][i];
+                    if (!m)
+                        continue;
+
+                    /* as wide as it will go, then as tall */
+                    int width = 1, height = 1;
+                    while (i + width < CHUNK_SIZE && mat[j][i + width] == m)
+                        width++;
+                    for (; j + height < CHUNK_SIZE; height++) {
+                        int x = 0;
+                        while (x < width && mat[j + height][i + x] == m)
+                            x++;
+                        if (x < width)
+                            break;
+                    }
+
+                    for (int y = 0; y < height; y++) {
+                        for (int x = 0; x < width; x++) {
+                            mat[j + y][i + x] = 0;
+                        }
+                    }
+
+                    glm::vec3 offset, scale(1.0f);
+                    offset[axis] = (float)d;
+                    offset[u] = (float)i;
+                    offset[w] = (float)j;
+                    scale[u] = (float)width;
+                    scale[w] = (float)height;
+                    stamp_scaled(verts, indices, surfs[face], offset, scale, m - 1);
+                }
+            }
+        }
+    }
+}
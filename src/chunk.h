@@ -3,14 +3,59 @@
 #include "block.h"
 #include "fixed_cube.h"
 #include "mesh.h"
+#include "slab_pool.h"
 
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <list>
+#include <type_traits>
 #include <vector>
 
+/* edge length of a chunk, in blocks. one chunk is one draw call and one
+ * static rigid body, so this trades per-chunk overhead against the cost of
+ * rebuilding a chunk after an edit. overridable at build time, so the sizes
+ * can be benchmarked against each other; must be a power of two.
+ */
+#ifndef CHUNK_SIZE
 #define CHUNK_SIZE 8
+#endif
+
+static_assert(CHUNK_SIZE >= 2 && (CHUNK_SIZE & (CHUNK_SIZE - 1)) == 0,
+              "CHUNK_SIZE must be a power of two");
+
+static inline constexpr int
+chunk_size_log2(int n)
+{
+    return n > 1 ? 1 + chunk_size_log2(n >> 1) : 0;
+}
+
+/* block co-ord p is in chunk (p >> CHUNK_SHIFT), at offset (p & CHUNK_MASK) */
+#define CHUNK_SHIFT chunk_size_log2(CHUNK_SIZE)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+
+/* storage order of the blocks and topo within a chunk (see fixed_cube.h).
+ * overridable so the layouts can be benchmarked against each other */
+#ifndef CHUNK_LAYOUT
+#define CHUNK_LAYOUT layout_x_fastest
+#endif
 
 struct entity;
 
-class btTriangleMesh;
+/* a mesh drawn for each block, such as the scaffold, in parts: part[face]
+ * is the triangles which lie flat against that face of the unit cube,
+ * facing out, and part[face_count] the rest. see chunk::build_mesh */
+struct mesh_parts {
+    std::vector<vertex> verts[face_count + 1];
+    std::vector<unsigned> indices[face_count + 1];
+    sw_mesh part[face_count + 1] {};
+
+    explicit mesh_parts(sw_mesh const *src);
+
+    /* part points into verts and indices */
+    mesh_parts(mesh_parts const &) = delete;
+    mesh_parts & operator=(mesh_parts const &) = delete;
+};
+
 class btCollisionShape;
 class btRigidBody;
 
@@ -19,8 +64,7 @@ struct render_chunk {
     bool valid = false;
 
 
-    btTriangleMesh *phys_mesh = nullptr;
-    btCollisionShape *phys_shape = nullptr;
+    btCollisionShape *phys_shape = nullptr;     /* a chunk_shape; lasts while the chunk is resident */
     btRigidBody *phys_body = nullptr;
 };
 
@@ -28,16 +72,210 @@ struct topo_info {
     topo_info *p;
     int rank;
     int size;   /* if p==this, then the number of blocks in this cc */
+    int zone;   /* if p==this, its zone's index in ship_space::zones; else -1 */
+
+    /* the nodes of chunk groups are carved out of slabs; see chunk_group */
+    static void * operator new(size_t size);
+    static void operator delete(void *p);
+};
+
+/* the air within a chunk is in groups: the blocks which air can get
+ * between without leaving the chunk. each group has a topo node, and
+ * the union-find across the ship is over those nodes, not over blocks.
+ * see ship_space::rebuild_topology */
+struct chunk_group {
+    topo_info *node;            /* owned by the chunk */
+    int size;                   /* blocks in the group */
+};
+
+/* a way out of a chunk for the air of one of its groups, across one of
+ * its faces: into group `other` of the chunk on that side, or into the
+ * chunk on that side if it is missing (implicit, or the outside), in
+ * which case other is 0. there is one per pair of groups which meet
+ * through an open surface, however many surfaces that is */
+struct chunk_portal {
+    unsigned short group;
+    unsigned short other;
+};
+
+static_assert(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE < 65536,
+              "chunk group ids must fit an unsigned short");
+
+/* one row of a chunk_mask: a bit for each block along x */
+typedef std::conditional<CHUNK_SIZE <= 8, uint8_t,
+        std::conditional<CHUNK_SIZE <= 16, uint16_t, uint32_t>::type>::type chunk_row;
+
+static_assert(CHUNK_SIZE <= 32, "a chunk row must fit a uint32_t");
+
+/* a row with every bit set */
+static const chunk_row chunk_row_full = (chunk_row)((1ull << CHUNK_SIZE) - 1);
+
+/* a bit for each block of a chunk, packed in rows along x: bit x of
+ * rows[y + CHUNK_SIZE * z], whatever CHUNK_LAYOUT is. small enough to
+ * stay in cache, and a whole row can be tested at once */
+struct chunk_mask {
+    chunk_row rows[CHUNK_SIZE * CHUNK_SIZE];
+
+    chunk_mask() : rows() {}
+
+    chunk_row row(unsigned y, unsigned z) const
+    {
+        return rows[y + CHUNK_SIZE * z];
+    }
+
+    bool test(unsigned x, unsigned y, unsigned z) const
+    {
+        return (row(y, z) >> x) & 1;
+    }
+
+    void set(unsigned x, unsigned y, unsigned z, bool on)
+    {
+        chunk_row &r = rows[y + CHUNK_SIZE * z];
+        r = on ? (chunk_row)(r | 1u << x) : (chunk_row)(r & ~(1u << x));
+    }
+
+    /* set (or clear) every bit */
+    void fill(bool on);
+
+    /* true if no bit is set */
+    bool none() const;
+};
+
+/* the full array of blocks behind a chunk_blocks. it may be shared between
+ * several chunk_blocks -- a chunk and its snapshots (see ship_space::snapshot)
+ * -- and is copied by the first of them to write to it.
+ *
+ * the count is not atomic: sharers may be read from any thread, but must be
+ * copied and destroyed on the one which edits the ship.
+ */
+struct dense_blocks {
+    unsigned refs;
+    fixed_cube<block, CHUNK_SIZE, CHUNK_LAYOUT> cells;
+};
+
+/* the blocks of a chunk
+ *
+ * a chunk whose blocks are all identical (most often: all empty space) is
+ * stored as just that one block. the full array is allocated the first time
+ * a block is handed out for writing via get(), and can be collapsed back
+ * down with compact().
+ *
+ * copying a chunk_blocks is cheap: the copy shares the full array, and
+ * whichever side next calls get() takes a private copy of it first. so
+ * as with compact(), making a copy invalidates block pointers previously
+ * handed out by get().
+ *
+ * passes which only read blocks should use peek(), which never expands
+ * or copies.
+ */
+struct chunk_blocks {
+    dense_blocks *dense;                    /* null while uniform; maybe shared */
+    block uniform;                          /* every block, while uniform */
+
+    chunk_blocks();
+    ~chunk_blocks();
+
+    /* these share other's full array; O(1) */
+    chunk_blocks(chunk_blocks const &other);
+    chunk_blocks & operator=(chunk_blocks const &other);
+
+    /* writable access to the block at (x, y, z); expands a uniform chunk,
+     * and unshares a shared one */
+    block * get(unsigned int x, unsigned int y, unsigned int z)
+    {
+        if (!dense)
+            expand();
+        else if (dense->refs > 1)
+            unshare();
+
+        return dense->cells.get(x, y, z);
+    }
+
+    /* read-only access to the block at (x, y, z) */
+    block const * peek(unsigned int x, unsigned int y, unsigned int z) const
+    {
+        return dense ? dense->cells.get(x, y, z) : &uniform;
+    }
+
+    bool is_uniform() const
+    {
+        return !dense;
+    }
+
+    bool is_shared() const
+    {
+        return dense && dense->refs > 1;
+    }
+
+    /* true if this and other certainly hold the same blocks, without
+     * comparing them one by one */
+    bool same_storage(chunk_blocks const &other) const;
+
+    /* switch to the full array, filled with the uniform block */
+    void expand();
+
+    /* replace a shared full array with a private copy of it */
+    void unshare();
+
+    /* collapse to the uniform representation if every block is identical.
+     * invalidates any block pointers previously handed out by get().
+     * returns true if the chunk is uniform afterwards.
+     */
+    bool compact();
+
+    /* bytes of block storage currently in use. a shared array is counted
+     * by each of its sharers */
+    size_t memory_used() const;
+
+private:
+    void release();
 };
 
 struct chunk {
-    /* with a CHUNK_SIZE of 8
-     * we have 8^3 blocks
+    /* CHUNK_SIZE^3 blocks; with the default CHUNK_SIZE of 8
      * this means a chunk represents
      * 8m^3
      */
-    fixed_cube<block, CHUNK_SIZE> blocks;
-    fixed_cube<topo_info, CHUNK_SIZE> topo;
+    chunk_blocks blocks;
+
+    /* the atmosphere topology: which group each block is in, those
+     * groups, and the portals out of the chunk across each face */
+    fixed_cube<unsigned short, CHUNK_SIZE, CHUNK_LAYOUT> group;
+    std::vector<chunk_group> groups;
+    std::vector<chunk_portal> portals[6];
+    unsigned topo_base = 0;             /* number of groups[0]'s node, within rebuild_topology() */
+
+    /* the blocks in brief, for passes which don't need all of each one:
+     * which aren't empty, which are scaffolding, and which faces of each
+     * have a surface which blocks air, or light. ship_space's edits keep
+     * them up to date, and rebuild_topology() works them out again, for
+     * callers which wrote the blocks themselves. like the topology, they
+     * stay while the chunk is paged out */
+    chunk_mask occupied;
+    chunk_mask scaffolding;
+    chunk_mask blocks_air[face_count];
+    chunk_mask blocks_light[face_count];
+    bool masks_stale = true;            /* blocks may have been written since; see ship_space::get_block */
+
+    /* work the masks out again from the blocks, which must be resident:
+     * all of them, or just those of the block at (x, y, z) */
+    void update_masks();
+    void update_masks(unsigned x, unsigned y, unsigned z);
+
+    /* the scaffolding which is walled in so that it can't be seen into,
+     * from anywhere in the ship: build_mesh() draws nothing facing into
+     * it. kept by ship_space::update_seals(), from the masks, so it too
+     * stays while the chunk is paged out */
+    chunk_mask sealed;
+    bool seals_stale = true;            /* the masks have changed since */
+
+    /* one pass of ship_space::update_seals(): unseal the blocks which can
+     * be seen into, from an unsealed block in this chunk or across a face
+     * into neighbours[face] (the chunk there, or null if there is none, in
+     * which case it is all open). it only ever unseals. returns a bit for
+     * each face where a block against it was unsealed, as the chunk there
+     * must then have its pass again */
+    unsigned update_seals(chunk const *const *neighbours);
 
     /* rendering information */
     struct render_chunk render_chunk;
@@ -45,8 +283,91 @@ struct chunk {
     /* entities */
     std::vector<entity *> entities;
 
-    void prepare_render(int x, int y, int z);
+    /* residency (see ship_space::update_residency). while a chunk is paged
+     * out its blocks live in the ship's chunk_store, and blocks is left
+     * empty; the topology and entities always stay */
+    bool resident = true;
+    bool requested = false;             /* a background load is in flight */
+    unsigned generation = 0;            /* times paged out, to spot stale loads */
+    unsigned last_used = 0;             /* ship_space::residency_frame when last wanted */
+    std::list<glm::ivec3>::iterator lru;    /* place in ship_space::lru, while resident */
+
+    /* build the render geometry for this chunk: a copy of scaffold for every
+     * scaffolding block, and of surfs[face] stretched over each rectangle of
+     * like surfaces, less what can't be seen -- the parts of scaffold flat
+     * against each face of the unit cube are left out where they meet more
+     * scaffolding or a surface, and nothing is drawn facing into a sealed
+     * block (see sealed). neighbours[face] is the chunk across each face,
+     * or null if there is none or it isn't resident, in which case the
+     * faces against it are all drawn. no GL here; see prepare_render() for
+     * the upload.
+     */
+    void build_mesh(mesh_parts const *scaffold, sw_mesh *const *surfs,
+                    chunk const *const *neighbours,
+                    std::vector<vertex> *verts, std::vector<unsigned> *indices) const;
+
+    void prepare_render(int x, int y, int z, chunk const *const *neighbours);
+
+    /* calls f(glm::ivec3 block, int face) for each face which collides, of
+     * the blocks lo..hi (offsets within the chunk, inclusive): the outside
+     * of each scaffolding block, but not where it meets another, and once,
+     * each surface build_mesh() draws which isn't up against scaffolding.
+     * neighbours are as for build_mesh(); where there is none, the faces
+     * against it all collide from this side. see chunk_shape */
+    template<typename F>
+    void collision_faces(glm::ivec3 lo, glm::ivec3 hi, chunk const *const *neighbours, F f) const
+    {
+        for (int k = lo.z; k <= hi.z; k++) {
+            for (int j = lo.y; j <= hi.y; j++) {
+                for (int i = lo.x; i <= hi.x; i++) {
+                    block const *b = blocks.peek(i, j, k);
+                    bool solid = b->type == block_support;
+
+                    for (int face = 0; face < face_count; face++) {
+                        surface_type s = b->surfs[face];
+                        if (!solid && (s == surface_none || s == surface_door_open))
+                            continue;
+
+                        glm::ivec3 q(i, j, k);
+                        q[face >> 1] += (face & 1) ? -1 : 1;
+                        chunk const *other = this;
+                        if ((unsigned)q[face >> 1] >= CHUNK_SIZE) {
+                            other = neighbours[face];
+                            q[face >> 1] &= CHUNK_MASK;
+                        }
+                        if (other && other->blocks.peek(q.x, q.y, q.z)->type == block_support)
+                            continue;
+
+                        /* a surface between two blocks is on both; the
+                         * lower block's will do, in this chunk or not */
+                        if (solid || !other || !(face & 1))
+                            f(glm::ivec3(i, j, k), face);
+                    }
+                }
+            }
+        }
+    }
+
+    /* the topo node of the block at (x, y, z) */
+    topo_info * topo(unsigned x, unsigned y, unsigned z)
+    {
+        return groups[*group.get(x, y, z)].node;
+    }
+
+    ~chunk();
+
+    /* chunks are carved out of slabs rather than allocated one by one;
+     * see chunk_pool_stats() */
+    static void * operator new(size_t size);
+    static void operator delete(void *p);
 };
 
+/* true if a and b are the same block */
+bool blocks_equal(block const *a, block const *b);
+
+/* allocation counters for the pools backing chunks and expanded chunk blocks */
+slab_pool_stats chunk_pool_stats();
+slab_pool_stats chunk_blocks_pool_stats();
+
 /* must be called once before the mesher can be used */
 void mesher_init();
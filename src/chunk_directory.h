@@ -0,0 +1,193 @@
+#pragma once
+
+#include <glm/glm.hpp> /* ivec3 */
+#include <utility>
+#include <vector>
+
+struct chunk;
+
+/* a dense directory of chunk pointers, keyed by chunk co-ords
+ *
+ * the directory covers the box origin..origin+dims-1 (inclusive) and
+ * stores one pointer per chunk position in that box, x fastest.
+ * a lookup is a bounds check and a single index calculation; there is
+ * no hashing and no probing.
+ *
+ * positions within the box which have no chunk are null.
+ *
+ * when a chunk is set outside the box, the box is grown (with some slack
+ * along the axes which grew, so that a ship extended one chunk at a time
+ * does not re-layout the directory on every step) and the existing
+ * entries are moved across.
+ */
+struct chunk_directory {
+    glm::ivec3 origin;      /* chunk co-ords of entries[0] */
+    glm::ivec3 dims;        /* size of the box along each axis */
+
+    std::vector<chunk *> entries;
+
+    /* number of non-null entries */
+    unsigned count;
+
+    chunk_directory()
+        : origin(), dims(), count(0)
+    {
+    }
+
+    /* returns the chunk at chunk co-ords ch, or null */
+    chunk * get(glm::ivec3 ch) const
+    {
+        /* negative offsets wrap around to huge unsigned values, so a single
+         * compare per axis covers both ends of the box */
+        unsigned x = (unsigned)(ch.x - origin.x);
+        unsigned y = (unsigned)(ch.y - origin.y);
+        unsigned z = (unsigned)(ch.z - origin.z);
+
+        if (x >= (unsigned)dims.x ||
+            y >= (unsigned)dims.y ||
+            z >= (unsigned)dims.z) {
+            return nullptr;
+        }
+
+        return entries[x + dims.x * (y + dims.y * z)];
+    }
+
+    /* stores c at chunk co-ords ch, growing the directory if required.
+     * storing null removes any existing entry.
+     */
+    void set(glm::ivec3 ch, chunk *c)
+    {
+        if (!contains(ch)) {
+            if (!c) {
+                /* nothing to remove */
+                return;
+            }
+
+            grow_to_include(ch);
+        }
+
+        chunk *&slot = entries[index_of(ch)];
+        count += (c != nullptr) - (slot != nullptr);
+        slot = c;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool contains(glm::ivec3 ch) const
+    {
+        glm::ivec3 rel = ch - origin;
+        return rel.x >= 0 && rel.x < dims.x &&
+               rel.y >= 0 && rel.y < dims.y &&
+               rel.z >= 0 && rel.z < dims.z;
+    }
+
+    /* iteration over the non-null entries, yielding (chunk co-ords, chunk *)
+     * pairs in storage order.
+     */
+    struct iterator {
+        chunk_directory const *dir;
+        size_t index;
+        std::pair<glm::ivec3, chunk *> current;
+
+        iterator(chunk_directory const *dir, size_t index)
+            : dir(dir), index(index)
+        {
+            skip_empty();
+        }
+
+        std::pair<glm::ivec3, chunk *> const & operator*() const { return current; }
+        std::pair<glm::ivec3, chunk *> const * operator->() const { return &current; }
+
+        iterator & operator++()
+        {
+            ++index;
+            skip_empty();
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator prev = *this;
+            ++*this;
+            return prev;
+        }
+
+        bool operator==(iterator const &other) const { return index == other.index; }
+        bool operator!=(iterator const &other) const { return index != other.index; }
+
+    private:
+        void skip_empty()
+        {
+            while (index < dir->entries.size() && !dir->entries[index])
+                ++index;
+
+            if (index < dir->entries.size()) {
+                current.first = dir->coords_of(index);
+                current.second = dir->entries[index];
+            }
+        }
+    };
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, entries.size()); }
+
+private:
+    size_t index_of(glm::ivec3 ch) const
+    {
+        glm::ivec3 rel = ch - origin;
+        return (size_t)rel.x + (size_t)dims.x * ((size_t)rel.y + (size_t)dims.y * (size_t)rel.z);
+    }
+
+    glm::ivec3 coords_of(size_t index) const
+    {
+        int x = (int)(index % dims.x);
+        index /= dims.x;
+        int y = (int)(index % dims.y);
+        int z = (int)(index / dims.y);
+        return origin + glm::ivec3(x, y, z);
+    }
+
+    void grow_to_include(glm::ivec3 ch)
+    {
+        glm::ivec3 new_origin, new_max;
+
+        if (entries.empty()) {
+            new_origin = ch;
+            new_max = ch;
+        }
+        else {
+            glm::ivec3 old_max = origin + dims - glm::ivec3(1);
+            new_origin = glm::min(origin, ch);
+            new_max = glm::max(old_max, ch);
+
+            /* pad each axis which grew by half its old extent, in the direction
+             * it grew, so that repeated growth is amortized */
+            for (int axis = 0; axis < 3; axis++) {
+                int slack = dims[axis] / 2;
+                if (new_origin[axis] < origin[axis])
+                    new_origin[axis] -= slack;
+                if (new_max[axis] > old_max[axis])
+                    new_max[axis] += slack;
+            }
+        }
+
+        glm::ivec3 new_dims = new_max - new_origin + glm::ivec3(1);
+        std::vector<chunk *> new_entries((size_t)new_dims.x * new_dims.y * new_dims.z, nullptr);
+
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (!entries[i])
+                continue;
+
+            glm::ivec3 rel = coords_of(i) - new_origin;
+            new_entries[(size_t)rel.x + (size_t)new_dims.x * ((size_t)rel.y + (size_t)new_dims.y * (size_t)rel.z)] =
+                entries[i];
+        }
+
+        origin = new_origin;
+        dims = new_dims;
+        entries.swap(new_entries);
+    }
+};
@@ -0,0 +1,187 @@
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/NarrowPhaseCollision/btRaycastCallback.h>
+#include <LinearMath/btAabbUtil2.h>
+#include <math.h>
+#include <algorithm>
+
+#include "chunk.h"
+#include "chunk_shape.h"
+
+
+chunk_shape::chunk_shape(chunk const *ch)
+    : ch(ch), m_localScaling(1, 1, 1)
+{
+    m_shapeType = CUSTOM_CONCAVE_SHAPE_TYPE;
+    std::fill(neighbours, neighbours + face_count, nullptr);
+}
+
+
+void
+chunk_shape::set_neighbours(chunk const *const *neighbours)
+{
+    std::copy(neighbours, neighbours + face_count, this->neighbours);
+}
+
+
+void
+chunk_shape::process_block(btTriangleCallback *callback, chunk const *const *resident,
+                           int x, int y, int z) const
+{
+    ch->collision_faces(glm::ivec3(x, y, z), glm::ivec3(x, y, z), resident, [&](glm::ivec3 p, int face) {
+        /* the quad across the other two axes, wound to face out */
+        int axis = face >> 1;
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        if (face & 1)
+            std::swap(u, v);
+
+        glm::vec3 corner(p);
+        corner[axis] += (face & 1) ? 0 : 1;
+
+        btVector3 q[4];
+        for (int i = 0; i < 4; i++) {
+            glm::vec3 c = corner;
+            c[u] += (i == 1 || i == 2);
+            c[v] += (i >= 2);
+            q[i] = btVector3(c.x, c.y, c.z) * m_localScaling;
+        }
+
+        /* stable across calls, for bullet's contact caching */
+        int index = 2 * (face_count * (p.x + CHUNK_SIZE * (p.y + CHUNK_SIZE * p.z)) + face);
+
+        btVector3 tri[3] = { q[0], q[1], q[2] };
+        callback->processTriangle(tri, 0, index);
+
+        tri[0] = q[0];
+        tri[1] = q[2];
+        tri[2] = q[3];
+        callback->processTriangle(tri, 0, index + 1);
+    });
+}
+
+
+/* the part of the ray from a to b, in blocks, which is inside the chunk:
+ * t0..t1 along it. false if none is */
+static bool
+clip_to_chunk(btVector3 const &a, btVector3 const &d, btScalar *t0, btScalar *t1)
+{
+    *t0 = 0;
+    *t1 = 1;
+    for (int i = 0; i < 3; i++) {
+        if (d[i] == 0) {
+            if (a[i] < 0 || a[i] > CHUNK_SIZE)
+                return false;
+            continue;
+        }
+
+        btScalar near = (0 - a[i]) / d[i];
+        btScalar far = (CHUNK_SIZE - a[i]) / d[i];
+        if (near > far)
+            std::swap(near, far);
+        *t0 = std::max(*t0, near);
+        *t1 = std::min(*t1, far);
+    }
+    return *t0 <= *t1;
+}
+
+
+void
+chunk_shape::processAllTriangles(btTriangleCallback *callback,
+                                 btVector3 const &aabbMin, btVector3 const &aabbMax) const
+{
+    btTriangleRaycastCallback *ray = dynamic_cast<btTriangleRaycastCallback *>(callback);
+
+    chunk const *resident[face_count];
+    for (int face = 0; face < face_count; face++) {
+        chunk const *n = neighbours[face];
+        resident[face] = n && n->resident ? n : nullptr;
+    }
+
+    if (ray) {
+        /* a ray test: just the blocks along the ray, as far as the first
+         * one with a hit, after http://www.cse.yorku.ca/~amana/research/grid.pdf */
+        btVector3 a = ray->m_from / m_localScaling;
+        btVector3 d = ray->m_to / m_localScaling - a;
+        btScalar t0, t1;
+        if (!clip_to_chunk(a, d, &t0, &t1))
+            return;
+
+        btVector3 in = a + d * t0;
+        int p[3], step[3];
+        btScalar t_max[3];
+        for (int i = 0; i < 3; i++) {
+            step[i] = d[i] > 0 ? 1 : -1;
+            p[i] = std::max(0, std::min(CHUNK_SIZE - 1, (int)floorf(in[i])));
+            t_max[i] = d[i] != 0 ? (p[i] + (step[i] > 0) - a[i]) / d[i] : INFINITY;
+        }
+
+        for (;;) {
+            process_block(callback, resident, p[0], p[1], p[2]);
+
+            int i = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+            if (ray->m_hitFraction <= t_max[i] || t_max[i] > t1)
+                return;
+
+            p[i] += step[i];
+            if ((unsigned)p[i] >= CHUNK_SIZE)
+                return;
+            t_max[i] = (p[i] + (step[i] > 0) - a[i]) / d[i];
+        }
+    }
+
+    /* the blocks the box touches, or is right up against */
+    glm::ivec3 lo, hi;
+    for (int i = 0; i < 3; i++) {
+        btScalar min = aabbMin[i] / m_localScaling[i];
+        btScalar max = aabbMax[i] / m_localScaling[i];
+        if (max < 0 || min > CHUNK_SIZE)
+            return;
+
+        lo[i] = std::max(0, (int)floorf(min) - 1);
+        hi[i] = std::min(CHUNK_SIZE - 1, (int)floorf(max));
+    }
+
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int y = lo.y; y <= hi.y; y++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                process_block(callback, resident, x, y, z);
+            }
+        }
+    }
+}
+
+
+void
+chunk_shape::getAabb(btTransform const &t, btVector3 &aabbMin, btVector3 &aabbMax) const
+{
+    btVector3 size = btVector3(CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE) * m_localScaling;
+    btTransformAabb(btVector3(0, 0, 0), size, getMargin(), t, aabbMin, aabbMax);
+}
+
+
+void
+chunk_shape::setLocalScaling(btVector3 const &scaling)
+{
+    m_localScaling = scaling;
+}
+
+
+btVector3 const &
+chunk_shape::getLocalScaling() const
+{
+    return m_localScaling;
+}
+
+
+void
+chunk_shape::calculateLocalInertia(btScalar, btVector3 &inertia) const
+{
+    /* only ever static */
+    inertia.setValue(0, 0, 0);
+}
+
+
+char const *
+chunk_shape::getName() const
+{
+    return "CHUNK";
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <BulletCollision/CollisionShapes/btConcaveShape.h>
+
+#include "block.h" /* face_count */
+
+struct chunk;
+
+/* the static collision of a chunk, straight from its blocks: each face
+ * chunk::collision_faces() gives is a unit quad, made into two triangles
+ * only as bullet asks for the ones in some box. edits to the blocks show
+ * up at once, with nothing to rebuild, and nothing is kept but the chunks.
+ *
+ * ray tests walk the blocks along the ray instead, and stop at the first
+ * block with a hit. the shape is in chunk-local co-ords, and lives as long
+ * as the chunk is resident.
+ *
+ * faces against the neighbouring chunks are left out just as they are
+ * within the chunk, so nothing sticks out along the seams. the neighbours
+ * are those the chunk was last meshed with; one which has since been
+ * paged out counts as none.
+ */
+ATTRIBUTE_ALIGNED16(class) chunk_shape : public btConcaveShape
+{
+    chunk const *ch;
+    chunk const *neighbours[face_count];
+    btVector3 m_localScaling;
+
+    /* the triangles of the block at (x, y, z) within the chunk */
+    void process_block(btTriangleCallback *callback, chunk const *const *resident,
+                       int x, int y, int z) const;
+
+public:
+    BT_DECLARE_ALIGNED_ALLOCATOR();
+
+    chunk_shape(chunk const *ch);
+
+    /* the chunks across each face, as for chunk::build_mesh; kept until
+     * set again */
+    void set_neighbours(chunk const *const *neighbours);
+
+    void processAllTriangles(btTriangleCallback *callback,
+                             btVector3 const &aabbMin, btVector3 const &aabbMax) const override;
+
+    void getAabb(btTransform const &t, btVector3 &aabbMin, btVector3 &aabbMax) const override;
+
+    void setLocalScaling(btVector3 const &scaling) override;
+    btVector3 const & getLocalScaling() const override;
+
+    void calculateLocalInertia(btScalar mass, btVector3 &inertia) const override;
+
+    char const * getName() const override;
+};
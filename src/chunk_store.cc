@@ -0,0 +1,215 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <err.h> /* errx */
+#else
+#include "winerr.h"
+#endif
+
+#include "chunk_store.h"
+
+
+static const uint32_t chunk_blocks_count = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+/* fseek() takes a long, which is only 32 bits on windows; the store can
+ * grow well past 2GB */
+static int
+seek_to(FILE *file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+struct chunk_store_run {
+    uint32_t count;
+    block b;
+};
+
+
+chunk_store::chunk_store(char const *filename)
+    : filename(strdup(filename)), file(fopen(filename, "w+b")), end(0), stopping(false)
+{
+    if (!file)
+        err(1, "Failed to create chunk store %s\n", filename);
+
+    loader = std::thread(&chunk_store::run_loader, this);
+}
+
+
+chunk_store::~chunk_store()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    loader.join();
+
+    fclose(file);
+    remove(filename);
+    free(filename);
+}
+
+
+void
+chunk_store::write(glm::ivec3 ch, chunk_blocks const &blocks)
+{
+    /* collapse the blocks into runs */
+    std::vector<chunk_store_run> runs;
+    if (blocks.is_uniform()) {
+        runs.push_back(chunk_store_run{ chunk_blocks_count, blocks.uniform });
+    }
+    else {
+        block const *cells = blocks.dense->cells.contents;
+        for (uint32_t i = 0; i < chunk_blocks_count; i++) {
+            if (runs.empty() || !blocks_equal(&runs.back().b, &cells[i])) {
+                runs.push_back(chunk_store_run{ 0, cells[i] });
+            }
+            runs.back().count++;
+        }
+    }
+
+    uint32_t num_runs = (uint32_t)runs.size();
+    uint32_t size = sizeof(num_runs) + num_runs * sizeof(chunk_store_run);
+
+    /* back where it was if it fits; on the end if not. a new slot has no
+     * room at all */
+    slot &s = slots[ch];
+    if (s.capacity < size) {
+        s.offset = end;
+        s.capacity = size;
+        end += size;
+    }
+    s.size = size;
+
+    std::lock_guard<std::mutex> lock(file_lock);
+    if (seek_to(file, s.offset) ||
+        fwrite(&num_runs, sizeof(num_runs), 1, file) != 1 ||
+        fwrite(&runs[0], sizeof(chunk_store_run), num_runs, file) != num_runs) {
+        err(1, "Failed to write chunk %d %d %d to chunk store %s\n",
+            ch.x, ch.y, ch.z, filename);
+    }
+}
+
+
+/* read the runs at where, and expand them: one block if the chunk is
+ * uniform, or else every block, in storage order. returns false if what is
+ * there now is not what was there when where was taken */
+bool
+chunk_store::read_runs(slot const &where, std::vector<block> *out)
+{
+    std::vector<char> buf(where.size);
+
+    {
+        std::lock_guard<std::mutex> lock(file_lock);
+        if (seek_to(file, where.offset) ||
+            fread(&buf[0], where.size, 1, file) != 1) {
+            err(1, "Failed to read from chunk store %s\n", filename);
+        }
+    }
+
+    uint32_t num_runs;
+    memcpy(&num_runs, &buf[0], sizeof(num_runs));
+    if (where.size != sizeof(num_runs) + num_runs * sizeof(chunk_store_run))
+        return false;
+
+    out->clear();
+    out->reserve(num_runs == 1 ? 1 : chunk_blocks_count);
+
+    char const *p = &buf[sizeof(num_runs)];
+    for (uint32_t i = 0; i < num_runs; i++, p += sizeof(chunk_store_run)) {
+        chunk_store_run r;
+        memcpy(&r, p, sizeof(r));
+        out->insert(out->end(), num_runs == 1 ? 1 : r.count, r.b);
+    }
+
+    return num_runs == 1 || out->size() == chunk_blocks_count;
+}
+
+
+void
+chunk_store::install(loaded const &l, chunk_blocks *blocks)
+{
+    *blocks = chunk_blocks();
+    blocks->uniform = l.blocks[0];
+
+    if (l.blocks.size() > 1) {
+        blocks->expand();
+        memcpy(blocks->dense->cells.contents, &l.blocks[0], sizeof(blocks->dense->cells.contents));
+    }
+}
+
+
+void
+chunk_store::read(glm::ivec3 ch, chunk_blocks *blocks)
+{
+    auto it = slots.find(ch);
+    assert(it != slots.end() || !"reading a chunk which was never written");
+
+    loaded l;
+    if (!read_runs(it->second, &l.blocks))
+        errx(1, "Corrupt chunk %d %d %d in chunk store %s\n", ch.x, ch.y, ch.z, filename);
+
+    install(l, blocks);
+}
+
+
+void
+chunk_store::request(glm::ivec3 ch, unsigned generation)
+{
+    auto it = slots.find(ch);
+    assert(it != slots.end() || !"requesting a chunk which was never written");
+
+    {
+        std::lock_guard<std::mutex> lock(queue_lock);
+        requests.push_back(pending{ ch, generation, it->second });
+    }
+    wake.notify_one();
+}
+
+
+bool
+chunk_store::take(loaded *out)
+{
+    std::lock_guard<std::mutex> lock(queue_lock);
+    if (done.empty())
+        return false;
+
+    *out = std::move(done.front());
+    done.pop_front();
+    return true;
+}
+
+
+void
+chunk_store::run_loader()
+{
+    std::unique_lock<std::mutex> lock(queue_lock);
+
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !requests.empty(); });
+        if (stopping)
+            return;
+
+        pending r = requests.front();
+        requests.pop_front();
+        lock.unlock();
+
+        /* the slot may have been written again since. if that has left it
+         * unreadable, there's nothing to hand back; if not, the caller will
+         * see the generation is stale, and drop it */
+        loaded l;
+        l.ch = r.ch;
+        l.generation = r.generation;
+        bool ok = read_runs(r.where, &l.blocks);
+
+        lock.lock();
+        if (ok)
+            done.push_back(std::move(l));
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glm/glm.hpp> /* ivec3 */
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk.h"
+#include "ship_space.h" /* ivec3_hash */
+
+/* where the blocks of paged-out chunks live (see ship_space::update_residency)
+ *
+ * each chunk is written compactly, as runs of identical blocks -- a uniform
+ * chunk is a single run -- into one scratch file, which is removed again
+ * when the store is destroyed. a chunk written again goes back where it was
+ * if it still fits, or else on the end.
+ *
+ *   uint32_t num_runs
+ *   { uint32_t count; block b; }[num_runs]     in storage order
+ *
+ * chunks can be read back synchronously, or requested from the loader
+ * thread and collected with take() once it has them. the loader only reads
+ * and decodes; the block arrays are allocated by install(), on the thread
+ * which edits the ship (see dense_blocks), as is everything else here.
+ *
+ * failing to read or write the scratch file is fatal: the blocks would be
+ * lost.
+ */
+struct chunk_store {
+    /* a chunk the loader has finished reading */
+    struct loaded {
+        glm::ivec3 ch;
+        unsigned generation;        /* as passed to request() */
+        std::vector<block> blocks;  /* the runs, expanded */
+    };
+
+    explicit chunk_store(char const *filename);
+    ~chunk_store();
+
+    /* store the blocks of the chunk at chunk co-ords ch, replacing any
+     * earlier copy */
+    void write(glm::ivec3 ch, chunk_blocks const &blocks);
+
+    /* read the chunk at ch back into blocks, now. ch must have been written */
+    void read(glm::ivec3 ch, chunk_blocks *blocks);
+
+    /* ask the loader to read the chunk at ch in the background. generation
+     * is handed back with it, so the caller can tell whether the chunk was
+     * written again in the meantime */
+    void request(glm::ivec3 ch, unsigned generation);
+
+    /* the next chunk the loader has finished, if there is one yet */
+    bool take(loaded *out);
+
+    /* fill blocks from a chunk the loader has finished */
+    static void install(loaded const &l, chunk_blocks *blocks);
+
+    /* bytes of the scratch file in use, including space left behind by
+     * chunks which have since moved */
+    uint64_t file_size() const { return end; }
+
+private:
+    struct slot {
+        uint64_t offset;
+        uint32_t size;          /* bytes written there last */
+        uint32_t capacity;      /* bytes which may be written there */
+    };
+
+    struct pending {
+        glm::ivec3 ch;
+        unsigned generation;
+        slot where;
+    };
+
+    char *filename;
+    FILE *file;                 /* shared with the loader, under file_lock */
+    uint64_t end;
+    std::unordered_map<glm::ivec3, slot, ivec3_hash> slots;
+
+    std::mutex file_lock;
+    std::mutex queue_lock;
+    std::condition_variable wake;
+    std::deque<pending> requests;       /* under queue_lock */
+    std::deque<loaded> done;            /* under queue_lock */
+    bool stopping;                      /* under queue_lock */
+    std::thread loader;
+
+    bool read_runs(slot const &where, std::vector<block> *out);
+    void run_loader();
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
 
 #include "c_entity.h"
@@ -63,6 +64,20 @@ struct component_manager {
 
     virtual void destroy_instance(instance i) = 0;
 
+    /* one column of the instance pool: buffer.num elements of size bytes.
+     * pointer columns only mean anything within this run of the game, so
+     * are not persistent (see ship_file.h) */
+    struct column {
+        char const *name;
+        void *data;
+        size_t size;
+        bool persistent;
+    };
+
+    /* the name of this kind of component, and its pool's columns, entity first */
+    virtual char const * name() const = 0;
+    virtual std::vector<column> columns() = 0;
+
     virtual ~component_manager() {
         // allocated in derived create_component_instance_data() calls
         free(buffer.buffer);
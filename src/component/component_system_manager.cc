@@ -88,9 +88,13 @@ tick_gas_producers(ship_space *ship)
         /* topo node containing the entity */
         topo_info *t = topo_find(ship->get_topo_info(pos));
         zone_info *z = ship->get_zone_info(t);
+        zone_info vacuum(0, t);
         if (!z) {
-            /* if there wasn't a zone, make one */
-            z = ship->zones[t] = new zone_info(0);
+            /* if there wasn't a zone, make one. the outside can't have
+             * one, so gas put there just vents */
+            z = ship->insert_zone(t, 0);
+            if (!z)
+                z = &vacuum;
         }
 
         /* add some gas if we can, up to our pressure limit */
@@ -156,49 +160,48 @@ tick_doors(ship_space *ship)
 
         /* did we just enter desired state? */
         if (desired_state == door_man.instance_pool.pos[i] && !in_desired_state) {
-            auto s = desired_state ? surface_none : surface_door;
+            /* an open door still divides the atmosphere topology, so once
+             * a door has first shut, opening and closing it again changes
+             * neither the topology nor the zones' ids (see open_doors) */
+            auto s = desired_state ? surface_door_open : surface_door;
 
             auto pos = glm::ivec3(*position.position);
 
+            /* both halves of the door change as one edit */
+            ship->begin_edit();
+
             /* todo: this has no support for rotation whatsoever */
             for (auto h = 0; h < 2; ++h) {
                 auto ym = glm::ivec3(pos.x, pos.y - 1, pos.z);
                 auto yp = glm::ivec3(pos.x, pos.y + 1, pos.z);
 
-                auto chunk = ship->get_chunk_containing(pos);
-                chunk->render_chunk.valid = false;
-                chunk = ship->get_chunk_containing(ym);
-                chunk->render_chunk.valid = false;
-                chunk = ship->get_chunk_containing(yp);
-                chunk->render_chunk.valid = false;
-
                 /* we'll be calling ensure in set/remove surfaces anyway */
                 auto bl = ship->ensure_block(pos);
                 auto surfs = bl->surfs;
 
-                if (s == surface_none) {
+                if (s == surface_door_open) {
                     if (surfs[surface_yp] == surface_door) {
-                        ship->remove_surface(pos, yp, surface_yp);
+                        ship->set_surface(pos, yp, surface_yp, s);
                     }
 
                     if (surfs[surface_ym] == surface_door) {
-                        ship->remove_surface(pos, ym, surface_ym);
+                        ship->set_surface(pos, ym, surface_ym, s);
                     }
                 }
                 else {
-                    if (surfs[surface_yp] == surface_none) {
+                    if (surfs[surface_yp] == surface_none || surfs[surface_yp] == surface_door_open) {
                         ship->set_surface(pos, yp, surface_yp, s);
                     }
 
-                    if (surfs[surface_ym] == surface_none) {
+                    if (surfs[surface_ym] == surface_none || surfs[surface_ym] == surface_door_open) {
                         ship->set_surface(pos, ym, surface_ym, s);
                     }
                 }
 
-                mark_lightfield_update(pos);
-
                 ++pos.z;
             }
+
+            ship->commit();
         }
     }
 }
@@ -277,9 +280,8 @@ tick_pressure_sensors(ship_space* ship) {
 
         glm::ivec3 pos_block = get_coord_containing(pos);
 
-        topo_info *t = topo_find(ship->get_topo_info(pos_block));
-        zone_info *z = ship->get_zone_info(t);
-        float pressure = z ? (z->air_amount / t->size) : 0.0f;
+        zone_info *z = ship->get_zone_info_at(pos_block);
+        float pressure = z ? (z->air_amount / z->root->size) : 0.0f;
 
         auto which_sensor = pressure_man.instance_pool.type[i];
         auto desc = comms_msg_type_pressure_sensor_1_state;
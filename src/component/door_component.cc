@@ -68,3 +68,20 @@ door_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+door_component_manager::name() const {
+    return "door";
+}
+
+std::vector<component_manager::column>
+door_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "mesh", instance_pool.mesh, sizeof(hw_mesh *), false });
+    c.push_back({ "pos", instance_pool.pos, sizeof(float), true });
+    c.push_back({ "desired_pos", instance_pool.desired_pos, sizeof(float), true });
+
+    return c;
+}
@@ -72,3 +72,21 @@ gas_production_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+gas_production_component_manager::name() const {
+    return "gas_production";
+}
+
+std::vector<component_manager::column>
+gas_production_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "gas_type", instance_pool.gas_type, sizeof(unsigned), true });
+    c.push_back({ "flow_rate", instance_pool.flow_rate, sizeof(float), true });
+    c.push_back({ "max_pressure", instance_pool.max_pressure, sizeof(float), true });
+    c.push_back({ "enabled", instance_pool.enabled, sizeof(bool), true });
+
+    return c;
+}
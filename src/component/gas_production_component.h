@@ -16,6 +16,8 @@ struct gas_production_component_manager : component_manager {
     void create_component_instance_data(unsigned count) override;
     void destroy_instance(instance i) override;
     void entity(c_entity e) override;
+    char const * name() const override;
+    std::vector<column> columns() override;
 
     instance_data get_instance_data(c_entity e) {
         instance_data d;
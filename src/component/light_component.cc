@@ -64,3 +64,19 @@ light_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+light_component_manager::name() const {
+    return "light";
+}
+
+std::vector<component_manager::column>
+light_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "intensity", instance_pool.intensity, sizeof(float), true });
+    c.push_back({ "requested_intensity", instance_pool.requested_intensity, sizeof(float), true });
+
+    return c;
+}
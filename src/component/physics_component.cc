@@ -60,3 +60,18 @@ physics_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+physics_component_manager::name() const {
+    return "physics";
+}
+
+std::vector<component_manager::column>
+physics_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "rigid", instance_pool.rigid, sizeof(btRigidBody *), false });
+
+    return c;
+}
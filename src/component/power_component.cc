@@ -68,3 +68,20 @@ power_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+power_component_manager::name() const {
+    return "power";
+}
+
+std::vector<component_manager::column>
+power_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "required_power", instance_pool.required_power, sizeof(float), true });
+    c.push_back({ "powered", instance_pool.powered, sizeof(bool), true });
+    c.push_back({ "max_required_power", instance_pool.max_required_power, sizeof(float), true });
+
+    return c;
+}
@@ -64,3 +64,19 @@ power_provider_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+power_provider_component_manager::name() const {
+    return "power_provider";
+}
+
+std::vector<component_manager::column>
+power_provider_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "max_provided", instance_pool.max_provided, sizeof(float), true });
+    c.push_back({ "provided", instance_pool.provided, sizeof(float), true });
+
+    return c;
+}
@@ -64,3 +64,19 @@ pressure_sensor_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+pressure_sensor_component_manager::name() const {
+    return "pressure_sensor";
+}
+
+std::vector<component_manager::column>
+pressure_sensor_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "pressure", instance_pool.pressure, sizeof(float), true });
+    c.push_back({ "type", instance_pool.type, sizeof(unsigned), true });
+
+    return c;
+}
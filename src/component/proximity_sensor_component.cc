@@ -64,3 +64,19 @@ proximity_sensor_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+proximity_sensor_component_manager::name() const {
+    return "proximity_sensor";
+}
+
+std::vector<component_manager::column>
+proximity_sensor_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "range", instance_pool.range, sizeof(float), true });
+    c.push_back({ "is_detected", instance_pool.is_detected, sizeof(bool), true });
+
+    return c;
+}
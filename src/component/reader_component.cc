@@ -72,3 +72,21 @@ reader_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+reader_component_manager::name() const {
+    return "reader";
+}
+
+std::vector<component_manager::column>
+reader_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "name", instance_pool.name, sizeof(char const *), false });
+    c.push_back({ "source", instance_pool.source, sizeof(c_entity), true });
+    c.push_back({ "desc", instance_pool.desc, sizeof(char const *), false });
+    c.push_back({ "data", instance_pool.data, sizeof(float), true });
+
+    return c;
+}
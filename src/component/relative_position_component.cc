@@ -64,3 +64,19 @@ relative_position_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+relative_position_component_manager::name() const {
+    return "relative_position";
+}
+
+std::vector<component_manager::column>
+relative_position_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "position", instance_pool.position, sizeof(glm::vec3), true });
+    c.push_back({ "mat", instance_pool.mat, sizeof(glm::mat4), true });
+
+    return c;
+}
@@ -60,3 +60,18 @@ renderable_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+renderable_component_manager::name() const {
+    return "renderable";
+}
+
+std::vector<component_manager::column>
+renderable_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "mesh", instance_pool.mesh, sizeof(hw_mesh *), false });
+
+    return c;
+}
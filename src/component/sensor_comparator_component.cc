@@ -64,3 +64,19 @@ sensor_comparator_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+sensor_comparator_component_manager::name() const {
+    return "sensor_comparator";
+}
+
+std::vector<component_manager::column>
+sensor_comparator_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "compare_result", instance_pool.compare_result, sizeof(float), true });
+    c.push_back({ "compare_epsilon", instance_pool.compare_epsilon, sizeof(float), true });
+
+    return c;
+}
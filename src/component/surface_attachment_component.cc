@@ -64,3 +64,19 @@ surface_attachment_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+surface_attachment_component_manager::name() const {
+    return "surface_attachment";
+}
+
+std::vector<component_manager::column>
+surface_attachment_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "block", instance_pool.block, sizeof(glm::ivec3), true });
+    c.push_back({ "face", instance_pool.face, sizeof(int), true });
+
+    return c;
+}
@@ -60,3 +60,18 @@ switch_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+switch_component_manager::name() const {
+    return "switch";
+}
+
+std::vector<component_manager::column>
+switch_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "enabled", instance_pool.enabled, sizeof(bool), true });
+
+    return c;
+}
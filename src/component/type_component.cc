@@ -60,3 +60,18 @@ type_component_manager::entity(c_entity e) {
 
     instance_pool.entity[inst.index] = e;
 }
+
+char const *
+type_component_manager::name() const {
+    return "type";
+}
+
+std::vector<component_manager::column>
+type_component_manager::columns() {
+    std::vector<column> c;
+
+    c.push_back({ "entity", instance_pool.entity, sizeof(c_entity), true });
+    c.push_back({ "type", instance_pool.type, sizeof(unsigned), true });
+
+    return c;
+}
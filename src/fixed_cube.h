@@ -14,14 +14,103 @@
 #include <stdio.h> /* printf */
 #include <string.h> /* memmove, memset */
 
+/* storage layouts for fixed_cube
+ *
+ * a layout maps co-ords (x,y,z) within an N^3 cube to an index into the
+ * cube's storage, and back again.
+ */
+
+/* x fastest, then y, then z: [ x + (y * N) + (z * N * N) ]
+ * this matches the z-outer, x-inner loops we use over chunks, so those
+ * loops walk memory in order.
+ */
+struct layout_x_fastest {
+    template<unsigned N>
+    static unsigned index(unsigned x, unsigned y, unsigned z)
+    {
+        return x + N * (y + N * z);
+    }
+
+    template<unsigned N>
+    static void coords(unsigned i, unsigned *x, unsigned *y, unsigned *z)
+    {
+        *x = i % N;
+        *y = (i / N) % N;
+        *z = i / (N * N);
+    }
+};
+
+/* z fastest, then y, then x: [ z + (y * N) + (x * N * N) ]
+ * this is what a plain T[N][N][N] indexed [x][y][z] gives you.
+ */
+struct layout_z_fastest {
+    template<unsigned N>
+    static unsigned index(unsigned x, unsigned y, unsigned z)
+    {
+        return z + N * (y + N * x);
+    }
+
+    template<unsigned N>
+    static void coords(unsigned i, unsigned *x, unsigned *y, unsigned *z)
+    {
+        *z = i % N;
+        *y = (i / N) % N;
+        *x = i / (N * N);
+    }
+};
+
+/* z-order: the bits of x, y and z interleaved (x lowest). neighbours along
+ * every axis stay close in memory, so no loop order is badly off.
+ * N must be a power of two no larger than 1024.
+ */
+struct layout_morton {
+    /* spread the low 10 bits of v out to every third bit */
+    static unsigned spread(unsigned v)
+    {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    /* inverse of spread() */
+    static unsigned gather(unsigned v)
+    {
+        v &= 0x09249249;
+        v = (v | (v >> 2)) & 0x030c30c3;
+        v = (v | (v >> 4)) & 0x0300f00f;
+        v = (v | (v >> 8)) & 0x030000ff;
+        v = (v | (v >> 16)) & 0x3ff;
+        return v;
+    }
+
+    template<unsigned N>
+    static unsigned index(unsigned x, unsigned y, unsigned z)
+    {
+        static_assert((N & (N - 1)) == 0 && N <= 1024, "morton layout needs a power of two size");
+        return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+    }
+
+    template<unsigned N>
+    static void coords(unsigned i, unsigned *x, unsigned *y, unsigned *z)
+    {
+        *x = gather(i);
+        *y = gather(i >> 1);
+        *z = gather(i >> 2);
+    }
+};
+
 /* a 3d grid containing N^3 Ts
  *
  * fixed_cube internally stores an array of T
  * fixed_cube will NOT call constructor or destructor for the Ts
  * it will however ensure that the memory is zerod (memset)
  *
+ * the order the Ts are stored in is determined by Layout (see above)
  */
-template <class T, int N>
+template <class T, int N, class Layout = layout_x_fastest>
 struct fixed_cube {
 
     fixed_cube()
@@ -29,16 +118,13 @@ struct fixed_cube {
         memset(contents, 0, sizeof(contents));
     }
     /* contents of grid
-     * 3d array of T
-     *
-     * size determined by xy, yz, zd
-     * the dimensions being [x][y][z]
+     * N^3 Ts, in the order given by Layout
      *
      * to convert co-ords (x,y,z) into a single [index]
      * you do
-     * [ x + (y * xd) + (z * xd * yd) ]
+     * Layout::index<N>(x, y, z)
      */
-    T contents[N][N][N];
+    T contents[N * N * N];
 
     /* return a *T at coordinates (x, y, z)
      * or null on error
@@ -54,7 +140,43 @@ struct fixed_cube {
             return 0;
         }
 
-        return &( contents[x][y][z] );
+        return &( contents[Layout::template index<N>(x, y, z)] );
+    }
+
+    T const * get(unsigned int x, unsigned int y, unsigned int z) const
+    {
+        if( x >= N ||
+            y >= N ||
+            z >= N ){
+            assert(!"out of range");
+            return 0;
+        }
+
+        return &( contents[Layout::template index<N>(x, y, z)] );
     }
 
+    /* call f(x, y, z, T &) for every cell, in storage order
+     *
+     * use this rather than nested loops when the visiting order
+     * doesn't matter
+     */
+    template<typename F>
+    void for_each(F f)
+    {
+        for (unsigned int i = 0; i < N * N * N; i++) {
+            unsigned int x, y, z;
+            Layout::template coords<N>(i, &x, &y, &z);
+            f(x, y, z, contents[i]);
+        }
+    }
+
+    template<typename F>
+    void for_each(F f) const
+    {
+        for (unsigned int i = 0; i < N * N * N; i++) {
+            unsigned int x, y, z;
+            Layout::template coords<N>(i, &x, &y, &z);
+            f(x, y, z, contents[i]);
+        }
+    }
 };
@@ -72,6 +72,8 @@ enum en_action : int {
     action_slot8,
     action_slot9,
     action_slot0,
+    action_undo,
+    action_redo,
 
     num_actions,
 };
@@ -112,6 +114,8 @@ static const action_lookup_t action_lookup_table[] = {
     { "action_slot8",        action_slot8 },
     { "action_slot9",        action_slot9 },
     { "action_slot0",        action_slot0 },
+    { "action_undo",         action_undo },
+    { "action_redo",         action_redo },
 };
 
 /* fairly ugly. non-keyboard inputs go at bottom
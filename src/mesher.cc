@@ -1,6 +1,7 @@
 #include <epoxy/gl.h>
 
 #include "chunk.h"
+#include "chunk_shape.h"
 #include "mesh.h"
 #include "physics.h"
 
@@ -9,30 +10,10 @@
 #include <btBulletDynamicsCommon.h>
 
 /* TODO: sensible container for these things, once we have variants */
-extern sw_mesh *scaffold_sw;
+extern mesh_parts *scaffold_parts;
 extern sw_mesh *surfs_sw[6];
 
 
-static void
-stamp_at_offset(std::vector<vertex> *verts, std::vector<unsigned> *indices,
-                sw_mesh *src, glm::vec3 offset, int mat)
-{
-    unsigned index_base = (unsigned)verts->size();
-
-    for (unsigned int i = 0; i < src->num_vertices; i++) {
-        vertex v = src->verts[i];
-        v.x += offset.x;
-        v.y += offset.y;
-        v.z += offset.z;
-        v.mat = mat;
-        verts->push_back(v);
-    }
-
-    for (unsigned int i = 0; i < src->num_indices; i++)
-        indices->push_back(index_base + src->indices[i]);
-}
-
-
 extern physics *phy;
 
 
@@ -140,22 +121,8 @@ teardown_static_physics_setup(btTriangleMesh **mesh, btCollisionShape **shape, b
 }
 
 
-static int surface_type_to_material[256];
-
 void
-mesher_init()
-{
-    memset(surface_type_to_material, 0, sizeof(surface_type_to_material));
-    surface_type_to_material[surface_none] = 0;
-    surface_type_to_material[surface_wall] = 2;
-    surface_type_to_material[surface_grate] = 4;
-    surface_type_to_material[surface_glass] = 6;
-    surface_type_to_material[surface_door] = 16;
-}
-
-
-void
-chunk::prepare_render(int x, int y, int z)
+chunk::prepare_render(int x, int y, int z, chunk const *const *neighbours)
 {
     if (this->render_chunk.valid)
         return;     // nothing to do here.
@@ -163,23 +130,7 @@ chunk::prepare_render(int x, int y, int z)
     std::vector<vertex> verts;
     std::vector<unsigned> indices;
 
-    for (int k = 0; k < CHUNK_SIZE; k++)
-        for (int j = 0; j < CHUNK_SIZE; j++)
-            for (int i = 0; i < CHUNK_SIZE; i++) {
-                block *b = this->blocks.get(i, j, k);
-
-                if (b->type == block_support) {
-                    // TODO: block detail, variants, types, surfaces
-                    stamp_at_offset(&verts, &indices, scaffold_sw, glm::vec3(i, j, k), 1);
-                }
-
-                for (int surf = 0; surf < 6; surf++) {
-                    if (b->surfs[surf] != surface_none) {
-                        stamp_at_offset(&verts, &indices, surfs_sw[surf], glm::vec3(i, j, k),
-                                surface_type_to_material[b->surfs[surf]]);
-                    }
-                }
-            }
+    build_mesh(scaffold_parts, surfs_sw, neighbours, &verts, &indices);
 
     /* wrap the vectors in a temporary sw_mesh */
     sw_mesh m;
@@ -197,14 +148,19 @@ chunk::prepare_render(int x, int y, int z)
     this->render_chunk.mesh = upload_mesh(&m);
     this->render_chunk.valid = true;
 
-    build_static_physics_mesh(&m,
-                              &this->render_chunk.phys_mesh,
-                              &this->render_chunk.phys_shape);
+    /* the collision comes straight from the blocks, so is only set up
+     * once; edits show up in it without any of this. only which chunks
+     * are next to it can change */
+    if (!this->render_chunk.phys_shape) {
+        this->render_chunk.phys_shape = new chunk_shape(this);
+
+        build_static_physics_rb(x * CHUNK_SIZE,
+                                y * CHUNK_SIZE,
+                                z * CHUNK_SIZE,
+                                this->render_chunk.phys_shape,
+                                &this->render_chunk.phys_body);
+    }
 
-    build_static_physics_rb(x * CHUNK_SIZE,
-                            y * CHUNK_SIZE,
-                            z * CHUNK_SIZE,
-                            this->render_chunk.phys_shape,
-                            &this->render_chunk.phys_body);
+    ((chunk_shape *)this->render_chunk.phys_shape)->set_neighbours(neighbours);
 }
 
@@ -134,5 +134,8 @@ ship_space::mock_ship_space(void)
         }
     }
 
+    /* most of the space around the rooms is uniform; don't keep it expanded */
+    ss->compact_chunks();
+
     return ss;
 }
@@ -0,0 +1,413 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_set>
+
+#include "blob.h"
+#include "ship_file.h"
+
+
+/* the layout's index of (1, 2, 3) tells layouts apart well enough */
+static uint32_t
+layout_signature()
+{
+    return CHUNK_LAYOUT::index<CHUNK_SIZE>(1, 2, 3);
+}
+
+
+/* the file, as it is built up in memory */
+struct file_builder {
+    std::vector<char> data;
+
+    /* appends n bytes at the next multiple of align, returning their offset */
+    uint64_t put(void const *p, size_t n, size_t align)
+    {
+        size_t off = (data.size() + align - 1) & ~(align - 1);
+        data.resize(off + n);
+        if (p)
+            memcpy(&data[off], p, n);
+        return off;
+    }
+
+    template<typename T>
+    uint64_t put_array(T const *p, size_t count)
+    {
+        return count ? put(p, sizeof(T) * count, alignof(T)) : 0;
+    }
+
+    template<typename T>
+    void patch(uint64_t off, T const &v)
+    {
+        memcpy(&data[off], &v, sizeof(T));
+    }
+};
+
+
+/* a block in each zone, with the zone's air */
+static std::vector<ship_file_zone>
+find_zones(ship_space *ship)
+{
+    std::vector<ship_file_zone> out;
+    std::vector<bool> seen(ship->zones.size());
+
+    auto add = [ship, &out, &seen](topo_info *t, glm::ivec3 p) {
+        zone_info *z = ship->get_zone_info(topo_find(t));
+        if (z && !seen[z - &ship->zones[0]]) {
+            seen[z - &ship->zones[0]] = true;
+            ship_file_zone fz;
+            fz.p[0] = p.x;
+            fz.p[1] = p.y;
+            fz.p[2] = p.z;
+            fz.air_amount = z->air_amount;
+            out.push_back(fz);
+        }
+    };
+
+    /* the first block of each group */
+    for (auto ch : ship->chunks) {
+        chunk *c = ch.second;
+        glm::ivec3 base = CHUNK_SIZE * ch.first;
+        std::vector<bool> done(c->groups.size());
+        c->group.for_each([&add, &done, c, base](unsigned x, unsigned y, unsigned z, unsigned short g) {
+            if (!done[g]) {
+                done[g] = true;
+                add(c->groups[g].node, base + glm::ivec3(x, y, z));
+            }
+        });
+    }
+
+    for (auto &it : ship->implicit_topo) {
+        add(&it.second, CHUNK_SIZE * it.first);
+    }
+
+    return out;
+}
+
+
+bool
+save_ship(ship_space *ship, char const *filename,
+          component_manager *const *managers, unsigned num_managers)
+{
+    file_builder f;
+    ship_file_header h;
+    memset(&h, 0, sizeof(h));
+
+    memcpy(h.magic, "ENSH", 4);
+    h.version = SHIP_FILE_VERSION;
+    h.byte_order = 0x01020304;
+    h.chunk_size = CHUNK_SIZE;
+    h.layout = layout_signature();
+    h.block_size = sizeof(block);
+    for (int i = 0; i < 3; i++) {
+        h.mins[i] = ship->mins[i];
+        h.maxs[i] = ship->maxs[i];
+    }
+
+    f.put(nullptr, sizeof(h), alignof(ship_file_header));
+
+    /* the directory; the block arrays go at the end, once we know where */
+    std::vector<ship_file_chunk> dir;
+    for (auto ch : ship->chunks) {
+        ship->ensure_resident(ch.first, ch.second);
+
+        ship_file_chunk c;
+        memset(&c, 0, sizeof(c));
+        c.ch[0] = ch.first.x;
+        c.ch[1] = ch.first.y;
+        c.ch[2] = ch.first.z;
+        c.uniform = *ch.second->blocks.peek(0, 0, 0);
+        dir.push_back(c);
+    }
+    h.num_chunks = (uint32_t)dir.size();
+    h.chunks_offset = f.put(nullptr, sizeof(ship_file_chunk) * dir.size(), alignof(ship_file_chunk));
+
+    std::vector<ship_file_zone> zones = find_zones(ship);
+    h.num_zones = (uint32_t)zones.size();
+    h.zones_offset = f.put_array(zones.data(), zones.size());
+
+    for (int type = 0; type < num_wire_types; type++) {
+        auto const &attaches = ship->wire_attachments[type];
+        auto const &segments = ship->wire_segments[type];
+
+        std::vector<ship_file_entity_attach> lookups;
+        for (auto const &it : ship->entity_to_attach_lookups[type]) {
+            for (auto a : it.second) {
+                ship_file_entity_attach ea = { it.first.id, a };
+                lookups.push_back(ea);
+            }
+        }
+
+        h.num_attachments[type] = (uint32_t)attaches.size();
+        h.attachments_offset[type] = f.put_array(attaches.data(), attaches.size());
+        h.num_segments[type] = (uint32_t)segments.size();
+        h.segments_offset[type] = f.put_array(segments.data(), segments.size());
+        h.num_entity_attaches[type] = (uint32_t)lookups.size();
+        h.entity_attaches_offset[type] = f.put_array(lookups.data(), lookups.size());
+    }
+
+    h.num_components = num_managers;
+    h.components_offset = f.put(nullptr, sizeof(ship_file_component) * num_managers,
+                                alignof(ship_file_component));
+    for (unsigned i = 0; i < num_managers; i++) {
+        auto cols = managers[i]->columns();
+        unsigned num = managers[i]->buffer.num;
+
+        ship_file_component c;
+        memset(&c, 0, sizeof(c));
+        strncpy(c.name, managers[i]->name(), sizeof(c.name) - 1);
+        c.num = num;
+        c.num_columns = (uint32_t)cols.size();
+        c.columns_offset = f.put(nullptr, sizeof(ship_file_column) * cols.size(), alignof(ship_file_column));
+
+        for (size_t j = 0; j < cols.size(); j++) {
+            ship_file_column fc;
+            memset(&fc, 0, sizeof(fc));
+            strncpy(fc.name, cols[j].name, sizeof(fc.name) - 1);
+            fc.size = (uint32_t)cols[j].size;
+            if (cols[j].persistent && num)
+                fc.offset = f.put(cols[j].data, cols[j].size * num, 16);
+            f.patch(c.columns_offset + sizeof(fc) * j, fc);
+        }
+
+        f.patch(h.components_offset + sizeof(c) * i, c);
+    }
+
+    /* the block arrays, with room for the sharing count (see chunk_blocks) */
+    size_t i = 0;
+    for (auto ch : ship->chunks) {
+        chunk_blocks const &b = ch.second->blocks;
+        if (!b.is_uniform()) {
+            dir[i].blocks_offset = f.put(b.dense, sizeof(dense_blocks), 64);
+            f.patch(dir[i].blocks_offset + offsetof(dense_blocks, refs), 0u);
+        }
+        i++;
+    }
+
+    for (i = 0; i < dir.size(); i++) {
+        f.patch(h.chunks_offset + sizeof(ship_file_chunk) * i, dir[i]);
+    }
+    f.patch(0, h);
+
+    FILE *out = fopen(filename, "wb");
+    if (!out) {
+        printf("save_ship: can't open %s for writing\n", filename);
+        return false;
+    }
+
+    bool ok = fwrite(f.data.data(), 1, f.data.size(), out) == f.data.size();
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+        printf("save_ship: failed writing %s\n", filename);
+    }
+
+    return ok;
+}
+
+
+/* is [off, off + n) within the file, and suitably aligned for a T? */
+template<typename T>
+static bool
+in_file(blob const *b, uint64_t off, uint64_t count)
+{
+    return off <= b->len && count <= (b->len - off) / sizeof(T) && !(off % alignof(T));
+}
+
+
+static void
+load_components(blob *b, ship_file_header const *h,
+                component_manager *const *managers, unsigned num_managers)
+{
+    char *base = (char *)b->data;
+    ship_file_component const *comps = (ship_file_component const *)(base + h->components_offset);
+
+    for (unsigned i = 0; i < h->num_components; i++) {
+        ship_file_component const *c = &comps[i];
+        ship_file_column const *fcols = (ship_file_column const *)(base + c->columns_offset);
+
+        component_manager *man = nullptr;
+        for (unsigned j = 0; j < num_managers; j++) {
+            if (!strncmp(managers[j]->name(), c->name, sizeof(c->name)))
+                man = managers[j];
+        }
+
+        if (!man || !c->num)
+            continue;
+
+        man->create_component_instance_data(c->num);
+        man->buffer.num = c->num;
+
+        /* columns are matched by name, so a file from before a column was
+         * added still loads; anything not in the file starts out zeroed */
+        auto cols = man->columns();
+        for (auto &col : cols) {
+            memset(col.data, 0, col.size * c->num);
+
+            for (unsigned k = 0; k < c->num_columns; k++) {
+                if (!strncmp(col.name, fcols[k].name, sizeof(fcols[k].name)) &&
+                    col.persistent && fcols[k].offset && fcols[k].size == col.size) {
+                    memcpy(col.data, base + fcols[k].offset, col.size * c->num);
+                }
+            }
+        }
+
+        /* the entity column is always first */
+        c_entity const *ents = (c_entity const *)cols[0].data;
+        man->entity_instance_map.clear();
+        for (unsigned k = 0; k < c->num; k++) {
+            man->entity_instance_map[ents[k]] = k;
+        }
+    }
+}
+
+
+/* every table and column is inside the file */
+static bool
+check_tables(blob const *b, ship_file_header const *h)
+{
+    if (!in_file<ship_file_chunk>(b, h->chunks_offset, h->num_chunks) ||
+        !in_file<ship_file_zone>(b, h->zones_offset, h->num_zones)) {
+        return false;
+    }
+
+    ship_file_chunk const *dir = (ship_file_chunk const *)((char const *)b->data + h->chunks_offset);
+    for (uint32_t i = 0; i < h->num_chunks; i++) {
+        if (dir[i].blocks_offset && !in_file<dense_blocks>(b, dir[i].blocks_offset, 1))
+            return false;
+    }
+
+    for (int type = 0; type < num_wire_types; type++) {
+        if (!in_file<wire_attachment>(b, h->attachments_offset[type], h->num_attachments[type]) ||
+            !in_file<wire_segment>(b, h->segments_offset[type], h->num_segments[type]) ||
+            !in_file<ship_file_entity_attach>(b, h->entity_attaches_offset[type], h->num_entity_attaches[type])) {
+            return false;
+        }
+    }
+
+    if (!in_file<ship_file_component>(b, h->components_offset, h->num_components))
+        return false;
+
+    ship_file_component const *comps =
+        (ship_file_component const *)((char const *)b->data + h->components_offset);
+    for (uint32_t i = 0; i < h->num_components; i++) {
+        if (!in_file<ship_file_column>(b, comps[i].columns_offset, comps[i].num_columns))
+            return false;
+
+        ship_file_column const *fcols =
+            (ship_file_column const *)((char const *)b->data + comps[i].columns_offset);
+        for (uint32_t k = 0; k < comps[i].num_columns; k++) {
+            if (fcols[k].offset && !in_file<char>(b, fcols[k].offset, (uint64_t)fcols[k].size * comps[i].num))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+/* every chunk in the directory is there once, inside the bounds; and the
+ * bounds are no bigger than the chunks need, with the origin, which the
+ * bounds always take in. else the chunk directory and the topology pass,
+ * which walk the bounds, could be made as big as a file cares to say */
+static bool
+check_chunks(blob const *b, ship_file_header const *h)
+{
+    glm::ivec3 mins(h->mins[0], h->mins[1], h->mins[2]);
+    glm::ivec3 maxs(h->maxs[0], h->maxs[1], h->maxs[2]);
+    glm::ivec3 lo(0), hi(0);
+
+    ship_file_chunk const *dir = (ship_file_chunk const *)((char const *)b->data + h->chunks_offset);
+    std::unordered_set<glm::ivec3, ivec3_hash> seen;
+    for (uint32_t i = 0; i < h->num_chunks; i++) {
+        glm::ivec3 ch(dir[i].ch[0], dir[i].ch[1], dir[i].ch[2]);
+        if (glm::min(ch, mins) != mins || glm::max(ch, maxs) != maxs)
+            return false;
+        if (!seen.insert(ch).second)
+            return false;
+
+        lo = glm::min(lo, ch);
+        hi = glm::max(hi, ch);
+    }
+
+    return lo == mins && hi == maxs;
+}
+
+
+ship_space *
+load_ship(char const *filename,
+          component_manager *const *managers, unsigned num_managers)
+{
+    /* writable, because the block arrays' sharing counts live in the file
+     * image; the writes stay in our private copy of those pages */
+    blob *b = new blob(filename, true);
+    char *base = (char *)b->data;
+    ship_file_header const *h = (ship_file_header const *)base;
+
+    char const *why = nullptr;
+    if (b->len < sizeof(*h) || memcmp(h->magic, "ENSH", 4))
+        why = "not a ship file";
+    else if (h->version != SHIP_FILE_VERSION)
+        why = "unsupported version";
+    else if (h->byte_order != 0x01020304 || h->chunk_size != CHUNK_SIZE ||
+             h->layout != layout_signature() || h->block_size != sizeof(block))
+        why = "saved by a build with a different block layout";
+    else if (!check_tables(b, h) || !check_chunks(b, h))
+        why = "truncated or corrupt";
+
+    if (why) {
+        printf("load_ship: %s: %s\n", filename, why);
+        delete b;
+        return nullptr;
+    }
+
+    ship_space *ship = new ship_space;
+    ship->backing = b;
+    ship->mins = glm::ivec3(h->mins[0], h->mins[1], h->mins[2]);
+    ship->maxs = glm::ivec3(h->maxs[0], h->maxs[1], h->maxs[2]);
+
+    /* the chunks use their block arrays where they lie. the backing keeps a
+     * share of each, so they are never released to the pool */
+    ship_file_chunk const *dir = (ship_file_chunk const *)(base + h->chunks_offset);
+    for (uint32_t i = 0; i < h->num_chunks; i++) {
+        chunk *c = new chunk();
+        if (dir[i].blocks_offset) {
+            dense_blocks *d = (dense_blocks *)(base + dir[i].blocks_offset);
+            d->refs = 2;
+            c->blocks.dense = d;
+        }
+        else {
+            c->blocks.uniform = dir[i].uniform;
+        }
+
+        ship->chunks.set(glm::ivec3(dir[i].ch[0], dir[i].ch[1], dir[i].ch[2]), c);
+    }
+
+    for (int type = 0; type < num_wire_types; type++) {
+        wire_attachment const *attaches = (wire_attachment const *)(base + h->attachments_offset[type]);
+        wire_segment const *segments = (wire_segment const *)(base + h->segments_offset[type]);
+        ship_file_entity_attach const *lookups =
+            (ship_file_entity_attach const *)(base + h->entity_attaches_offset[type]);
+
+        ship->wire_attachments[type].assign(attaches, attaches + h->num_attachments[type]);
+        ship->wire_segments[type].assign(segments, segments + h->num_segments[type]);
+        for (uint32_t i = 0; i < h->num_entity_attaches[type]; i++) {
+            c_entity e = { lookups[i].entity };
+            ship->entity_to_attach_lookups[type][e].insert(lookups[i].attach);
+        }
+    }
+
+    ship->rebuild_topology();
+
+    ship_file_zone const *zones = (ship_file_zone const *)(base + h->zones_offset);
+    topo_info *outside = topo_find(&ship->outside_topo_info);
+    for (uint32_t i = 0; i < h->num_zones; i++) {
+        glm::ivec3 p(zones[i].p[0], zones[i].p[1], zones[i].p[2]);
+        topo_info *t = topo_find(ship->get_topo_info(p));
+        if (t != outside) {
+            ship->insert_zone(t, zones[i].air_amount);
+        }
+    }
+
+    load_components(b, h, managers, num_managers);
+
+    return ship;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ship_space.h"
+#include "component/component_manager.h"
+
+/* the binary ship format
+ *
+ * a ship file is laid out so that loading it is an mmap and some pointer
+ * fixups rather than parsing: everything is stored as it is in memory, at
+ * an offset from the start of the file. the block arrays are not even
+ * copied -- unwritten chunks read them straight out of the mapping, and
+ * take their own copy the first time they are written (see chunk_blocks).
+ *
+ * this means a file can only be loaded by a build with the same CHUNK_SIZE,
+ * CHUNK_LAYOUT, block layout and byte order as the one which saved it. the
+ * header records all of those, and a file which doesn't match is refused.
+ *
+ *   ship_file_header
+ *   ship_file_chunk[num_chunks]            directory; uniform chunks are just this
+ *   ship_file_zone[num_zones]              a block in each zone, and its air
+ *   per wire type:
+ *     wire_attachment[num_attachments]
+ *     wire_segment[num_segments]
+ *     ship_file_entity_attach[num_entity_attaches]
+ *   ship_file_component[num_components]
+ *   per component: ship_file_column[num_columns], then the columns' data
+ *   dense_blocks[]                         one per non-uniform chunk, aligned
+ */
+
+#define SHIP_FILE_VERSION 1
+
+struct ship_file_header {
+    char magic[4];                  /* "ENSH" */
+    uint32_t version;               /* SHIP_FILE_VERSION */
+    uint32_t byte_order;            /* 0x01020304, as written */
+    uint32_t chunk_size;            /* CHUNK_SIZE */
+    uint32_t layout;                /* CHUNK_LAYOUT's index of (1, 2, 3) */
+    uint32_t block_size;            /* sizeof(block) */
+
+    int32_t mins[3];
+    int32_t maxs[3];
+
+    uint32_t num_chunks;
+    uint32_t num_zones;
+    uint64_t chunks_offset;
+    uint64_t zones_offset;
+
+    uint32_t num_attachments[num_wire_types];
+    uint32_t num_segments[num_wire_types];
+    uint32_t num_entity_attaches[num_wire_types];
+    uint32_t num_components;
+    uint64_t attachments_offset[num_wire_types];
+    uint64_t segments_offset[num_wire_types];
+    uint64_t entity_attaches_offset[num_wire_types];
+    uint64_t components_offset;
+};
+
+struct ship_file_chunk {
+    int32_t ch[3];                  /* chunk co-ords */
+    uint32_t pad;
+    uint64_t blocks_offset;         /* the chunk's dense_blocks, or 0 if uniform */
+    block uniform;
+};
+
+struct ship_file_zone {
+    int32_t p[3];                   /* any block in the zone */
+    float air_amount;
+};
+
+struct ship_file_entity_attach {
+    uint32_t entity;                /* c_entity id */
+    uint32_t attach;
+};
+
+struct ship_file_component {
+    char name[32];                  /* component_manager::name() */
+    uint32_t num;                   /* instances */
+    uint32_t num_columns;
+    uint64_t columns_offset;        /* ship_file_column[num_columns] */
+};
+
+struct ship_file_column {
+    char name[32];
+    uint32_t size;                  /* bytes per instance */
+    uint32_t pad;
+    uint64_t offset;                /* num * size bytes; 0 if not persistent */
+};
+
+/* writes ship to filename, along with the instance pools of managers.
+ * returns false (having said why) if the file could not be written */
+bool
+save_ship(ship_space *ship, char const *filename,
+          component_manager *const *managers = nullptr, unsigned num_managers = 0);
+
+/* loads a ship saved by save_ship(), with its topology rebuilt and its
+ * zones' air put back. returns null (having said why) if the file is not a
+ * ship this build can load; as for any blob, exits if it can't be mapped.
+ *
+ * each of managers whose pool is in the file has its pool replaced by the
+ * file's: the persistent columns are copied in, and the rest zeroed, for the
+ * caller to fill back in. the managers should be empty beforehand.
+ */
+ship_space *
+load_ship(char const *filename,
+          component_manager *const *managers = nullptr, unsigned num_managers = 0);
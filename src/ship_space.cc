@@ -1,16 +1,46 @@
 #include "ship_space.h"
+#include "blob.h"
+#include "chunk_store.h"
+#include "thread_pool.h"
 #include <assert.h>
 #include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAYCAST_SSE2 1
+#include <emmintrin.h>
+#endif
 
 
 #define MAX_WIRE_INSTANCES 64 * 1024
 
 
+/* what every implicit chunk reads as */
+chunk ship_space::implicit_chunk;
+
+const size_t ship_space::no_reader;
+const unsigned ship_space::max_undo_steps;
+
+
 /* create an empty ship_space */
 ship_space::ship_space(void)
-    : mins(), maxs(),
-      num_full_rebuilds(0), num_fast_unifys(0), num_fast_nosplits(0), num_false_splits(0)
+    : mins(), maxs(), backing(nullptr), workers(nullptr),
+      num_full_rebuilds(0), num_fast_unifys(0), num_fast_nosplits(0),
+      num_bounded_nosplits(0), num_bounded_misses(0), num_bounded_visits(0),
+      num_local_nosplits(0), num_local_splits(0), num_chunk_solves(0),
+      nosplit_radius(CHUNK_SIZE / 2),
+      recording_undo(false), store(nullptr), max_resident(0), num_resident(0),
+      residency_frame(0), on_page_out(nullptr), edit_depth(0), journal_committed(0)
 {
+    /* nothing is attached to the outside yet */
+    outside_topo_info.p = &outside_topo_info;
+    outside_topo_info.rank = 0;
+    outside_topo_info.size = 0;
+    outside_topo_info.zone = -1;
+
     /* start rather large */
     power_wires.reserve(MAX_WIRE_INSTANCES);
 
@@ -21,26 +51,43 @@ ship_space::ship_space(void)
 }
 
 
+ship_space::~ship_space()
+{
+    for (auto ch : chunks) {
+        delete ch.second;
+    }
+
+    /* anything still sharing blocks with the backing file goes first */
+    undo_steps.clear();
+    redo_steps.clear();
+    recording = undo_step();
+    delete backing;
+    delete store;
+    delete workers;
+}
+
+
+void
+ship_space::set_worker_threads(unsigned threads)
+{
+    delete workers;
+    workers = threads > 1 ? new thread_pool(threads) : nullptr;
+}
+
+
 static void
 split_coord(int p, int *out_block, int *out_chunk)
 {
     /* NOTE: There are a number of attractive-looking symmetries which are
-     * just plain wrong. */
-    int block, chunk;
-
-    if (p < 0) {
-        /* negative space is not a mirror of positive:
-         * chunk -1 spans blocks -8..-1;
-         * chunk -2 spans blocks -16..-9 */
-        chunk = (p - CHUNK_SIZE + 1) / CHUNK_SIZE;
-    } else {
-        /* positive halfspace has no rocket science. */
-        chunk = p / CHUNK_SIZE;
-    }
-
-    /* the within-chunk offset is just the difference between the minimum block
-     * in the chunk and the requested one, regardless of which halfspace we're in. */
-    block = p - CHUNK_SIZE * chunk;
+     * just plain wrong.
+     *
+     * negative space is not a mirror of positive: with 8-block chunks,
+     * chunk -1 spans blocks -8..-1 and chunk -2 spans blocks -16..-9.
+     * CHUNK_SIZE is a power of two, so an arithmetic shift rounds toward
+     * negative infinity and gives the right chunk in both halfspaces, and
+     * the offset within the chunk is just the low bits. */
+    int chunk = p >> CHUNK_SHIFT;
+    int block = p & CHUNK_MASK;
 
     /* write the outputs which were requested */
     if (out_block)
@@ -50,6 +97,33 @@ split_coord(int p, int *out_block, int *out_chunk)
 }
 
 
+block_cursor::block_cursor(ship_space *ship, glm::ivec3 block, bool masks_only)
+    : ship(ship), masks_only(masks_only)
+{
+    move_to(block);
+}
+
+
+block_cursor::block_cursor(ship_space *ship, glm::ivec3 ch_pos, chunk *ch, glm::ivec3 off)
+    : ship(ship), pos(CHUNK_SIZE * ch_pos + off), ch_pos(ch_pos), off(off), ch(ch),
+      masks_only(false)
+{
+}
+
+
+void
+block_cursor::move_to(glm::ivec3 block)
+{
+    pos = block;
+
+    split_coord(block.x, &off.x, &ch_pos.x);
+    split_coord(block.y, &off.y, &ch_pos.y);
+    split_coord(block.z, &off.z, &ch_pos.z);
+
+    ch = find_chunk();
+}
+
+
 /* returns a block or null
  * finds the block at the position (x,y,z) within
  * the whole ship_space
@@ -72,9 +146,27 @@ ship_space::get_block(glm::ivec3 block)
         return 0;
     }
 
+    /* whatever is written through this goes unseen by the masks until
+     * they are next worked out -- by rebuild_topology(), or a raycast
+     * through the chunk -- so write it straight away */
+    c->masks_stale = true;
     return c->blocks.get(wb_x, wb_y, wb_z);
 }
 
+block const *
+ship_space::peek_block(glm::ivec3 block)
+{
+    int wb_x, wb_y, wb_z;
+    glm::ivec3 ch;
+
+    split_coord(block.x, &wb_x, &ch.x);
+    split_coord(block.y, &wb_y, &ch.y);
+    split_coord(block.z, &wb_z, &ch.z);
+
+    chunk *c = this->get_chunk(ch);
+    return c ? c->blocks.peek(wb_x, wb_y, wb_z) : nullptr;
+}
+
 /* returns a topo_info or null
  * finds the topo_info at the position (x,y,z) within
  * the whole ship_space
@@ -94,20 +186,33 @@ ship_space::get_topo_info(glm::ivec3 block)
     chunk *c = this->get_chunk(ch);
 
     if (!c) {
-        return &this->outside_topo_info;
+        return is_implicit_chunk(ch) ? get_implicit_topo_info(ch) : &this->outside_topo_info;
     }
 
-    return c->topo.get(wb_x, wb_y, wb_z);
+    return c->topo(wb_x, wb_y, wb_z);
+}
+
+topo_info *
+ship_space::get_implicit_topo_info(glm::ivec3 ch)
+{
+    auto it = implicit_topo.find(ch);
+    return it != implicit_topo.end() ? &it->second : &outside_topo_info;
 }
 
 zone_info *
-ship_space::get_zone_info(topo_info *t)
+ship_space::get_zone_info_at(glm::ivec3 block)
 {
-    auto it = zones.find(t);
-    if (it == zones.end())
-        return nullptr;
+    glm::ivec3 ch, off;
+    split_coord(block.x, &off.x, &ch.x);
+    split_coord(block.y, &off.y, &ch.y);
+    split_coord(block.z, &off.z, &ch.z);
+
+    /* the topology stays behind when a chunk is paged out */
+    chunk *c = chunks.get(ch);
+    topo_info *t = c ? c->topo(off.x, off.y, off.z) :
+        is_implicit_chunk(ch) ? get_implicit_topo_info(ch) : &outside_topo_info;
 
-    return it->second;
+    return get_zone_info(topo_find(t));
 }
 
 /* returns the chunk containing the block denotated by (x, y, z)
@@ -131,544 +236,2155 @@ ship_space::get_chunk_containing(glm::ivec3 block)
 chunk *
 ship_space::get_chunk(glm::ivec3 ch)
 {
-    auto it = this->chunks.find(ch);
-    if( it != this->chunks.end() ){
-        return it->second;
-    }
+    chunk *c = this->chunks.get(ch);
+    if (c)
+        ensure_resident(ch, c);
 
-    return nullptr;
+    return c;
 }
 
-
-
-static float
-max_along_axis(float o, float d)
+void
+ship_space::get_mesh_neighbours(glm::ivec3 ch, chunk const **out) const
 {
-    if (d > 0) {
-        return fabsf((ceilf(o) - o)/d);
-    }
-    else {
-        return fabsf((floorf(o) - o)/d);
+    for (int face = 0; face < face_count; face++) {
+        chunk const *c = this->chunks.get(ch + surface_index_to_normal(face));
+        out[face] = c && c->resident ? c : nullptr;
     }
 }
 
-/* max reach, counted in edge-crossings. for spherical reach, the results need to be
- * further pruned -- this allows ~2 blocks in the worst case diagonals, and 6 in the
- * best cases, where only one axis is traversed.
- */
-#define MAX_PLAYER_REACH 6
-
 
-void
-ship_space::raycast(glm::vec3 o, glm::vec3 d, raycast_info *rc)
-{
-    /* implementation of the algorithm described in
-     * http://www.cse.yorku.ca/~amana/research/grid.pdf
-     */
 
-    assert(rc);
-    rc->hit = false;
-
-    /* if less than 0 we need to subtract one
-     * as float truncation will bias
-     * towards 0
-     */
-    int x = (int)(o.x < 0 ? o.x - 1: o.x);
-    int y = (int)(o.y < 0 ? o.y - 1: o.y);
-    int z = (int)(o.z < 0 ? o.z - 1: o.z);
-
-    int nx = 0;
-    int ny = 0;
-    int nz = 0;
-
-    block *bl = nullptr;
-
-    bl = this->get_block(glm::ivec3(x,y,z));
-    rc->inside = bl ? bl->type != block_empty : 0;
-
-    int stepX = d.x > 0 ? 1 : -1;
-    int stepY = d.y > 0 ? 1 : -1;
-    int stepZ = d.z > 0 ? 1 : -1;
-
-    float tDeltaX = fabsf(1/d.x);
-    float tDeltaY = fabsf(1/d.y);
-    float tDeltaZ = fabsf(1/d.z);
-
-    float tMaxX = max_along_axis(o.x, d.x);
-    float tMaxY = max_along_axis(o.y, d.y);
-    float tMaxZ = max_along_axis(o.z, d.z);
-
-    for (int i = 0; i < MAX_PLAYER_REACH; ++i) {
-        if (tMaxX < tMaxY) {
-            if (tMaxX < tMaxZ) {
-                x += stepX;
-                tMaxX += tDeltaX;
-                nx = -stepX;
-                ny = 0;
-                nz = 0;
-            }
-            else {
-                z += stepZ;
-                tMaxZ += tDeltaZ;
-                nx = 0;
-                ny = 0;
-                nz = -stepZ;
-            }
-        }
-        else {
-            if (tMaxY < tMaxZ) {
-                y += stepY;
-                tMaxY += tDeltaY;
-                nx = 0;
-                ny = -stepY;
-                nz = 0;
-            }
-            else {
-                z += stepZ;
-                tMaxZ += tDeltaZ;
-                nx = 0;
-                ny = 0;
-                nz = -stepZ;
-            }
-        }
+/* the player's reach, in blocks */
+#define MAX_PLAYER_REACH 6.0f
 
-        bl = this->get_block(glm::ivec3(x, y, z));
-        if (!bl && !rc->inside){
-            /* if there is no block then we are outside the grid
-             * we still want to keep stepping until we either
-             * hit a block within the grid or exceed our maximum
-             * reach
-             */
-            continue;
-        }
 
-        if (rc->inside ^ (bl && bl->type != block_empty)) {
-            rc->hit = true;
-            rc->bl.x = x;
-            rc->bl.y = y;
-            rc->bl.z = z;
-            rc->block = bl;
-            rc->n.x = nx;
-            rc->n.y = ny;
-            rc->n.z = nz;
-            rc->p.x = x + nx;
-            rc->p.y = y + ny;
-            rc->p.z = z + nz;
-            return;
-        }
+/* the chunk at chunk co-ords ch, for its masks: null where there is nothing
+ * or only an implicit chunk. it isn't paged in; masks which have gone stale
+ * are worked out again, which they can be, as a chunk is never paged out
+ * with stale masks */
+static chunk *
+mask_chunk(ship_space *ship, glm::ivec3 ch)
+{
+    chunk *c = ship->chunks.get(ch);
+    if (c && c->masks_stale) {
+        c->update_masks();
+        c->masks_stale = false;
     }
+    return c;
 }
 
-/* ensure that the specified block_{x,y,z} can be fetched with a get_block
- *
- * this will instantiate a new containing chunk if necessary
- *
- * this will not instantiate or modify any other chunks
- */
-block *
-ship_space::ensure_block(glm::ivec3 block)
+
+chunk *
+block_cursor::find_chunk() const
 {
-    glm::ivec3 ch;
+    if (!masks_only)
+        return ship->get_chunk_for_read(ch_pos);
 
-    split_coord(block.x, nullptr, &ch.x);
-    split_coord(block.y, nullptr, &ch.y);
-    split_coord(block.z, nullptr, &ch.z);
+    chunk *c = mask_chunk(ship, ch_pos);
+    if (!c && ship->is_implicit_chunk(ch_pos))
+        return &ship_space::implicit_chunk;
+    return c;
+}
 
-    /* guarantee we have the size we need */
-    this->ensure_chunk(ch);
+/* whether scaffolding in the chunk a meets scaffolding in b, the chunk
+ * across face from it */
+static bool
+scaffolding_meets(chunk const *a, chunk const *b, int face)
+{
+    int axis = face >> 1, u = (axis + 1) % 3, w = (axis + 2) % 3;
+    glm::ivec3 p, q;
+    p[axis] = (face & 1) ? 0 : CHUNK_SIZE - 1;
+    q[axis] = (face & 1) ? CHUNK_SIZE - 1 : 0;
+
+    for (int j = 0; j < CHUNK_SIZE; j++) {
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            p[u] = q[u] = i;
+            p[w] = q[w] = j;
+            if (a->scaffolding.test(p.x, p.y, p.z) && b->scaffolding.test(q.x, q.y, q.z))
+                return true;
+        }
+    }
 
-    return get_block(block);
+    return false;
 }
 
-/* internal helper for creating chunks in a valid state.
- * all blocks within the newly-created chunk are connected to the outside
- * node in the atmo topology. this is the correct behavior for on-demand
- * chunk creation as you edit the world. clients doing bulk creation of
- * chunks should rebuild the atmo topology when they are finished making
- * changes.
- */
-static chunk *
-create_chunk(ship_space *ship)
+
+void
+ship_space::update_seals()
 {
-    auto *ch = new chunk();
+    /* 1/ the chunks whose masks have changed, and the chunks whose
+     *    scaffolding runs on into one of those, and so on: a wall put up
+     *    in one chunk can seal scaffolding anywhere along it. only these
+     *    are worked out again */
+    std::vector<std::pair<glm::ivec3, chunk *>> region;
+    std::unordered_map<glm::ivec3, unsigned, ivec3_hash> in_region;
+
+    for (auto ch : chunks) {
+        if (ch.second->seals_stale || ch.second->masks_stale) {
+            in_region[ch.first] = (unsigned)region.size();
+            region.push_back(std::make_pair(ch.first, mask_chunk(this, ch.first)));
+        }
+    }
+
+    if (region.empty())
+        return;
 
-    /* All the topo nodes in the new chunk should be attached
-     * to the outside node.
-     */
-    for (auto k = 0; k < CHUNK_SIZE; k++) {
-        for (auto j = 0; j < CHUNK_SIZE; j++) {
-            for (auto i = 0; i < CHUNK_SIZE; i++) {
-                topo_info *t = ch->topo.get(i, j, k);
-                t->p = &ship->outside_topo_info;
+    for (size_t i = 0; i < region.size(); i++) {
+        for (int face = 0; face < face_count; face++) {
+            glm::ivec3 nch = region[i].first + surface_index_to_normal(face);
+            chunk *n = mask_chunk(this, nch);
+            if (n && !in_region.count(nch) && scaffolding_meets(region[i].second, n, face)) {
+                in_region[nch] = (unsigned)region.size();
+                region.push_back(std::make_pair(nch, n));
             }
         }
     }
 
-    /* Adjust the size of the outside chunk. This is currently not
-     * used for anything, but the consistency is nice and the cost is negligible.
-     */
-    ship->outside_topo_info.size += CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
-    return ch;
-}
+    /* 2/ from all the scaffolding being sealed, unseal what can be seen
+     *    into, a chunk at a time, until nothing more changes across the
+     *    chunk faces. chunks outside the region are as they were */
+    std::vector<chunk_mask> before(region.size());
+    std::vector<bool> queued(region.size(), true);
+    std::vector<unsigned> work;
+
+    for (unsigned i = 0; i < region.size(); i++) {
+        chunk *c = region[i].second;
+        before[i] = c->sealed;
+        c->sealed = c->scaffolding;
+        work.push_back(i);
+    }
 
-/* ensure that the specified chunk exists
- *
- * this will instantiate a new chunk if necessary -- any other possibly-enclosed
- * missing chunks to unconfuse the atmo system.
- */
-chunk *
-ship_space::ensure_chunk(glm::ivec3 v)
-{
-    /* automatically creates the entry if not present */
-    auto &ch = this->chunks[v];
-    if (!ch) {
-        this->mins = glm::min(this->mins, v);
-        this->maxs = glm::max(this->maxs, v);
+    while (!work.empty()) {
+        unsigned i = work.back();
+        work.pop_back();
+        queued[i] = false;
+
+        chunk const *neighbours[face_count];
+        for (int face = 0; face < face_count; face++) {
+            neighbours[face] = chunks.get(region[i].first + surface_index_to_normal(face));
+        }
 
-        ch = create_chunk(this);
+        unsigned changed = region[i].second->update_seals(neighbours);
+        for (int face = 0; face < face_count; face++) {
+            if (!(changed & 1u << face))
+                continue;
 
-        /* ensure any other missing possibly-enclosed chunks exist too */
-        for (auto k = this->mins.z + 1; k < this->maxs.z; k++) {
-            for (auto j = this->mins.y + 1; j < this->maxs.y; j++) {
-                for (auto i = this->mins.x + 1; i < this->maxs.x; i++) {
-                    auto &other_ch = this->chunks[glm::ivec3(i, j, k)];
-                    if (!other_ch) {
-                        other_ch = create_chunk(this);
-                    }
-                }
+            auto it = in_region.find(region[i].first + surface_index_to_normal(face));
+            if (it != in_region.end() && !queued[it->second]) {
+                queued[it->second] = true;
+                work.push_back(it->second);
             }
         }
     }
 
-    return ch;
+    /* 3/ meshes draw up to their neighbours' sealed blocks, so are
+     *    rebuilt either side of a change */
+    for (unsigned i = 0; i < region.size(); i++) {
+        chunk *c = region[i].second;
+        c->seals_stale = false;
+        if (!memcmp(before[i].rows, c->sealed.rows, sizeof(c->sealed.rows)))
+            continue;
+
+        c->render_chunk.valid = false;
+        for (int face = 0; face < face_count; face++) {
+            chunk *n = chunks.get(region[i].first + surface_index_to_normal(face));
+            if (n)
+                n->render_chunk.valid = false;
+        }
+    }
 }
 
-topo_info *
-topo_find(topo_info *p)
+
+/* whether anything in the chunk c could stop a ray with this filter */
+static bool
+ray_may_stop(chunk const *c, ray_filter const &filter)
 {
-    /* compress path */
-    if (p->p != p) {
-        p->p = topo_find(p->p);
+    if (filter.block_types & 1 << block_empty)
+        return true;
+    if (!c)
+        return false;
+    if (filter.block_types && !c->occupied.none())
+        return true;
+
+    for (int face = 0; face < face_count; face++) {
+        if ((filter.surface_bits & surface_blocks_air) && !c->blocks_air[face].none())
+            return true;
+        if ((filter.surface_bits & surface_blocks_light) && !c->blocks_light[face].none())
+            return true;
     }
+    return false;
+}
+
+/* whether the filter stops at the surface on the given face of the block at
+ * off in the chunk c */
+static bool
+ray_stops_at_surface(chunk const *c, glm::ivec3 off, int face, ray_filter const &filter)
+{
+    if (!c)
+        return false;
 
-    return p->p;
+    return ((filter.surface_bits & surface_blocks_air) && c->blocks_air[face].test(off.x, off.y, off.z)) ||
+           ((filter.surface_bits & surface_blocks_light) && c->blocks_light[face].test(off.x, off.y, off.z));
 }
 
-/* helper to unify subtrees */
-static topo_info *
-topo_unite(topo_info *from, topo_info *to)
+/* whether the filter stops at the block at off in the chunk c, at chunk
+ * co-ords ch. with no chunk, the block is empty. the masks can't tell one
+ * type of non-empty block from another, so that takes the block itself */
+static bool
+ray_stops_at_block(ship_space *ship, glm::ivec3 ch, chunk *c, glm::ivec3 off, ray_filter const &filter)
 {
-    from = topo_find(from);
-    to = topo_find(to);
+    unsigned const full = 1 << block_support | 1 << block_entity;
 
-    /* already in same subtree? */
-    if (from == to) return from;
+    if (!c || !c->occupied.test(off.x, off.y, off.z))
+        return filter.block_types & 1 << block_empty;
+    if ((filter.block_types & full) == full)
+        return true;
+    if (!(filter.block_types & full))
+        return false;
 
-    if (from->rank < to->rank) {
-        from->p = to;
-        return to;
-    } else if (from->rank > to->rank) {
-        to->p = from;
-        return from;
-    } else {
-        /* merging two rank-r subtrees produces a rank-r+1 subtree. */
-        to->p = from;
-        from->rank++;
-        return from;
-    }
+    ship->ensure_resident(ch, c);
+    return filter.block_types & 1 << c->blocks.peek(off.x, off.y, off.z)->type;
 }
 
-/* inserts a zone_info into the zone map. z may be
- * deleted, if there is an existing zone to merge into. */
+
 void
-ship_space::insert_zone(topo_info *t, zone_info *z)
+ship_space::raycast(glm::vec3 o, glm::vec3 d, raycast_info *rc)
 {
-    if (t == &outside_topo_info) {
-        /* there is no point in combining with the outside. */
-        delete z;
-        return;
+    glm::ivec3 v((int)floorf(o.x), (int)floorf(o.y), (int)floorf(o.z));
+    glm::ivec3 off, ch;
+    split_coord(v.x, &off.x, &ch.x);
+    split_coord(v.y, &off.y, &ch.y);
+    split_coord(v.z, &off.z, &ch.z);
+    chunk *c = mask_chunk(this, ch);
+
+    /* out to the first block which isn't like the one we're in */
+    ray_filter filter;
+    filter.surface_bits = 0;
+    if (c && c->occupied.test(off.x, off.y, off.z))
+        filter.block_types = 1 << block_empty;
+    else
+        filter.block_types = 1 << block_support | 1 << block_entity;
+
+    raycast(o, d, MAX_PLAYER_REACH, filter, rc);
+}
+
+
+enum ray_state {
+    ray_walking,
+    ray_missed,
+    ray_hit,
+};
+
+/* one ray's walk along the ship, after
+ * http://www.cse.yorku.ca/~amana/research/grid.pdf, at two levels: chunks
+ * with nothing in them to stop the ray are crossed in one go, and the
+ * others block by block. the crossings are all worked out from o rather
+ * than summed, so the jumps don't drift.
+ *
+ * the walk is in the block v, at off in the chunk c at ch, having come in
+ * across axis, t along the ray. t_max is how far along the ray it leaves v
+ * along each axis.
+ */
+struct ray_walk {
+    ship_space *ship;
+    ray_filter filter;
+    glm::vec3 o, d;
+    float max_dist;
+
+    glm::ivec3 step;
+    glm::ivec3 v, ch, off;
+    glm::vec3 t_max;
+    chunk *c;
+    bool look;          /* whether anything in c could stop the ray */
+    float t;
+    int axis;
+
+    /* how far along the ray it crosses the plane at edge on axis a */
+    float plane(int a, int edge) const
+    {
+        return d[a] != 0 ? (edge - o[a]) / d[a] : INFINITY;
     }
 
-    zone_info *existing_z = get_zone_info(t);
-    if (existing_z) {
-        /* merge case; mix in this zone, and then we'll delete it. */
-        existing_z->air_amount += z->air_amount;
-        delete z;
+    /* the walk is now in the block v */
+    void enter()
+    {
+        split_coord(v.x, &off.x, &ch.x);
+        split_coord(v.y, &off.y, &ch.y);
+        split_coord(v.z, &off.z, &ch.z);
+        c = mask_chunk(ship, ch);
+        look = ray_may_stop(c, filter);
+        for (int a = 0; a < 3; a++) {
+            t_max[a] = plane(a, v[a] + (step[a] > 0));
+        }
     }
-    else {
-        /* no zone here yet. this one will do fine! */
-        zones[t] = z;
+
+    /* on to where the ray crosses the plane at edge on axis a, at to; the
+     * other axes are kept within lo..hi against rounding */
+    void jump(float to, int a, int edge, glm::ivec3 lo, glm::ivec3 hi)
+    {
+        for (int b = 0; b < 3; b++) {
+            int x = (int)floorf(o[b] + d[b] * to);
+            v[b] = std::max(lo[b], std::min(hi[b], x));
+        }
+        v[a] = step[a] > 0 ? edge : edge - 1;
+        t = to;
+        axis = a;
+        enter();
     }
-}
 
-void
-ship_space::update_topology_for_remove_surface(glm::ivec3 a, glm::ivec3 b)
-{
-    topo_info *t = topo_find(get_topo_info(a));
-    topo_info *u = topo_find(get_topo_info(b));
+    /* whether the ray stops in v, having just come in across axis, where
+     * the previous block was off_from in the chunk from */
+    bool stops(chunk const *from, glm::ivec3 off_from) const
+    {
+        int face = 2 * axis + (step[axis] < 0);
+        return ray_stops_at_surface(from, off_from, face, filter) ||
+               ray_stops_at_surface(c, off, face ^ 1, filter) ||
+               ray_stops_at_block(ship, ch, c, off, filter);
+    }
 
-    num_fast_unifys++;
+    /* from the block o is in. a ray which doesn't stop in empty space
+     * starts where it reaches the ship's chunks, and finishes where it
+     * leaves them */
+    ray_state start(ship_space *s, glm::vec3 from, glm::vec3 dir, float dist,
+                    ray_filter const &f, raycast_info *rc)
+    {
+        ship = s;
+        filter = f;
+        o = from;
+        d = glm::normalize(dir);
+        max_dist = dist;
+        t = 0;
+        axis = 0;
+
+        for (int a = 0; a < 3; a++) {
+            step[a] = d[a] > 0 ? 1 : -1;
+        }
 
-    if (t == u) {
-        /* we're not really unifying */
-        return;
-    }
+        v = glm::ivec3((int)floorf(o.x), (int)floorf(o.y), (int)floorf(o.z));
+        enter();
 
-    zone_info *z1 = get_zone_info(t);
-    zone_info *z2 = get_zone_info(u);
+        rc->hit = false;
+        rc->inside = c && c->occupied.test(off.x, off.y, off.z);
 
-    /* remove the existing zones */
-    if (z1) { zones.erase(zones.find(t)); }
-    if (z2) { zones.erase(zones.find(u)); }
+        if (filter.block_types & 1 << block_empty)
+            return ray_walking;
 
-    topo_info *v = topo_unite(t, u);
-    /* track sizing */
-    v->size = t->size + u->size;
+        glm::ivec3 lo = CHUNK_SIZE * ship->mins;
+        glm::ivec3 hi = CHUNK_SIZE * (ship->maxs + glm::ivec3(1));
+        float t_in = 0;
+        int in_axis = -1;
 
-    /* reinsert both zones at v */
-    if (z1) { insert_zone(v, z1); }
-    if (z2) { insert_zone(v, z2); }
-}
+        for (int a = 0; a < 3; a++) {
+            if (d[a] == 0) {
+                if (o[a] < lo[a] || o[a] >= hi[a])
+                    return ray_missed;
+                continue;
+            }
 
-static bool
-exists_alt_path(int x, int y, int z, block *a, block *b, ship_space *ship, int face)
-{
-    block *c;
+            float near = plane(a, step[a] > 0 ? lo[a] : hi[a]);
+            if (near > t_in) {
+                t_in = near;
+                in_axis = a;
+            }
+            max_dist = std::min(max_dist, plane(a, step[a] > 0 ? hi[a] : lo[a]));
+        }
 
-    if (face != surface_xp) {
-        c = ship->get_block(glm::ivec3(x+1, y, z));
-        if (air_permeable(a->surfs[surface_xp]) && air_permeable(b->surfs[surface_xp]) &&
-                (!c || air_permeable(c->surfs[face])))
-            return true;
-        c = ship->get_block(glm::ivec3(x-1, y, z));
-        if (air_permeable(a->surfs[surface_xm]) && air_permeable(b->surfs[surface_xm]) &&
-                (!c || air_permeable(c->surfs[face])))
-            return true;
-    }
+        if (t_in > max_dist)
+            return ray_missed;
 
-    if (face != surface_yp) {
-        c = ship->get_block(glm::ivec3(x, y+1, z));
-        if (air_permeable(a->surfs[surface_yp]) && air_permeable(b->surfs[surface_yp]) &&
-                (!c || air_permeable(c->surfs[face])))
-            return true;
-        c = ship->get_block(glm::ivec3(x, y-1, z));
-        if (air_permeable(a->surfs[surface_ym]) && air_permeable(b->surfs[surface_ym]) &&
-                (!c || air_permeable(c->surfs[face])))
-            return true;
-    }
+        if (in_axis != -1) {
+            jump(t_in, in_axis, step[in_axis] > 0 ? lo[in_axis] : hi[in_axis], lo, hi - glm::ivec3(1));
+            if (stops(nullptr, off))
+                return ray_hit;
+        }
 
-    if (face != surface_zp) {
-        c = ship->get_block(glm::ivec3(x, y, z+1));
-        if (air_permeable(a->surfs[surface_zp]) && air_permeable(b->surfs[surface_zp]) &&
-                (!c || air_permeable(c->surfs[face])))
-            return true;
-        c = ship->get_block(glm::ivec3(x, y, z-1));
-        if (air_permeable(a->surfs[surface_zm]) && air_permeable(b->surfs[surface_zm]) &&
-                (!c || air_permeable(c->surfs[face])))
-            return true;
+        return ray_walking;
     }
 
-    return false;
-}
+    /* nothing here: straight out across the nearest of the chunk's far
+     * faces */
+    ray_state skip()
+    {
+        glm::ivec3 base = CHUNK_SIZE * ch;
+        float to = INFINITY;
+        int a = 0, edge = 0;
+        for (int b = 0; b < 3; b++) {
+            int e = base[b] + (step[b] > 0 ? CHUNK_SIZE : 0);
+            float tb = plane(b, e);
+            if (tb < to) {
+                to = tb;
+                a = b;
+                edge = e;
+            }
+        }
 
-/* todo: we should be able to calculate face */
-void
-ship_space::update_topology_for_add_surface(glm::ivec3 a, glm::ivec3 b, int face)
-{
-    /* can this surface even split (does it block atmo?) */
-    if (air_permeable(get_block(a)->surfs[face]))
-        return;
+        if (to > max_dist)
+            return ray_missed;
 
-    /* collapse an obvious symmetry */
-    if (face & 1) {
-        /* symmetry */
-        std::swap(a, b);
-        face ^= 1;
+        jump(to, a, edge, base, base + glm::ivec3(CHUNK_SIZE - 1));
+        return stops(nullptr, off) ? ray_hit : ray_walking;
     }
 
-    /* try to quickly prove that we don't divide space */
-    if (exists_alt_path(a.x, a.y, a.z, get_block(a), get_block(b), this, face)) {
-        num_fast_nosplits++;
-        return;
-    }
+    /* on to the next block */
+    ray_state advance()
+    {
+        int a = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+        if (t_max[a] > max_dist)
+            return ray_missed;
+
+        chunk *from = c;
+        glm::ivec3 off_from = off;
+
+        v[a] += step[a];
+        t = t_max[a];
+        t_max[a] = plane(a, v[a] + (step[a] > 0));
+        axis = a;
+
+        off[a] += step[a];
+        if ((unsigned)off[a] >= CHUNK_SIZE) {
+            off[a] -= step[a] * CHUNK_SIZE;
+            ch[a] += step[a];
+            c = mask_chunk(ship, ch);
+            look = ray_may_stop(c, filter);
+        }
 
-    /* grab our air amount data before rebuild_topology invalidates the existing zones */
-    zone_info *zone = get_zone_info(topo_find(get_topo_info(a)));
-    float air_amount = zone ? zone->air_amount : 0.0f;
+        return stops(from, off_from) ? ray_hit : ray_walking;
+    }
 
-    /* we do need to split */
-    rebuild_topology();
+    ray_state next()
+    {
+        return look ? advance() : skip();
+    }
 
-    topo_info *t1 = topo_find(get_topo_info(a));
-    topo_info *t2 = topo_find(get_topo_info(b));
-    if (t1 == t2) {
-        /* we blew it. we didn't actually split the space, but we did
-         * all the work anyway. this is mostly interesting if you're
-         * tweaking exists_alt_path. */
-        num_false_splits++;
+    void finish(raycast_info *rc) const
+    {
+        rc->hit = true;
+        rc->bl = v;
+        rc->n = glm::ivec3(0);
+        rc->n[axis] = -step[axis];
+        rc->p = v + rc->n;
+        rc->t = t;
+
+        /* read only: not through get_block(), which would have the masks
+         * worked out again for the next ray through here, nor the writable
+         * getter, which would expand a uniform chunk or unshare one shared
+         * with a snapshot. the chunk was only walked through for its
+         * masks, so may need paging in */
+        chunk *hc = ship->chunks.get(ch);
+        if (hc)
+            ship->ensure_resident(ch, hc);
+        rc->block = hc ? hc->blocks.peek(off.x, off.y, off.z) : nullptr;
     }
-    else if (zone) {
-        /* at least one side was real before this split */
+};
 
-        /* fixup the zones for the split. we want to maintain the same pressure
-         * we had on both sides, so distribute the mass */
-        zone_info *z1 = get_zone_info(t1);
-        if (!z1) {
-            z1 = zones[t1] = new zone_info(0);
-        }
 
-        zone_info *z2 = get_zone_info(t2);
-        if (!z2) {
-            z2 = zones[t2] = new zone_info(0);
-        }
+void
+ship_space::raycast(glm::vec3 o, glm::vec3 d, float max_dist,
+                    ray_filter const &filter, raycast_info *rc)
+{
+    assert(rc);
 
-        z1->air_amount = air_amount * t1->size / (t1->size + t2->size);
-        z2->air_amount = air_amount - z1->air_amount;
+    ray_walk w;
+    ray_state state = w.start(this, o, d, max_dist, filter, rc);
+    while (state == ray_walking) {
+        state = w.next();
     }
-}
 
-static glm::ivec3 dirs[] = {
-    glm::ivec3(1, 0, 0),
-    glm::ivec3(-1, 0, 0),
-    glm::ivec3(0, 1, 0),
-    glm::ivec3(0, -1, 0),
-    glm::ivec3(0, 0, 1),
-    glm::ivec3(0, 0, -1),
-};
+    if (state == ray_hit)
+        w.finish(rc);
+}
 
 
-/* rebuild the ship topology. this is generally not the optimal thing -
- * we can dynamically rebuild parts of the topology cheaper based on
- * knowing the change that was made.
+#if RAYCAST_SSE2
+/* rays walked four at a time, in lock-step while each is in a chunk it
+ * has to walk block by block: the choice of axis and the crossings are
+ * worked out for all four at once. a lane drops back to its own ray_walk
+ * to skip empty chunks, stop or give up, and takes the next ray when it's
+ * done.
  */
-void
-ship_space::rebuild_topology()
+static void
+raycast_packets(ship_space *ship, ray const *rays, size_t n,
+                ray_filter const &filter, raycast_info *hits)
 {
-    num_full_rebuilds++;
+    ray_walk w[4];
+    size_t which[4] = {};
+    bool live[4] = {};
+    size_t next = 0;
+
+    /* the lanes, by axis */
+    alignas(16) int v[3][4], step[3][4], up[3][4], ch[3][4];
+    alignas(16) float t_max[3][4], o[3][4], d[3][4], max_dist[4];
+
+    auto load = [&](int l) {
+        for (int a = 0; a < 3; a++) {
+            v[a][l] = w[l].v[a];
+            step[a][l] = w[l].step[a];
+            up[a][l] = w[l].step[a] > 0;
+            ch[a][l] = w[l].ch[a];
+            t_max[a][l] = w[l].t_max[a];
+            o[a][l] = w[l].o[a];
+            d[a][l] = w[l].d[a];
+        }
+        max_dist[l] = w[l].max_dist;
+    };
+
+    /* carry lane l's walk on alone until it's walking a chunk block by
+     * block again, taking new rays as the old ones finish */
+    auto settle = [&](int l, ray_state state) {
+        for (;;) {
+            while (state == ray_walking && !w[l].look) {
+                state = w[l].skip();
+            }
+            if (state == ray_walking) {
+                load(l);
+                return;
+            }
+            if (state == ray_hit)
+                w[l].finish(&hits[which[l]]);
 
-    /* 1/ initially, every block is its own subtree */
-    for (auto it = chunks.begin(); it != chunks.end(); it++) {
-        for (int z = 0; z < CHUNK_SIZE; z++) {
-            for (int y = 0; y < CHUNK_SIZE; y++) {
-                for (int x = 0; x < CHUNK_SIZE; x++) {
-                    topo_info *t = it->second->topo.get(x, y, z);
-                    t->p = t;
-                    t->rank = 0;
-                    t->size = 0;
-                }
+            if (next == n) {
+                live[l] = false;
+                return;
             }
+            which[l] = next++;
+            ray const &r = rays[which[l]];
+            state = w[l].start(ship, r.o, r.d, r.max_dist, filter, &hits[which[l]]);
+        }
+    };
+
+    for (int l = 0; l < 4; l++) {
+        live[l] = true;
+        settle(l, ray_missed);
+        if (!live[l]) {
+            /* fewer rays than lanes; the spare ones step along a walk of
+             * their own which is never looked at */
+            w[l] = ray_walk();
+            w[l].d = glm::vec3(1.0f);
+            w[l].step = glm::ivec3(1);
+            load(l);
         }
     }
 
-    this->outside_topo_info.p = &this->outside_topo_info;
-    this->outside_topo_info.rank = 0;
-    this->outside_topo_info.size = 0;
+    __m128 const all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    while (live[0] || live[1] || live[2] || live[3]) {
+        __m128 tx = _mm_load_ps(t_max[0]);
+        __m128 ty = _mm_load_ps(t_max[1]);
+        __m128 tz = _mm_load_ps(t_max[2]);
+
+        /* the axis each ray leaves its block along, as the scalar walk
+         * picks it, ties and all */
+        __m128 x_lt_y = _mm_cmplt_ps(tx, ty);
+        __m128 sel[3];
+        sel[0] = _mm_and_ps(x_lt_y, _mm_cmplt_ps(tx, tz));
+        sel[1] = _mm_andnot_ps(x_lt_y, _mm_cmplt_ps(ty, tz));
+        sel[2] = _mm_andnot_ps(_mm_or_ps(sel[0], sel[1]), all);
+
+        __m128 t = _mm_or_ps(_mm_or_ps(_mm_and_ps(sel[0], tx), _mm_and_ps(sel[1], ty)),
+                             _mm_and_ps(sel[2], tz));
+        int attention = _mm_movemask_ps(_mm_cmpgt_ps(t, _mm_load_ps(max_dist)));
+        int leave = 0;
+
+        alignas(16) int nv[3][4];
+        alignas(16) float nt[3][4];
+        int on_axis[3];
+        for (int a = 0; a < 3; a++) {
+            __m128i m = _mm_castps_si128(sel[a]);
+            __m128i va = _mm_add_epi32(_mm_load_si128((__m128i const *)v[a]),
+                                       _mm_and_si128(m, _mm_load_si128((__m128i const *)step[a])));
+            __m128 edge = _mm_cvtepi32_ps(_mm_add_epi32(va, _mm_load_si128((__m128i const *)up[a])));
+            __m128 ta = _mm_div_ps(_mm_sub_ps(edge, _mm_load_ps(o[a])), _mm_load_ps(d[a]));
+            __m128 old = a == 0 ? tx : a == 1 ? ty : tz;
+
+            _mm_store_si128((__m128i *)nv[a], va);
+            _mm_store_ps(nt[a], _mm_or_ps(_mm_and_ps(sel[a], ta), _mm_andnot_ps(sel[a], old)));
+
+            /* into another chunk */
+            __m128i same = _mm_cmpeq_epi32(_mm_srai_epi32(va, CHUNK_SHIFT),
+                                           _mm_load_si128((__m128i const *)ch[a]));
+            leave |= ~_mm_movemask_ps(_mm_castsi128_ps(same)) & 15;
+            on_axis[a] = _mm_movemask_ps(sel[a]);
+        }
 
-    /* 2/ combine across air-permeable interfaces */
-    for (auto it = chunks.begin(); it != chunks.end(); it++) {
-        for (int z = 1; z < CHUNK_SIZE - 1; z++) {
-            for (int y = 1; y < CHUNK_SIZE - 1; y++) {
-                for (int x = 1; x < CHUNK_SIZE - 1; x++) {
-                    block *bl = it->second->blocks.get(x, y, z);
-
-                    for (int i = 0; i < 6; i++) {
-                        if (air_permeable(bl->surfs[i])) {
-                            glm::ivec3 offset = dirs[i];
-                            topo_unite(it->second->topo.get(x, y, z),
-                                       it->second->topo.get(x + offset.x, y + offset.y, z + offset.z));
-                        }
-                    }
+        for (int l = 0; l < 4; l++) {
+            if (!live[l]) {
+                attention |= 1 << l;
+                continue;
+            }
+            if (attention & 1 << l)
+                continue;
+
+            /* does the step stop where it gets to. into a chunk which has
+             * to be walked block by block, the lane stays in step; one to
+             * skip is left to the lane's own walk */
+            int a = (on_axis[0] >> l & 1) ? 0 : (on_axis[1] >> l & 1) ? 1 : 2;
+            int face = 2 * a + (step[a][l] < 0);
+            glm::ivec3 off_from(v[0][l] & CHUNK_MASK, v[1][l] & CHUNK_MASK, v[2][l] & CHUNK_MASK);
+            glm::ivec3 off(nv[0][l] & CHUNK_MASK, nv[1][l] & CHUNK_MASK, nv[2][l] & CHUNK_MASK);
+            chunk *from = w[l].c;
+            chunk *c = from;
+            glm::ivec3 to_ch = w[l].ch;
+
+            if (leave & 1 << l) {
+                to_ch[a] += step[a][l];
+                c = mask_chunk(ship, to_ch);
+                if (!ray_may_stop(c, filter)) {
+                    attention |= 1 << l;
+                    continue;
                 }
             }
+
+            if (ray_stops_at_surface(from, off_from, face, filter) ||
+                ray_stops_at_surface(c, off, face ^ 1, filter) ||
+                ray_stops_at_block(ship, to_ch, c, off, filter)) {
+                attention |= 1 << l;
+            }
+            else if (leave & 1 << l) {
+                w[l].c = c;
+                w[l].ch = to_ch;
+                ch[a][l] = to_ch[a];
+            }
         }
 
-        for (int z = 0; z < CHUNK_SIZE; z++) {
-            for (int y = 0; y < CHUNK_SIZE; y++) {
-                block *bl = it->second->blocks.get(0, y, z);
-                topo_info *to = it->second->topo.get(0, y, z);
-
-                for (int i = 0; i < 6; i++) {
-                    if (air_permeable(bl->surfs[i])) {
-                        glm::ivec3 offset = dirs[i];
-                        topo_unite(to,
-                            get_topo_info(CHUNK_SIZE * it->first + glm::ivec3(0, y, z) + offset));
-                    }
-                }
+        for (int l = 0; l < 4; l++) {
+            if (attention & 1 << l) {
+                if (!live[l])
+                    continue;
 
-                bl = it->second->blocks.get(CHUNK_SIZE - 1, y, z);
-                to = it->second->topo.get(CHUNK_SIZE - 1, y, z);
+                /* take this step alone, from where the lane was */
+                for (int a = 0; a < 3; a++) {
+                    w[l].v[a] = v[a][l];
+                    w[l].t_max[a] = t_max[a][l];
+                    w[l].off[a] = v[a][l] & CHUNK_MASK;
+                }
+                settle(l, w[l].advance());
+            }
+            else {
+                for (int a = 0; a < 3; a++) {
+                    v[a][l] = nv[a][l];
+                    t_max[a][l] = nt[a][l];
+                }
+            }
+        }
+    }
+}
+#endif
+
+
+void
+ship_space::raycast_many(ray const *rays, raycast_info *hits, size_t n,
+                         ray_filter const &filter)
+{
+    if (!n)
+        return;
+
+#if RAYCAST_SSE2
+    raycast_packets(this, rays, n, filter, hits);
+#else
+    for (size_t i = 0; i < n; i++) {
+        raycast(rays[i].o, rays[i].d, rays[i].max_dist, filter, &hits[i]);
+    }
+#endif
+}
+
+
+/* ensure that the specified block_{x,y,z} can be fetched with a get_block
+ *
+ * this will instantiate a new containing chunk if necessary
+ *
+ * this will not instantiate or modify any other chunks
+ */
+block *
+ship_space::ensure_block(glm::ivec3 block)
+{
+    glm::ivec3 ch;
+
+    split_coord(block.x, nullptr, &ch.x);
+    split_coord(block.y, nullptr, &ch.y);
+    split_coord(block.z, nullptr, &ch.z);
+
+    /* guarantee we have the size we need */
+    this->ensure_chunk(ch);
+
+    return get_block(block);
+}
+
+/* internal helper for creating chunks in a valid state.
+ * all blocks within the newly-created chunk are connected to whatever the
+ * space there was connected to before: the implicit chunk's node if it was
+ * implicit, or else the outside node. this is the correct behavior for
+ * on-demand chunk creation as you edit the world. clients doing bulk
+ * creation of chunks should rebuild the atmo topology when they are
+ * finished making changes.
+ *
+ * a new chunk is all empty space, so is one group. its portals can only
+ * be worked out once it is in the chunk directory; see ensure_chunk
+ */
+static chunk *
+create_chunk(ship_space *ship, glm::ivec3 v)
+{
+    auto *ch = new chunk();
+
+    topo_info *space = topo_find(ship->is_implicit_chunk(v) ?
+        ship->get_implicit_topo_info(v) : &ship->outside_topo_info);
+
+    topo_info *t = new topo_info;
+    t->p = space;
+    t->rank = 0;
+    t->size = 0;
+    t->zone = -1;
+    ch->groups.push_back(chunk_group{ t, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE });
+
+    if (space == &ship->outside_topo_info) {
+        /* Adjust the size of the outside chunk. This is currently not
+         * used for anything, but the consistency is nice and the cost is negligible.
+         * an implicit chunk's node already counts its blocks. */
+        ship->outside_topo_info.size += CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+    }
+
+    return ch;
+}
+
+/* what label_groups() leaves for keep_nodes() */
+struct group_solve {
+    std::vector<chunk_group> old_groups;
+    std::vector<unsigned> overlap;      /* new group << 16 | old group, sorted */
+};
+
+/* work out the groups of c again, from its masks, so it needn't be
+ * resident. the new groups have no nodes yet; see keep_nodes. touches
+ * nothing outside c and s, so chunks can be done on several threads */
+static void
+label_groups(chunk *c, group_solve *s)
+{
+    const unsigned n = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+    const unsigned short none = 0xffff;
+
+    s->old_groups.clear();
+    s->old_groups.swap(c->groups);
+    std::vector<unsigned short> old_group(c->group.contents, c->group.contents + n);
+
+    unsigned short *label = c->group.contents;
+    bool all_open = true;
+    for (int face = 0; face < face_count; face++) {
+        all_open = all_open && c->blocks_air[face].none();
+    }
+
+    if (all_open) {
+        std::fill(label, label + n, 0);
+        c->groups.push_back(chunk_group{ nullptr, (int)n });
+    }
+    else {
+        /* flood each group out from its first block, in storage order */
+        std::fill(label, label + n, none);
+        std::vector<unsigned> stack;
+
+        for (unsigned i = 0; i < n; i++) {
+            if (label[i] != none)
+                continue;
+
+            unsigned short g = (unsigned short)c->groups.size();
+            c->groups.push_back(chunk_group{ nullptr, 0 });
+            label[i] = g;
+            stack.push_back(i);
+
+            while (!stack.empty()) {
+                unsigned j = stack.back();
+                stack.pop_back();
+                c->groups[g].size++;
+
+                unsigned x, y, z;
+                CHUNK_LAYOUT::coords<CHUNK_SIZE>(j, &x, &y, &z);
+
+                for (int face = 0; face < face_count; face++) {
+                    if (c->blocks_air[face].test(x, y, z))
+                        continue;
+
+                    glm::ivec3 q = glm::ivec3(x, y, z) + surface_index_to_normal(face);
+                    if ((unsigned)q.x >= CHUNK_SIZE || (unsigned)q.y >= CHUNK_SIZE ||
+                        (unsigned)q.z >= CHUNK_SIZE) {
+                        continue;   /* a portal */
+                    }
 
-                for (int i = 0; i < 6; i++) {
-                    if (air_permeable(bl->surfs[i])) {
-                        glm::ivec3 offset = dirs[i];
-                        topo_unite(to,
-                            get_topo_info(CHUNK_SIZE * it->first + glm::ivec3(CHUNK_SIZE - 1, y, z) + offset));
+                    unsigned k = CHUNK_LAYOUT::index<CHUNK_SIZE>(q.x, q.y, q.z);
+                    if (label[k] == none) {
+                        label[k] = g;
+                        stack.push_back(k);
                     }
                 }
+            }
+        }
+    }
+
+    /* which old groups each new one has blocks from */
+    s->overlap.clear();
+    if (!s->old_groups.empty()) {
+        for (unsigned i = 0; i < n; i++) {
+            unsigned pair = (unsigned)label[i] << 16 | old_group[i];
+            if (s->overlap.empty() || s->overlap.back() != pair)
+                s->overlap.push_back(pair);
+        }
+        std::sort(s->overlap.begin(), s->overlap.end());
+        s->overlap.erase(std::unique(s->overlap.begin(), s->overlap.end()), s->overlap.end());
+    }
+}
+
+/* give the groups label_groups() found in c their nodes.
+ *
+ * a new group with blocks from old ones keeps one of their nodes if it
+ * can -- a root, if one of them is -- or else gets a new node in the old
+ * one's space. old nodes no group keeps are pointed at a group which has
+ * some of their blocks, and handed back in retired, for the caller to
+ * delete once nothing refers to them any more.
+ *
+ * nodes come from a shared pool, so this is for the thread which edits
+ * the ship only */
+static void
+keep_nodes(chunk *c, group_solve const *s, std::vector<topo_info *> *retired)
+{
+    auto const &old_groups = s->old_groups;
+    auto const &overlap = s->overlap;
+
+    /* for each old group: a new group with some of its blocks, or -2 - g
+     * once new group g has kept its node */
+    std::vector<int> heir(old_groups.size(), -1);
+    size_t k = 0;
+    for (unsigned g = 0; g < c->groups.size(); g++) {
+        int best = -1;
+        topo_info *space = nullptr;
+
+        for (; k < overlap.size() && (overlap[k] >> 16) == g; k++) {
+            unsigned o = overlap[k] & 0xffff;
+            topo_info *t = old_groups[o].node;
+            space = topo_find(t);
+
+            if (heir[o] < -1)
+                continue;   /* kept by another group already */
+            if (heir[o] < 0)
+                heir[o] = g;
+
+            if (best < 0 || (t->p == t && old_groups[best].node->p != old_groups[best].node))
+                best = o;
+        }
+
+        if (best >= 0) {
+            c->groups[g].node = old_groups[best].node;
+            heir[best] = -2 - g;    /* kept */
+        }
+        else {
+            topo_info *t = new topo_info;
+            t->p = space ? space : t;
+            t->rank = 0;
+            t->size = 0;
+            t->zone = -1;
+            c->groups[g].node = t;
+        }
+    }
+
+    for (unsigned o = 0; o < old_groups.size(); o++) {
+        if (heir[o] >= 0) {
+            old_groups[o].node->p = c->groups[heir[o]].node;
+            retired->push_back(old_groups[o].node);
+        }
+    }
+}
+
+/* work out the groups of the chunk c again; see label_groups and
+ * keep_nodes. the portals are left alone; see solve_faces */
+static void
+solve_groups(ship_space *ship, chunk *c, std::vector<topo_info *> *retired)
+{
+    ship->num_chunk_solves++;
+
+    group_solve s;
+    label_groups(c, &s);
+    keep_nodes(c, &s, retired);
+}
+
+/* work out the portals across face of the chunk c at ch, from its masks,
+ * and the matching ones of the chunk on the other side. touches nothing
+ * but those two lists of portals */
+static void
+find_portals(ship_space *ship, glm::ivec3 ch, chunk *c, int face)
+{
+    glm::ivec3 nch = ch + surface_index_to_normal(face);
+    chunk *d = ship->chunks.get(nch);
+
+    int axis = face >> 1;
+    glm::ivec3 off, noff;
+    off[axis] = (face & 1) ? 0 : CHUNK_SIZE - 1;
+    noff[axis] = (face & 1) ? CHUNK_SIZE - 1 : 0;
+
+    std::vector<unsigned> pairs;
+    for (int v = 0; v < CHUNK_SIZE; v++) {
+        for (int u = 0; u < CHUNK_SIZE; u++) {
+            off[(axis + 1) % 3] = noff[(axis + 1) % 3] = u;
+            off[(axis + 2) % 3] = noff[(axis + 2) % 3] = v;
+
+            if (c->blocks_air[face].test(off.x, off.y, off.z))
+                continue;
+
+            unsigned g = *c->group.get(off.x, off.y, off.z);
+            unsigned o = d ? *d->group.get(noff.x, noff.y, noff.z) : 0;
+            unsigned pair = g << 16 | o;
+            if (pairs.empty() || pairs.back() != pair)
+                pairs.push_back(pair);
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    c->portals[face].clear();
+    for (auto pair : pairs) {
+        c->portals[face].push_back(chunk_portal{ (unsigned short)(pair >> 16), (unsigned short)pair });
+    }
+
+    if (d) {
+        d->portals[face ^ 1].clear();
+        for (auto pair : pairs) {
+            d->portals[face ^ 1].push_back(chunk_portal{ (unsigned short)pair, (unsigned short)(pair >> 16) });
+        }
+    }
+}
+
+static void
+solve_faces(ship_space *ship, glm::ivec3 ch, chunk *c)
+{
+    for (int face = 0; face < face_count; face++) {
+        find_portals(ship, ch, c, face);
+    }
+}
 
-                bl = it->second->blocks.get(y, 0, z);
-                to = it->second->topo.get(y, 0, z);
+/* ensure that the specified chunk exists
+ *
+ * this will instantiate a new chunk if necessary. any other missing chunks
+ * which the new bounds make possibly-enclosed become implicit, which costs
+ * nothing until they are written to.
+ */
+chunk *
+ship_space::ensure_chunk(glm::ivec3 v)
+{
+    auto ch = this->chunks.get(v);
+    if (!ch) {
+        ch = create_chunk(this, v);
 
-                for (int i = 0; i < 6; i++) {
-                    if (air_permeable(bl->surfs[i])) {
-                        glm::ivec3 offset = dirs[i];
-                        topo_unite(to,
-                            get_topo_info(CHUNK_SIZE * it->first + glm::ivec3(y, 0, z) + offset));
+        this->mins = glm::min(this->mins, v);
+        this->maxs = glm::max(this->maxs, v);
+        this->chunks.set(v, ch);
+
+        if (store)
+            make_resident(v, ch);
+
+        solve_faces(this, v, ch);
+    }
+    else {
+        ensure_resident(v, ch);
+    }
+
+    return ch;
+}
+
+topo_info *
+topo_find(topo_info *p)
+{
+    topo_info *root = p;
+    while (root->p != root) {
+        root = root->p;
+    }
+
+    /* compress path */
+    while (p->p != root) {
+        topo_info *next = p->p;
+        p->p = root;
+        p = next;
+    }
+
+    return root;
+}
+
+zone_info *
+ship_space::insert_zone(topo_info *t, float air_amount)
+{
+    if (t == &outside_topo_info) {
+        /* there is no point in combining with the outside. */
+        return nullptr;
+    }
+
+    zone_info *existing_z = get_zone_info(t);
+    if (existing_z) {
+        /* merge case; mix in this air. */
+        existing_z->air_amount += air_amount;
+        return existing_z;
+    }
+
+    /* no zone here yet; start one on the end */
+    t->zone = (int)zones.size();
+    zones.push_back(zone_info(air_amount, t));
+    return &zones.back();
+}
+
+float
+ship_space::remove_zone(topo_info *t)
+{
+    if (t->zone < 0)
+        return 0;
+
+    /* the last zone takes over the id */
+    float air_amount = zones[t->zone].air_amount;
+    zones[t->zone] = zones.back();
+    zones[t->zone].root->zone = t->zone;
+    zones.pop_back();
+    t->zone = -1;
+
+    return air_amount;
+}
+
+/* a topo node, and where it is: group `group` of the chunk c at chunk
+ * co-ords ch; or if c is null, the missing chunk at ch, whose node is an
+ * implicit chunk's or the outside */
+struct topo_ref {
+    glm::ivec3 ch;
+    chunk *c;
+    unsigned group;
+};
+
+/* the topo node of the block p */
+static topo_ref
+topo_ref_at(ship_space *ship, glm::ivec3 p)
+{
+    glm::ivec3 ch, off;
+    split_coord(p.x, &off.x, &ch.x);
+    split_coord(p.y, &off.y, &ch.y);
+    split_coord(p.z, &off.z, &ch.z);
+
+    chunk *c = ship->chunks.get(ch);
+    return topo_ref{ ch, c, c ? *c->group.get(off.x, off.y, off.z) : 0u };
+}
+
+static topo_info *
+ref_node(ship_space *ship, topo_ref const &r)
+{
+    return r.c ? r.c->groups[r.group].node : ship->get_implicit_topo_info(r.ch);
+}
+
+/* the number of blocks the node at r stands for */
+static int
+ref_size(topo_ref const &r)
+{
+    return r.c ? r.c->groups[r.group].size : CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+}
+
+/* calls f(n) for each node air can get to from r in one step: through
+ * each of the portals of r's group; or if r is a missing chunk, which is
+ * all one space, into each group of the chunks around it with a portal
+ * into it, and each missing chunk around it. r must not be the outside */
+template<typename F>
+static void
+ref_neighbours(ship_space *ship, topo_ref const &r, F f)
+{
+    for (int face = 0; face < 6; face++) {
+        glm::ivec3 nch = r.ch + surface_index_to_normal(face);
+        chunk *d = ship->chunks.get(nch);
+
+        if (r.c) {
+            for (auto const &p : r.c->portals[face]) {
+                if (p.group == r.group)
+                    f(topo_ref{ nch, d, p.other });
+            }
+        }
+        else if (d) {
+            for (auto const &p : d->portals[face ^ 1]) {
+                f(topo_ref{ nch, d, p.group });
+            }
+        }
+        else {
+            f(topo_ref{ nch, nullptr, 0 });
+        }
+    }
+}
+
+static bool
+surface_open(block_cursor const &cur, int face)
+{
+    return !cur.ch->blocks_air[face].test(cur.off.x, cur.off.y, cur.off.z);
+}
+
+/* the face of a which is against b */
+static int
+face_between(glm::ivec3 a, glm::ivec3 b)
+{
+    for (int face = 0; face < 6; face++) {
+        if (a + surface_index_to_normal(face) == b)
+            return face;
+    }
+
+    assert(!"blocks are not neighbours");
+    return 0;
+}
+
+/* retired nodes are only ever kept by groups merged in the same space,
+ * which the incremental updates have already joined; so none is a root */
+static void
+delete_retired(std::vector<topo_info *> *retired)
+{
+    for (auto t : *retired) {
+        assert(t->p != t);
+        delete t;
+    }
+    retired->clear();
+}
+
+/* the root of the space the block p is in, without paging anything in */
+static topo_info *
+space_at(ship_space *ship, glm::ivec3 p)
+{
+    return topo_find(ref_node(ship, topo_ref_at(ship, p)));
+}
+
+/* share the air of the spaces with roots t and u between them by volume.
+ * the outside goes on for ever, so takes it all */
+static void
+pool_air(ship_space *ship, topo_info *t, topo_info *u)
+{
+    if (t == u)
+        return;
+
+    if (t == &ship->outside_topo_info || u == &ship->outside_topo_info) {
+        ship->remove_zone(t);
+        ship->remove_zone(u);
+        return;
+    }
+
+    float air = ship->remove_zone(t) + ship->remove_zone(u);
+    if (air > 0) {
+        float density = air / (t->size + u->size);
+        ship->insert_zone(t, density * t->size);
+        ship->insert_zone(u, density * u->size);
+    }
+}
+
+/* bring the masks of the chunk the block p is in up to date with it.
+ * the chunk must exist */
+static void
+update_masks_at(ship_space *ship, glm::ivec3 p)
+{
+    block_cursor cur(ship, p);
+    cur.ch->update_masks(cur.off.x, cur.off.y, cur.off.z);
+}
+
+/* does the surface s let air between spaces (see ship_space::open_doors) */
+static bool
+is_connector(surface_type s)
+{
+    return s == surface_door_open || s == surface_vent;
+}
+
+/* how much of the difference in pressure between two spaces an open door,
+ * and a vent, evens out in a tick, if nothing else is going on */
+static const float door_flow = 1.0f;
+static const float vent_flow = 1.0f / 32;
+
+/* below this, the air left in a space is too thin to keep a zone for */
+static const float vacuum_pressure = 1e-6f;
+
+/* the node of the space with root t, adding one if need be */
+static unsigned
+link_node(air_links *g, topo_info *t)
+{
+    auto it = g->node_of.insert(std::make_pair(t, (unsigned)g->spaces.size()));
+    if (it.second)
+        g->spaces.push_back(t);
+    return it.first->second;
+}
+
+/* count another door (or vent) between the spaces with roots t and u; or,
+ * if delta is -1, one fewer */
+static void
+link_spaces(air_links *g, topo_info *t, topo_info *u, bool door, int delta)
+{
+    if (t == u)
+        return;     /* all one space already */
+
+    unsigned x = link_node(g, t);
+    unsigned y = link_node(g, u);
+    if (x > y)
+        std::swap(x, y);
+
+    uint64_t key = (uint64_t)x << 32 | y;
+    auto it = g->link_of.find(key);
+    if (it == g->link_of.end()) {
+        assert(delta > 0);
+        it = g->link_of.insert(std::make_pair(key, (unsigned)g->a.size())).first;
+        g->a.push_back(x);
+        g->b.push_back(y);
+        g->doors.push_back(0);
+        g->vents.push_back(0);
+    }
+
+    unsigned l = it->second;
+    (door ? g->doors : g->vents)[l] += delta;
+    g->dirty = true;
+    if (g->doors[l] || g->vents[l])
+        return;
+
+    /* nothing left between them; the last link takes over the slot */
+    unsigned last = (unsigned)g->a.size() - 1;
+    g->link_of.erase(it);
+    if (l != last) {
+        g->a[l] = g->a[last];
+        g->b[l] = g->b[last];
+        g->doors[l] = g->doors[last];
+        g->vents[l] = g->vents[last];
+        g->link_of[(uint64_t)g->a[l] << 32 | g->b[l]] = l;
+    }
+    g->a.pop_back();
+    g->b.pop_back();
+    g->doors.pop_back();
+    g->vents.pop_back();
+}
+
+/* record the open door (or, if door is false, the vent) on face of the
+ * block a, which has just gone in; or, if on is false, just gone */
+static void
+set_connector(ship_space *ship, glm::ivec3 a, int face, bool door, bool on)
+{
+    glm::ivec3 lo = (face & 1) ? a + surface_index_to_normal(face) : a;
+    unsigned char bit = 1 << (face >> 1);
+    ship_space::face_map &m = door ? ship->open_doors : ship->vents;
+
+    if (on) {
+        m[lo] |= bit;
+    }
+    else {
+        auto it = m.find(lo);
+        if (it != m.end() && !(it->second &= ~bit))
+            m.erase(it);
+    }
+
+    if (!ship->links.stale) {
+        glm::ivec3 hi = lo + surface_index_to_normal(face & ~1);
+        link_spaces(&ship->links, space_at(ship, lo), space_at(ship, hi), door, on ? 1 : -1);
+    }
+}
+
+/* link up the spaces either side of the doors, or the vents, in m */
+static void
+link_all(ship_space *ship, ship_space::face_map const &m, bool door)
+{
+    for (auto const &it : m) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (it.second & (1 << axis)) {
+                glm::ivec3 hi = it.first + surface_index_to_normal(2 * axis);
+                link_spaces(&ship->links, space_at(ship, it.first), space_at(ship, hi), door, 1);
+            }
+        }
+    }
+}
+
+/* find all the links again, from the doors and vents */
+static void
+find_links(ship_space *ship)
+{
+    air_links *g = &ship->links;
+    g->spaces.clear();
+    g->node_of.clear();
+    g->a.clear();
+    g->b.clear();
+    g->doors.clear();
+    g->vents.clear();
+    g->link_of.clear();
+
+    link_node(g, &ship->outside_topo_info);
+    link_all(ship, ship->open_doors, true);
+    link_all(ship, ship->vents, false);
+
+    g->stale = false;
+    g->dirty = true;
+}
+
+/* work out, for each link, how much air a unit difference in pressure
+ * moves along it in a tick. each link would even out some share of the
+ * difference on its own -- all of it, for a pair of spaces with their
+ * volumes V_a and V_b, is V_a V_b / (V_a + V_b) of air -- but the shares
+ * are scaled back wherever a space's links come to more than it all, so
+ * that no space ever gives up more air than it has. the outside has no
+ * end, so takes whatever it is given */
+static void
+work_out_rates(ship_space *ship)
+{
+    air_links *g = &ship->links;
+    size_t n = g->spaces.size();
+    size_t m = g->a.size();
+
+    g->air.assign(n, 0.0f);
+    g->pressure.assign(n, 0.0f);
+    g->inv_volume.resize(n);
+    g->rate.resize(m);
+    g->flow.assign(m, 0.0f);
+
+    for (size_t i = 0; i < n; i++) {
+        g->inv_volume[i] = i ? 1.0f / g->spaces[i]->size : 0.0f;
+    }
+
+    std::vector<float> total(n, 0.0f);
+    for (size_t l = 0; l < m; l++) {
+        float share = std::min(1.0f, g->doors[l] * door_flow + g->vents[l] * vent_flow);
+        g->rate[l] = share;
+        total[g->a[l]] += share;
+        total[g->b[l]] += share;
+    }
+    total[0] = 0;
+
+    for (size_t l = 0; l < m; l++) {
+        unsigned a = g->a[l], b = g->b[l];
+        float share = g->rate[l] / std::max(1.0f, std::max(total[a], total[b]));
+        float va = (float)g->spaces[a]->size, vb = (float)g->spaces[b]->size;
+        g->rate[l] = share * (a ? va * vb / (va + vb) : vb);
+    }
+
+    g->dirty = false;
+}
+
+void
+ship_space::mix_air()
+{
+    if (links.stale)
+        find_links(this);
+    if (links.a.empty())
+        return;
+    if (links.dirty)
+        work_out_rates(this);
+
+    size_t n = links.spaces.size();
+    size_t m = links.a.size();
+    float *air = &links.air[0];
+    float *pressure = &links.pressure[0];
+    float *flow = &links.flow[0];
+    float const *inv_volume = &links.inv_volume[0];
+    float const *rate = &links.rate[0];
+    unsigned const *a = &links.a[0];
+    unsigned const *b = &links.b[0];
+
+    /* 1/ the air in each space. the outside never has any */
+    air[0] = 0;
+    for (size_t i = 1; i < n; i++) {
+        zone_info *z = get_zone_info(links.spaces[i]);
+        air[i] = z ? z->air_amount : 0.0f;
+    }
+
+    /* 2/ the pressures, the flow along each link, and the air moved */
+    for (size_t i = 0; i < n; i++) {
+        pressure[i] = air[i] * inv_volume[i];
+    }
+    for (size_t l = 0; l < m; l++) {
+        flow[l] = (pressure[a[l]] - pressure[b[l]]) * rate[l];
+    }
+    for (size_t l = 0; l < m; l++) {
+        air[a[l]] -= flow[l];
+        air[b[l]] += flow[l];
+    }
+
+    /* 3/ and back into the zones */
+    for (size_t i = 1; i < n; i++) {
+        topo_info *t = links.spaces[i];
+        if (air[i] * inv_volume[i] < vacuum_pressure) {
+            remove_zone(t);
+            continue;
+        }
+
+        zone_info *z = get_zone_info(t);
+        if (z)
+            z->air_amount = air[i];
+        else
+            insert_zone(t, air[i]);
+    }
+}
+
+void
+ship_space::update_topology_for_remove_surface(glm::ivec3 a, glm::ivec3 b)
+{
+    /* any splits still pending must happen first, or the zones they would
+     * have separated get their air mixed by this unify. callers which have
+     * already removed the surface should have flushed before doing so */
+    flush_pending_splits();
+
+    topo_ref ra = topo_ref_at(this, a);
+    topo_ref rb = topo_ref_at(this, b);
+    topo_info *t = topo_find(ref_node(this, ra));
+    topo_info *u = topo_find(ref_node(this, rb));
+
+    num_fast_unifys++;
+
+    if (t != u) {
+        /* the smaller space is relabelled into the larger. the outside goes
+         * on for ever, so is always the larger */
+        topo_ref from = rb;
+        if (u == &outside_topo_info || (t != &outside_topo_info && t->size < u->size)) {
+            std::swap(t, u);
+            from = ra;
+        }
+
+        /* u's air joins t's */
+        if (u->zone >= 0)
+            insert_zone(t, remove_zone(u));
+
+        /* walk u's space through the portals as they were before the
+         * surface opened. every node in it points straight at u (see
+         * rebuild_topology), so that is what marks the ones not yet done */
+        std::vector<topo_ref> stack;
+        auto visit = [this, t, u, &stack](topo_ref const &n) {
+            topo_info *node = ref_node(this, n);
+            if (node->p == u) {
+                node->p = t;
+                stack.push_back(n);
+            }
+        };
+
+        visit(from);
+        while (!stack.empty()) {
+            topo_ref r = stack.back();
+            stack.pop_back();
+            ref_neighbours(this, r, visit);
+        }
+
+        /* a root which isn't any group's own node -- an implicit node left
+         * over from a chunk which has since been made real -- isn't walked
+         * over */
+        u->p = t;
+
+        /* track sizing */
+        t->size += u->size;
+        links.stale = true;
+    }
+
+    /* and bring the groups and portals along. blocks which were already
+     * in the same group are no more joined than they were */
+    if (ra.c != rb.c) {
+        find_portals(this, ra.ch, ra.c, face_between(a, b));
+    }
+    else if (ra.group != rb.group) {
+        std::vector<topo_info *> retired;
+        solve_groups(this, ra.c, &retired);
+        solve_faces(this, ra.ch, ra.c);
+        delete_retired(&retired);
+    }
+}
+
+/* try each one-block detour around the new surface between ca and cb:
+ * step sideways out of a, across the surface's plane, and back into b.
+ * only detours which stay in a's and b's chunks count, so that a surface
+ * with a way around it changes neither the groups nor the portals */
+static bool
+exists_alt_path(block_cursor const &ca, block_cursor const &cb, int face)
+{
+    for (int d = 0; d < 6; d++) {
+        if ((d >> 1) == (face >> 1))
+            continue;   /* the surface's own axis is no detour */
+
+        block_cursor c = ca.neighbour(d);
+        if (c.ch != ca.ch || cb.neighbour(d).ch != cb.ch)
+            continue;   /* leaves the chunks */
+
+        if (surface_open(ca, d) && surface_open(cb, d) && surface_open(c, face))
+            return true;
+    }
+
+    return false;
+}
+
+/* which blocks of a chunk have been reached */
+typedef std::bitset<CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE> chunk_bits;
+
+/* flood the air of c out from off, breadth first, without leaving c or
+ * going more than radius blocks from off along any axis. marks the blocks
+ * reached in seen, and counts them in visits. stops as soon as found() is
+ * true of a block reached, and returns whether it was */
+template<typename F>
+static bool
+bounded_flood(chunk *c, glm::ivec3 off, int radius, chunk_bits *seen, int *visits, F found)
+{
+    glm::ivec3 lo = glm::max(off - glm::ivec3(radius), glm::ivec3(0));
+    glm::ivec3 hi = glm::min(off + glm::ivec3(radius), glm::ivec3(CHUNK_SIZE - 1));
+
+    std::vector<glm::ivec3> queue(1, off);
+    seen->set(CHUNK_LAYOUT::index<CHUNK_SIZE>(off.x, off.y, off.z));
+
+    for (size_t i = 0; i < queue.size(); i++) {
+        glm::ivec3 p = queue[i];
+        (*visits)++;
+        if (found(p))
+            return true;
+
+        for (int face = 0; face < face_count; face++) {
+            if (c->blocks_air[face].test(p.x, p.y, p.z))
+                continue;
+
+            glm::ivec3 q = p + surface_index_to_normal(face);
+            if (glm::max(q, lo) != q || glm::min(q, hi) != q)
+                continue;
+
+            unsigned k = CHUNK_LAYOUT::index<CHUNK_SIZE>(q.x, q.y, q.z);
+            if (!seen->test(k)) {
+                seen->set(k);
+                queue.push_back(q);
+            }
+        }
+    }
+
+    return false;
+}
+
+/* look for any way around the new surface between ca and cb, within
+ * ship->nosplit_radius blocks of them, which stays in their chunks. if they
+ * are in different ones, the way round has to cross between them somewhere
+ * else; that keeps the portal between their groups, so a surface with a way
+ * around it again changes neither the groups nor the portals */
+static bool
+bounded_alt_path(ship_space *ship, block_cursor const &ca, block_cursor const &cb, int face)
+{
+    if (!ca.ch || !cb.ch || ca.ch == &ship_space::implicit_chunk ||
+        cb.ch == &ship_space::implicit_chunk) {
+        return false;
+    }
+
+    int radius = ship->nosplit_radius;
+    int visits = 0;
+    bool found;
+    chunk_bits seen_a;
+
+    if (ca.ch == cb.ch) {
+        glm::ivec3 b = cb.off;
+        found = bounded_flood(ca.ch, ca.off, radius, &seen_a, &visits,
+                              [b](glm::ivec3 p) { return p == b; });
+    }
+    else {
+        /* everywhere b's side gets to first; then whether a's side gets
+         * across to any of it. face is the low side's, as pending */
+        chunk_bits seen_b;
+        bounded_flood(cb.ch, cb.off, radius, &seen_b, &visits,
+                      [](glm::ivec3) { return false; });
+
+        chunk *c = ca.ch;
+        int axis = face >> 1;
+        found = bounded_flood(c, ca.off, radius, &seen_a, &visits, [&](glm::ivec3 p) {
+            if (p[axis] != CHUNK_SIZE - 1 || c->blocks_air[face].test(p.x, p.y, p.z))
+                return false;
+
+            p[axis] = 0;
+            return seen_b.test(CHUNK_LAYOUT::index<CHUNK_SIZE>(p.x, p.y, p.z));
+        });
+    }
+
+    ship->num_bounded_visits += visits;
+    if (found)
+        ship->num_bounded_nosplits++;
+    else
+        ship->num_bounded_misses++;
+    return found;
+}
+
+/* todo: we should be able to calculate face */
+void
+ship_space::update_topology_for_add_surface(glm::ivec3 a, glm::ivec3 b, int face)
+{
+    /* collapse an obvious symmetry */
+    if (face & 1) {
+        /* symmetry */
+        std::swap(a, b);
+        face ^= 1;
+    }
+
+    begin_edit();
+    pending_splits.push_back(pending_split{ a, b, face });
+    commit();
+}
+
+/* the air reachable from one of the places a walk started from, as
+ * walked so far */
+struct air_side {
+    std::deque<topo_ref> queue;         /* places still to go from */
+    std::vector<topo_info *> nodes;     /* every node visited */
+    int size;                           /* blocks visited */
+    bool outside;                       /* got outside the ship */
+
+    air_side() : size(0), outside(false) {}
+};
+
+/* walks the portals out from a number of places in one space at once, a
+ * step each in turn. sides which meet are joined into a set, as are all
+ * the sides which get outside. a set which runs out of places to go has
+ * found the whole of a space; the walk stops once at most one set is still
+ * going, as whatever is left is all one space.
+ *
+ * taking turns, the walk costs about the size of the spaces which were
+ * cut off, times the number of places, however big the rest is.
+ */
+struct air_walk {
+    ship_space *ship;
+    std::vector<air_side> sides;
+    std::vector<int> sets;                          /* union-find over sides */
+    std::unordered_map<topo_info *, int> seen;      /* node -> side */
+    int outside_side;                               /* the first to get outside, or -1 */
+
+    explicit air_walk(ship_space *ship) : ship(ship), outside_side(-1) {}
+
+    int find(int side)
+    {
+        while (sets[side] != side)
+            side = sets[side] = sets[sets[side]];
+        return side;
+    }
+
+    void join(int a, int b)
+    {
+        sets[find(b)] = find(a);
+    }
+
+    void start(topo_ref const &r)
+    {
+        sides.push_back(air_side());
+        sets.push_back((int)sets.size());
+        visit((int)sides.size() - 1, r);
+    }
+
+    void visit(int side, topo_ref const &r)
+    {
+        topo_info *t = ref_node(ship, r);
+        if (t == &ship->outside_topo_info) {
+            sides[side].outside = true;
+            if (outside_side < 0)
+                outside_side = side;
+            else
+                join(outside_side, side);
+            return;
+        }
+
+        auto it = seen.insert(std::make_pair(t, side));
+        if (!it.second) {
+            join(it.first->second, side);
+            return;
+        }
+
+        sides[side].nodes.push_back(t);
+        sides[side].size += ref_size(r);
+        sides[side].queue.push_back(r);
+    }
+
+    void step(int side)
+    {
+        topo_ref r = sides[side].queue.front();
+        sides[side].queue.pop_front();
+        ref_neighbours(ship, r, [this, side](topo_ref const &n) { visit(side, n); });
+    }
+
+    /* whether side has places left to go from, or got outside */
+    bool going(int side) const
+    {
+        return !sides[side].queue.empty() || sides[side].outside;
+    }
+
+    /* the one set still going, or -1 if there is none; see run() */
+    int going()
+    {
+        for (int side = 0; side < (int)sides.size(); side++) {
+            if (going(side))
+                return find(side);
+        }
+
+        return -1;
+    }
+
+    /* whether at most one set is still going */
+    bool settled()
+    {
+        int set = going();
+        for (int side = 0; side < (int)sides.size(); side++) {
+            if (going(side) && find(side) != set)
+                return false;
+        }
+
+        return true;
+    }
+
+    void run()
+    {
+        while (!settled()) {
+            for (int side = 0; side < (int)sides.size(); side++) {
+                if (!sides[side].queue.empty())
+                    step(side);
+            }
+        }
+    }
+
+    /* walk all of set, which must be cut off from every other */
+    void finish(int set)
+    {
+        for (int side = 0; side < (int)sides.size(); side++) {
+            while (find(side) == set && !sides[side].queue.empty())
+                step(side);
+        }
+    }
+};
+
+/* find out whether the space with root old_root, which the surfaces
+ * between the groups at seeds went into, is now several, and give each
+ * but one its own root. the air is shared out by volume, so every part
+ * keeps the pressure it had. returns the number of parts split off */
+static int
+split_space(ship_space *ship, topo_info *old_root, std::vector<topo_ref> const &seeds)
+{
+    air_walk walk(ship);
+    for (auto const &r : seeds) {
+        walk.start(r);
+    }
+    walk.run();
+
+    /* the old root stays with the part it is in, as that all still points
+     * at it: the part it was found in, or the one which got outside, for
+     * the outside. if it wasn't found, the part still being walked may
+     * have it; if nothing is, it is a root which isn't any group's own
+     * node, and any part may have it */
+    int going = walk.going();
+    int keep;
+    auto it = walk.seen.find(old_root);
+    if (it != walk.seen.end())
+        keep = walk.find(it->second);
+    else if (old_root == &ship->outside_topo_info)
+        keep = walk.outside_side >= 0 ? walk.find(walk.outside_side) : going;
+    else
+        keep = going >= 0 ? going : walk.find(0);
+
+    /* the part still being walked is relabelled if it doesn't have the
+     * root, so must be walked in full. it never has the outside: that
+     * is the root of its space */
+    if (going >= 0 && going != keep) {
+        walk.finish(going);
+        assert(!walk.sides[going].outside);
+    }
+
+    int zone = old_root->zone;
+    float density = zone >= 0 ? ship->zones[zone].air_amount / old_root->size : 0;
+
+    int parts = 0;
+    for (int set = 0; set < (int)walk.sides.size(); set++) {
+        if (walk.find(set) != set || set == keep)
+            continue;
+
+        topo_info *root = nullptr;
+        int size = 0;
+        for (int side = 0; side < (int)walk.sides.size(); side++) {
+            if (walk.find(side) != set)
+                continue;
+
+            air_side const &s = walk.sides[side];
+            for (auto t : s.nodes) {
+                if (!root)
+                    root = t;
+                t->p = root;
+            }
+            size += s.size;
+        }
+
+        root->rank = 0;
+        root->size = size;
+        root->zone = -1;
+        old_root->size -= size;
+        parts++;
+        ship->links.stale = true;
+
+        if (zone >= 0) {
+            ship->zones[zone].air_amount -= density * size;
+            ship->insert_zone(root, density * size);
+        }
+    }
+
+    return parts;
+}
+
+void
+ship_space::flush_pending_splits()
+{
+    if (pending_splits.empty())
+        return;
+
+    std::vector<pending_split> splits;
+    splits.swap(pending_splits);
+
+    /* none of the surfaces can have been taken out again since it went in,
+     * as that flushes, so they can all be worked out on the blocks as they
+     * are now. first, which might split anything, and which chunks' groups
+     * and portals they change */
+    std::vector<pending_split> slow;
+    std::unordered_set<glm::ivec3, ivec3_hash> solve;
+    for (auto const &s : splits) {
+        block_cursor ca(this, s.a);
+        block_cursor cb(this, s.b);
+
+        /* can this surface even split (does it block atmo?) */
+        if (surface_open(ca, s.face))
+            continue;
+
+        /* try to quickly prove that we don't divide space */
+        if (exists_alt_path(ca, cb, s.face)) {
+            num_fast_nosplits++;
+            continue;
+        }
+
+        /* or a little less quickly, by looking further afield */
+        if (nosplit_radius > 0 && bounded_alt_path(this, ca, cb, s.face)) {
+            continue;
+        }
+
+        slow.push_back(s);
+        if (ca.ch == cb.ch)
+            solve.insert(ca.ch_pos);
+    }
+
+    std::vector<topo_info *> retired;
+    for (auto ch : solve) {
+        chunk *c = chunks.get(ch);
+        solve_groups(this, c, &retired);
+        solve_faces(this, ch, c);
+    }
+    delete_retired(&retired);
+
+    /* then, for each space they went into, the groups either side of them.
+     * the groups split off from an old one are still in its space */
+    std::vector<topo_info *> roots;
+    std::unordered_map<topo_info *, std::vector<topo_ref>> seeds;
+    for (auto const &s : slow) {
+        topo_ref ra = topo_ref_at(this, s.a);
+        topo_ref rb = topo_ref_at(this, s.b);
+
+        if (ra.c != rb.c && !solve.count(ra.ch) && !solve.count(rb.ch))
+            find_portals(this, ra.ch, ra.c, s.face);
+
+        if (ra.c == rb.c && ra.group == rb.group) {
+            /* still joined within the chunk */
+            num_local_nosplits++;
+            continue;
+        }
+
+        topo_ref both[] = { ra, rb };
+        for (auto const &r : both) {
+            topo_info *root = topo_find(ref_node(this, r));
+            std::vector<topo_ref> &v = seeds[root];
+            if (v.empty())
+                roots.push_back(root);
+            v.push_back(r);
+        }
+    }
+
+    /* and walk each of them, from all those groups at once */
+    for (auto root : roots) {
+        int parts = split_space(this, root, seeds[root]);
+        if (parts)
+            num_local_splits += parts;
+        else
+            num_local_nosplits++;
+    }
+}
+
+static glm::ivec3 dirs[] = {
+    glm::ivec3(1, 0, 0),
+    glm::ivec3(-1, 0, 0),
+    glm::ivec3(0, 1, 0),
+    glm::ivec3(0, -1, 0),
+    glm::ivec3(0, 0, 1),
+    glm::ivec3(0, 0, -1),
+};
+
+
+/* the union-find behind rebuild_topology(), over the nodes numbered
+ * densely, which the workers can all unite into at once: a lost race
+ * just means looking again. a root is always linked under a lower
+ * numbered one, so the lowest numbered node of a space ends up its root */
+typedef std::vector<std::atomic<unsigned>> rebuild_sets;
+
+static unsigned
+rebuild_find(rebuild_sets &sets, unsigned i)
+{
+    for (;;) {
+        unsigned p = sets[i].load();
+        if (p == i)
+            return i;
+
+        /* path halving: if someone else got there first, fine */
+        unsigned gp = sets[p].load();
+        if (gp != p)
+            sets[i].compare_exchange_weak(p, gp);
+        i = gp;
+    }
+}
+
+static void
+rebuild_unite(rebuild_sets &sets, unsigned a, unsigned b)
+{
+    for (;;) {
+        a = rebuild_find(sets, a);
+        b = rebuild_find(sets, b);
+        if (a == b)
+            return;
+        if (a > b)
+            std::swap(a, b);
+
+        /* b may have stopped being a root since */
+        unsigned expected = b;
+        if (sets[b].compare_exchange_strong(expected, a))
+            return;
+    }
+}
+
+/* rebuild the ship topology. this is generally not the optimal thing -
+ * we can dynamically rebuild parts of the topology cheaper based on
+ * knowing the change that was made.
+ *
+ * the per-chunk work and the unions are spread across the worker
+ * threads, if there are any (see set_worker_threads)
+ */
+void
+ship_space::rebuild_topology()
+{
+    num_full_rebuilds++;
+
+    const size_t grain = 16;    /* chunks (or nodes, / 16) per range */
+    std::vector<std::pair<glm::ivec3, chunk *>> all;
+    for (auto it = chunks.begin(); it != chunks.end(); it++) {
+        ensure_resident(it->first, it->second);
+        all.push_back(*it);
+    }
+
+    /* 1/ work out the masks again of every chunk whose blocks may have been
+     * written directly, and then every chunk's groups from its masks. the
+     * nodes come from a shared pool, so are handed out here. old nodes
+     * which no group kept may still be zone keys, so they are dropped
+     * only once the zones have moved */
+    std::vector<group_solve> solves(all.size());
+    parallel_for(workers, all.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            chunk *c = all[i].second;
+            if (c->masks_stale) {
+                c->update_masks();
+                c->masks_stale = false;
+            }
+            label_groups(c, &solves[i]);
+        }
+    });
+
+    std::vector<topo_info *> retired;
+    for (size_t i = 0; i < all.size(); i++) {
+        keep_nodes(all[i].second, &solves[i], &retired);
+        num_chunk_solves++;
+    }
+    solves.clear();
+
+    /* every missing chunk within the bounds is implicit. nodes left over
+     * from chunks which have since been materialised may still be zone
+     * keys; they're pointed into the chunk once it's done, so the zone
+     * follows, and dropped once that's done */
+    for (int k = mins.z + 1; k < maxs.z; k++) {
+        for (int j = mins.y + 1; j < maxs.y; j++) {
+            for (int i = mins.x + 1; i < maxs.x; i++) {
+                glm::ivec3 v(i, j, k);
+                if (!chunks.get(v) && !implicit_topo.count(v)) {
+                    topo_info &t = implicit_topo[v];
+                    t.p = &t;
+                    t.rank = 0;
+                    t.size = 0;
+                    t.zone = -1;
+                }
+            }
+        }
+    }
+
+    /* 2/ find the portals, now that every chunk has its groups. each face
+     * between two chunks is done once, from its low side, so no two
+     * workers write the same portals. and find the open doors and vents,
+     * which the portals don't go through, from the low side of each */
+    std::vector<std::vector<std::pair<glm::ivec3, int>>> connectors(all.size());
+    parallel_for(workers, all.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            chunk *c = all[i].second;
+            for (int face = 0; face < face_count; face++) {
+                if (!(face & 1) || !chunks.get(all[i].first + surface_index_to_normal(face)))
+                    find_portals(this, all[i].first, c, face);
+            }
+
+            block const *u = &c->blocks.uniform;
+            if (c->blocks.is_uniform() && !is_connector(u->surfs[surface_xp]) &&
+                !is_connector(u->surfs[surface_yp]) && !is_connector(u->surfs[surface_zp])) {
+                continue;
+            }
+
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                for (int y = 0; y < CHUNK_SIZE; y++) {
+                    for (int x = 0; x < CHUNK_SIZE; x++) {
+                        block const *bl = c->blocks.peek(x, y, z);
+                        for (int face = surface_xp; face < face_count; face += 2) {
+                            if (is_connector(bl->surfs[face])) {
+                                connectors[i].push_back(std::make_pair(
+                                    CHUNK_SIZE * all[i].first + glm::ivec3(x, y, z),
+                                    bl->surfs[face] == surface_door_open ? face : face | 8));
+                            }
+                        }
                     }
                 }
+            }
+        }
+    });
+
+    /* the spaces are about to change, so the links go stale; and they are
+     * found again from these */
+    links.stale = true;
+    open_doors.clear();
+    vents.clear();
+    for (auto const &found : connectors) {
+        for (auto const &d : found) {
+            set_connector(this, d.first, d.second & 7, !(d.second & 8), true);
+        }
+    }
 
-                bl = it->second->blocks.get(y, CHUNK_SIZE - 1, z);
-                to = it->second->topo.get(y, CHUNK_SIZE - 1, z);
+    /* 3/ number the nodes: the outside first, so that it is the root of
+     * its space (see split_space), then the implicit chunks, then each
+     * chunk's groups */
+    std::vector<topo_info *> nodes;
+    std::unordered_map<topo_info *, unsigned> missing;  /* the outside and implicit nodes */
+    std::vector<glm::ivec3> implicit;
+    std::vector<glm::ivec3> stale;
+
+    nodes.push_back(&outside_topo_info);
+    missing[&outside_topo_info] = 0;
+    for (auto &it : implicit_topo) {
+        if (chunks.get(it.first)) {
+            stale.push_back(it.first);
+            continue;
+        }
 
-                for (int i = 0; i < 6; i++) {
-                    if (air_permeable(bl->surfs[i])) {
-                        glm::ivec3 offset = dirs[i];
-                        topo_unite(to,
-                            get_topo_info(CHUNK_SIZE * it->first + glm::ivec3(y, CHUNK_SIZE - 1, z) + offset));
-                    }
-                }
+        missing[&it.second] = (unsigned)nodes.size();
+        nodes.push_back(&it.second);
+        implicit.push_back(it.first);
+    }
 
-                bl = it->second->blocks.get(y, z, 0);
-                to = it->second->topo.get(y, z, 0);
+    for (auto &it : all) {
+        it.second->topo_base = (unsigned)nodes.size();
+        for (auto &g : it.second->groups) {
+            nodes.push_back(g.node);
+        }
+    }
 
-                for (int i = 0; i < 6; i++) {
-                    if (air_permeable(bl->surfs[i])) {
-                        glm::ivec3 offset = dirs[i];
-                        topo_unite(to,
-                            get_topo_info(CHUNK_SIZE * it->first + glm::ivec3(y, z, 0) + offset));
-                    }
+    rebuild_sets sets(nodes.size());
+    parallel_for(workers, nodes.size(), grain * 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            sets[i].store((unsigned)i);
+        }
+    });
+
+    /* 4/ combine across the portals: between two chunks from the low
+     * side, as the portals go both ways. implicit chunks have no
+     * surfaces, so are open to every neighbour; their real neighbours
+     * were done from the real side */
+    parallel_for(workers, all.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            chunk *c = all[i].second;
+            for (int face = 0; face < face_count; face++) {
+                glm::ivec3 nch = all[i].first + surface_index_to_normal(face);
+                chunk *d = chunks.get(nch);
+                if (d && !(face & 1))
+                    continue;
+
+                unsigned other = d ? 0 : missing.find(get_implicit_topo_info(nch))->second;
+                for (auto const &p : c->portals[face]) {
+                    rebuild_unite(sets, c->topo_base + p.group,
+                                  d ? d->topo_base + p.other : other);
+                }
+            }
+        }
+    });
+
+    parallel_for(workers, implicit.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            for (int face = 0; face < face_count; face++) {
+                glm::ivec3 nch = implicit[i] + surface_index_to_normal(face);
+                if (!chunks.get(nch)) {
+                    rebuild_unite(sets, (unsigned)i + 1,
+                                  missing.find(get_implicit_topo_info(nch))->second);
                 }
+            }
+        }
+    });
 
-                bl = it->second->blocks.get(y, z, CHUNK_SIZE - 1);
-                to = it->second->topo.get(y, z, CHUNK_SIZE - 1);
+    /* 5/ finalize, and accumulate sizes */
+    std::vector<std::atomic<int>> sizes(nodes.size());
+    parallel_for(workers, nodes.size(), grain * 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            sizes[i].store(0);
+        }
+    });
 
-                for (int i = 0; i < 6; i++) {
-                    if (air_permeable(bl->surfs[i])) {
-                        glm::ivec3 offset = dirs[i];
-                        topo_unite(to,
-                            get_topo_info(CHUNK_SIZE * it->first + glm::ivec3(y, z, CHUNK_SIZE - 1) + offset));
-                    }
-                }
+    parallel_for(workers, all.size(), grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            chunk *c = all[i].second;
+            for (unsigned g = 0; g < c->groups.size(); g++) {
+                sizes[rebuild_find(sets, c->topo_base + g)] += c->groups[g].size;
             }
         }
+    });
+
+    for (size_t i = 0; i < implicit.size(); i++) {
+        sizes[rebuild_find(sets, (unsigned)i + 1)] += CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
     }
 
-    /* 3/ finalize, and accumulate sizes */
-    for (auto it = chunks.begin(); it != chunks.end(); it++) {
-        for (int z = 0; z < CHUNK_SIZE; z++) {
-            for (int y = 0; y < CHUNK_SIZE; y++) {
-                for (int x = 0; x < CHUNK_SIZE; x++) {
-                    topo_info *t = topo_find(it->second->topo.get(x, y, z));
-                    t->size++;
-                }
-            }
+    parallel_for(workers, nodes.size(), grain * 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            nodes[i]->p = nodes[rebuild_find(sets, (unsigned)i)];
+            nodes[i]->rank = 0;
+            nodes[i]->size = sizes[i].load();
+            nodes[i]->zone = -1;
+        }
+    });
+
+    for (auto v : stale) {
+        implicit_topo[v].p = chunks.get(v)->topo(0, 0, 0);
+    }
+
+    /* 6/ fixup zone_info. each zone follows its old root to the new one,
+     * in place: zones which end up in the same space are merged into the
+     * first of them, and those which end up outside are vented */
+    size_t num_zones = 0;
+    for (size_t i = 0; i < zones.size(); i++) {
+        topo_info *t = topo_find(zones[i].root);
+        if (t == &outside_topo_info)
+            continue;
+
+        if (t->zone >= 0) {
+            zones[t->zone].air_amount += zones[i].air_amount;
+        }
+        else {
+            t->zone = (int)num_zones;
+            zones[num_zones++] = zone_info(zones[i].air_amount, t);
         }
     }
+    zones.resize(num_zones, zone_info(0, nullptr));
+
+    /* 7/ drop the nodes we no longer need: the retired and stale ones, and
+     * implicit ones which are just part of the outside. everything now
+     * points straight at its root, so only roots can be referred to */
+    for (auto t : retired) {
+        delete t;
+    }
+
+    for (auto v : stale) {
+        implicit_topo.erase(v);
+    }
 
-    /* 4/ fixup zone_info */
-    std::unordered_map<topo_info *, zone_info *> old_zones(std::move(zones));
-    for (auto it : old_zones) {
-        insert_zone(topo_find(it.first), it.second);
+    topo_info *outside = topo_find(&outside_topo_info);
+    for (auto it = implicit_topo.begin(); it != implicit_topo.end(); ) {
+        topo_info *t = &it->second;
+        if (t->p != t && t->p == outside)
+            it = implicit_topo.erase(it);
+        else
+            ++it;
     }
 }
 
@@ -679,14 +2395,18 @@ ship_space::validate()
     bool pass = true;
 
     for (auto ch : chunks) {
+        ensure_resident(ch.first, ch.second);
+
         for (int z = 0; z < CHUNK_SIZE; z++) {
             for (int y = 0; y < CHUNK_SIZE; y++) {
                 for (int x = 0; x < CHUNK_SIZE; x++) {
-                    block *bl = ch.second->blocks.get(x, y, z);
+                    block_cursor cur(this, ch.first, ch.second, glm::ivec3(x, y, z));
+                    block const *bl = cur.peek();
                     for (int face = 0; face < 6; face++) {
                         glm::ivec3 offset = dirs[face];
-                        glm::ivec3 other_coord = CHUNK_SIZE * ch.first + glm::ivec3(x, y, z) + offset;
-                        block *other = get_block(other_coord);
+                        block_cursor other_cur = cur.neighbour(face);
+                        glm::ivec3 other_coord = other_cur.pos;
+                        block const *other = other_cur.peek();
 
                         if (bl->surfs[face]) {
                             /* 1/ every surface must be consistent with its far side. this implies that the
@@ -711,12 +2431,57 @@ ship_space::validate()
                                 pass = false;
                             }
                         }
+
+                        /* 3/ blocks which air can get between without leaving the chunk must be
+                         *    in the same group */
+                        if (air_permeable(bl->surfs[face]) && other_cur.ch == ch.second &&
+                            *ch.second->group.get(x, y, z) !=
+                            *ch.second->group.get(other_cur.off.x, other_cur.off.y, other_cur.off.z)) {
+                            printf("validate(): %d %d %d face %d is open, but joins two groups\n",
+                                    other_coord.x - offset.x, other_coord.y - offset.y,
+                                    other_coord.z - offset.z, face);
+                            pass = false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /* 4/ every chunk's masks must match its blocks */
+    for (auto ch : chunks) {
+        chunk *c = ch.second;
+        ensure_resident(ch.first, c);
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    block const *bl = c->blocks.peek(x, y, z);
+                    bool ok = c->occupied.test(x, y, z) == (bl->type != block_empty);
+                    for (int face = 0; face < face_count; face++) {
+                        ok = ok && c->blocks_air[face].test(x, y, z) == !air_permeable(bl->surfs[face]);
+                        ok = ok && c->blocks_light[face].test(x, y, z) == !light_permeable(bl->surfs[face]);
+                    }
+
+                    if (!ok) {
+                        printf("validate(): %d %d %d doesn't match its chunk's masks\n",
+                                CHUNK_SIZE * ch.first.x + x, CHUNK_SIZE * ch.first.y + y,
+                                CHUNK_SIZE * ch.first.z + z);
+                        pass = false;
                     }
                 }
             }
         }
     }
 
+    /* 5/ every zone must belong to a root which knows its id */
+    for (size_t i = 0; i < zones.size(); i++) {
+        topo_info *t = zones[i].root;
+        if (t->p != t || t->zone != (int)i || t == &outside_topo_info) {
+            printf("validate(): zone %zu is not the zone of its root\n", i);
+            pass = false;
+        }
+    }
+
     /* TODO: validate anything else we might have screwed up */
     if (pass) {
         printf("validate(): OK\n");
@@ -725,33 +2490,494 @@ ship_space::validate()
     return pass;
 }
 
-/* todo: we should be able to calculate surface index */
+unsigned
+ship_space::compact_chunks()
+{
+    unsigned uniform = 0;
+
+    for (auto ch : chunks) {
+        /* a paged-out chunk is stored compactly already */
+        if (ch.second->resident)
+            uniform += ch.second->blocks.compact();
+    }
+
+    return uniform;
+}
+
+
+size_t
+ship_space::block_memory_used()
+{
+    size_t bytes = 0;
+
+    for (auto ch : chunks) {
+        bytes += ch.second->blocks.memory_used();
+    }
+
+    return bytes;
+}
+
+
 void
-ship_space::set_surface(glm::ivec3 a, glm::ivec3 b, surface_index index, surface_type st) {
+ship_space::enable_streaming(char const *store_filename, unsigned max_resident)
+{
+    assert(!store || !"streaming is already enabled");
+
+    store = new chunk_store(store_filename);
+    this->max_resident = max_resident;
+
+    for (auto ch : chunks) {
+        make_resident(ch.first, ch.second);
+    }
+}
+
+
+void
+ship_space::update_residency(glm::ivec3 const *centers, unsigned num_centers, int radius)
+{
+    if (!store)
+        return;
+
+    assert(edit_depth == 0 || !"residency can't change within a transaction");
+    residency_frame++;
+
+    /* 1/ install what the loader has finished, unless the chunk has been
+     *    read back already, or paged out again since it was asked for */
+    chunk_store::loaded l;
+    while (store->take(&l)) {
+        chunk *c = chunks.get(l.ch);
+        if (c && !c->resident && c->requested && c->generation == l.generation) {
+            chunk_store::install(l, &c->blocks);
+            make_resident(l.ch, c);
+        }
+    }
+
+    /* 2/ keep the chunks around each center, and ask for any which are
+     *    paged out */
+    for (unsigned i = 0; i < num_centers; i++) {
+        glm::ivec3 center;
+        split_coord(centers[i].x, nullptr, &center.x);
+        split_coord(centers[i].y, nullptr, &center.y);
+        split_coord(centers[i].z, nullptr, &center.z);
+
+        for (int z = -radius; z <= radius; z++) {
+            for (int y = -radius; y <= radius; y++) {
+                for (int x = -radius; x <= radius; x++) {
+                    glm::ivec3 v = center + glm::ivec3(x, y, z);
+                    chunk *c = chunks.get(v);
+                    if (!c)
+                        continue;
+
+                    c->last_used = residency_frame;
+                    if (c->resident) {
+                        lru.splice(lru.begin(), lru, c->lru);
+                    }
+                    else if (!c->requested) {
+                        store->request(v, c->generation);
+                        c->requested = true;
+                    }
+                }
+            }
+        }
+    }
+
+    /* 3/ page out the least recently used. everything wanted this frame is
+     *    at the front, so once one of those is reached, we're done */
+    while (num_resident > max_resident) {
+        glm::ivec3 v = lru.back();
+        chunk *c = chunks.get(v);
+        if (c->last_used == residency_frame)
+            break;
+
+        page_out(v, c);
+    }
+}
+
+
+/* read a paged-out chunk back, now */
+void
+ship_space::page_in(glm::ivec3 ch, chunk *c)
+{
+    store->read(ch, &c->blocks);
+    make_resident(ch, c);
+}
+
+
+void
+ship_space::page_out(glm::ivec3 ch, chunk *c)
+{
+    if (on_page_out)
+        on_page_out(c);
+
+    /* the masks stay behind, so must be right before the blocks go */
+    if (c->masks_stale) {
+        c->update_masks();
+        c->masks_stale = false;
+    }
+
+    store->write(ch, c->blocks);
+    c->blocks = chunk_blocks();
+    c->render_chunk.valid = false;
+
+    c->resident = false;
+    c->requested = false;
+    c->generation++;
+    lru.erase(c->lru);
+    num_resident--;
+}
+
+
+/* c's blocks are in memory; put it at the front of the lru */
+void
+ship_space::make_resident(glm::ivec3 ch, chunk *c)
+{
+    c->resident = true;
+    c->requested = false;
+    c->last_used = residency_frame;
+    c->lru = lru.insert(lru.begin(), ch);
+    num_resident++;
+}
+
+
+void
+ship_space::begin_edit()
+{
+    edit_depth++;
+}
+
+
+void
+ship_space::commit()
+{
+    assert(edit_depth > 0 || !"commit() without begin_edit()");
+
+    if (--edit_depth)
+        return;
+
+    flush_pending_splits();
+
+    /* publish this transaction's changes */
+    journal_committed = journal.size();
+
+    if (recording_undo) {
+        recording_undo = false;
+
+        if (!recording.where.empty()) {
+            for (auto ch : recording.where) {
+                recording.after.push_back(chunks.get(ch)->blocks);
+            }
+
+            undo_steps.push_back(undo_step());
+            undo_steps.back().where.swap(recording.where);
+            undo_steps.back().before.swap(recording.before);
+            undo_steps.back().after.swap(recording.after);
+            if (undo_steps.size() > max_undo_steps)
+                undo_steps.pop_front();
+
+            redo_steps.clear();
+        }
+    }
+}
+
+
+unsigned
+ship_space::subscribe()
+{
+    unsigned sub = 0;
+    while (sub < journal_readers.size() && journal_readers[sub] != no_reader)
+        sub++;
+
+    if (sub == journal_readers.size())
+        journal_readers.push_back(journal_committed);
+    else
+        journal_readers[sub] = journal_committed;
+
+    return sub;
+}
+
+
+void
+ship_space::unsubscribe(unsigned sub)
+{
+    assert(sub < journal_readers.size() && journal_readers[sub] != no_reader);
+
+    journal_readers[sub] = no_reader;
+    trim_journal();
+}
+
+
+void
+ship_space::record(block_delta const &d)
+{
+    bool any_readers = false;
+    for (auto r : journal_readers) {
+        any_readers |= r != no_reader;
+    }
+
+    if (any_readers) {
+        journal.push_back(d);
+    }
+}
+
+
+/* drop the changes every subscriber has seen */
+void
+ship_space::trim_journal()
+{
+    size_t seen = journal_committed;
+    for (auto r : journal_readers) {
+        if (r != no_reader && r < seen)
+            seen = r;
+    }
+
+    if (!seen)
+        return;
+
+    journal.erase(journal.begin(), journal.begin() + seen);
+    journal_committed -= seen;
+    for (auto &r : journal_readers) {
+        if (r != no_reader)
+            r -= seen;
+    }
+}
+
+
+/* the one place surfaces are changed: writes both sides, records the change,
+ * and brings the topology along */
+void
+ship_space::write_surface(glm::ivec3 a, glm::ivec3 b, surface_index index, surface_type st)
+{
+    block const *cur = block_cursor(this, a).peek();
+    surface_type old = cur ? cur->surfs[index] : surface_none;
+    if (old == st)
+        return;
+
+    save_for_undo(a);
+    save_for_undo(b);
+
     auto block = ensure_block(a);
     auto other_block = ensure_block(b);
 
-    block->surfs[index] = st;
-    get_chunk_containing(a)->render_chunk.valid = false;
+    bool was_permeable = air_permeable(old) != 0;
+    bool now_permeable = air_permeable(st) != 0;
 
+    begin_edit();
+
+    if (now_permeable && !was_permeable) {
+        /* this may join spaces. any splits still pending must be made
+         * first, so that they see the spaces as they were when their
+         * surfaces went in */
+        flush_pending_splits();
+    }
+
+    block->surfs[index] = st;
     other_block->surfs[index ^ 1] = st;
-    get_chunk_containing(b)->render_chunk.valid = false;
+    update_masks_at(this, a);
+    update_masks_at(this, b);
+
+    block_delta d;
+    d.p = a;
+    d.face = index;
+    d.old_value = old;
+    d.new_value = st;
+    record(d);
+
+    if (now_permeable && !was_permeable) {
+        update_topology_for_remove_surface(a, b);
+    }
+    else if (was_permeable && !now_permeable) {
+        update_topology_for_add_surface(a, b, index);
+    }
+
+    /* doors opening and closing, and vents, leave the topology alone */
+    if (old == surface_door_open || old == surface_vent)
+        set_connector(this, a, index, old == surface_door_open, false);
+    if (st == surface_door_open || st == surface_vent)
+        set_connector(this, a, index, st == surface_door_open, true);
+    if (st == surface_door_open)
+        pool_air(this, space_at(this, a), space_at(this, b));
+
+    commit();
+}
+
 
-    update_topology_for_add_surface(a, b, index);
+/* todo: we should be able to calculate surface index */
+void
+ship_space::set_surface(glm::ivec3 a, glm::ivec3 b, surface_index index, surface_type st) {
+    write_surface(a, b, index, st);
 }
 
 
 /* todo: we should be able to calculate surface index */
 void
 ship_space::remove_surface(glm::ivec3 a, glm::ivec3 b, surface_index index) {
-    auto block = ensure_block(a);
-    auto other_block = ensure_block(b);
+    write_surface(a, b, index, surface_none);
+}
 
-    block->surfs[index] = surface_none;
-    get_chunk_containing(a)->render_chunk.valid = false;
 
-    other_block->surfs[index ^ 1] = surface_none;
-    get_chunk_containing(b)->render_chunk.valid = false;
+void
+ship_space::set_block_type(glm::ivec3 block, block_type type) {
+    struct block const *cur = block_cursor(this, block).peek();
+    block_type old = cur ? cur->type : block_empty;
+    if (old == type)
+        return;
+
+    block_delta d;
+    d.p = block;
+    d.face = -1;
+    d.old_value = old;
+    d.new_value = type;
+
+    begin_edit();
+    save_for_undo(block);
+    ensure_block(block)->type = type;
+    update_masks_at(this, block);
+    record(d);
+    commit();
+}
+
+
+ship_snapshot *
+ship_space::snapshot()
+{
+    ship_snapshot *snap = new ship_snapshot;
+    snap->mins = mins;
+    snap->maxs = maxs;
+    snap->chunks.reserve(chunks.size());
+
+    for (auto ch : chunks) {
+        ensure_resident(ch.first, ch.second);
+        snap->chunks.insert(std::make_pair(ch.first, ch.second->blocks));
+    }
+
+    return snap;
+}
+
+
+block const *
+ship_snapshot::get_block(glm::ivec3 p) const
+{
+    glm::ivec3 ch, off;
+    split_coord(p.x, &off.x, &ch.x);
+    split_coord(p.y, &off.y, &ch.y);
+    split_coord(p.z, &off.z, &ch.z);
+
+    auto it = chunks.find(ch);
+    if (it != chunks.end())
+        return it->second.peek(off.x, off.y, off.z);
+
+    if (ch.x > mins.x && ch.x < maxs.x &&
+        ch.y > mins.y && ch.y < maxs.y &&
+        ch.z > mins.z && ch.z < maxs.z) {
+        return ship_space::implicit_chunk.blocks.peek(off.x, off.y, off.z);
+    }
+
+    return nullptr;
+}
+
+
+void
+ship_space::begin_undoable_edit()
+{
+    if (!edit_depth)
+        recording_undo = true;
+
+    begin_edit();
+}
+
+
+void
+ship_space::save_for_undo(glm::ivec3 block)
+{
+    if (!recording_undo)
+        return;
+
+    glm::ivec3 ch, off;
+    split_coord(block.x, &off.x, &ch.x);
+    split_coord(block.y, &off.y, &ch.y);
+    split_coord(block.z, &off.z, &ch.z);
+
+    for (auto w : recording.where) {
+        if (w == ch)
+            return;
+    }
+
+    recording.where.push_back(ch);
+    recording.before.push_back(ensure_chunk(ch)->blocks);
+}
+
+
+/* edit the blocks of the chunk at ch which differ between from and to back
+ * to how they are in to */
+static void
+restore_blocks(ship_space *ship, glm::ivec3 ch, chunk_blocks const &from, chunk_blocks const &to)
+{
+    if (from.same_storage(to))
+        return;
+
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+        for (int y = 0; y < CHUNK_SIZE; y++) {
+            for (int x = 0; x < CHUNK_SIZE; x++) {
+                block const *f = from.peek(x, y, z);
+                block const *t = to.peek(x, y, z);
+                glm::ivec3 p = CHUNK_SIZE * ch + glm::ivec3(x, y, z);
+
+                if (f->type != t->type)
+                    ship->set_block_type(p, t->type);
+
+                for (int face = 0; face < face_count; face++) {
+                    /* a surface is in two blocks; whichever comes first
+                     * puts it back, and the second is then a no-op */
+                    if (f->surfs[face] != t->surfs[face]) {
+                        ship->set_surface(p, p + surface_index_to_normal(face),
+                                (surface_index)face, t->surfs[face]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+bool
+ship_space::undo()
+{
+    if (undo_steps.empty())
+        return false;
+
+    undo_step step;
+    std::swap(step, undo_steps.back());
+    undo_steps.pop_back();
+
+    begin_edit();
+    for (size_t i = 0; i < step.where.size(); i++) {
+        restore_blocks(this, step.where[i], step.after[i], step.before[i]);
+    }
+    commit();
+
+    redo_steps.push_back(undo_step());
+    std::swap(redo_steps.back(), step);
+    return true;
+}
+
+
+bool
+ship_space::redo()
+{
+    if (redo_steps.empty())
+        return false;
+
+    undo_step step;
+    std::swap(step, redo_steps.back());
+    redo_steps.pop_back();
+
+    begin_edit();
+    for (size_t i = 0; i < step.where.size(); i++) {
+        restore_blocks(this, step.where[i], step.before[i], step.after[i]);
+    }
+    commit();
 
-    update_topology_for_remove_surface(a, b);
+    undo_steps.push_back(undo_step());
+    std::swap(undo_steps.back(), step);
+    return true;
 }
@@ -1,12 +1,17 @@
 #pragma once
 
 #include <glm/glm.hpp> /* ivec3 */
+#include <assert.h>
+#include <stdint.h>
+#include <deque>
+#include <list>
 #include <set>
 #include <unordered_map>
 
 #include "block.h"
 #include "component/component_manager.h"
 #include "chunk.h"
+#include "chunk_directory.h"
 #include "wiring/wiring.h"
 #include "wiring/wiring_data.h"
 #include <unordered_set>
@@ -27,15 +32,80 @@ struct raycast_info {
     glm::ivec3 bl;          /* the block we hit */
     glm::ivec3 n;           /* the face normal we hit */
     glm::ivec3 p;           /* the block along the normal */
-    struct block *block;
+    struct block const *block;  /* to read; edits go through ship_space */
+    float t;                /* how far along the ray the face we hit is */
+};
+
+/* what a ray stops at (see ship_space::raycast): a block whose type is in
+ * block_types, given as 1 << block_type for each, or a surface with any of
+ * surface_bits -- surface_blocks_air and/or surface_blocks_light.
+ *
+ * a ray which can stop at empty blocks has to look at every block it
+ * passes; otherwise it skips whole chunks where there is nothing to stop
+ * it.
+ */
+struct ray_filter {
+    unsigned block_types;
+    unsigned surface_bits;
+};
+
+/* one of a batch of rays; see ship_space::raycast_many */
+struct ray {
+    glm::vec3 o, d;
+    float max_dist;
 };
 
 struct zone_info {
     float air_amount;
+    topo_info *root;        /* the root of the space the zone is the air of */
+
+    zone_info(float air_amount, topo_info *root) : air_amount(air_amount), root(root) {}
+};
 
-    zone_info(float air_amount) : air_amount(air_amount) {}
+/* which spaces touch across open doors and vents (see
+ * ship_space::open_doors), and through how many of each: a node for each
+ * of those spaces -- the outside is always node 0 -- and a link for each
+ * pair of them, kept as parallel arrays so that ship_space::mix_air() can
+ * work through them in straight passes.
+ *
+ * doors opening and closing, and vents coming and going, update it as
+ * they happen. anything which changes the spaces themselves marks it
+ * stale instead, and the next mix_air() finds it all again.
+ */
+struct air_links {
+    std::vector<topo_info *> spaces;                    /* per node: the root */
+    std::unordered_map<topo_info *, unsigned> node_of;
+
+    std::vector<unsigned> a, b;                         /* per link: its nodes, a < b */
+    std::vector<unsigned short> doors, vents;           /* and how many of each join them */
+    std::unordered_map<uint64_t, unsigned> link_of;     /* a << 32 | b */
+
+    bool stale;         /* the spaces have changed since it was built */
+    bool dirty;         /* the links have changed since the rates were worked out */
+
+    /* for mix_air() */
+    std::vector<float> air, inv_volume, pressure;       /* per node */
+    std::vector<float> rate, flow;                      /* per link */
+
+    air_links() : stale(true), dirty(false) {}
 };
 
+/* one change to the blocks, as recorded in the edit journal (see
+ * ship_space::subscribe). a surface is shared by two blocks; it is recorded
+ * once, from the side it was edited from.
+ */
+struct block_delta {
+    glm::ivec3 p;               /* the block changed */
+    int face;                   /* the surface changed (see surface_index), or -1 for the block type */
+    unsigned char old_value;    /* block_type or surface_type, before */
+    unsigned char new_value;    /* and after */
+};
+
+struct ship_snapshot;
+struct blob;
+struct chunk_store;
+struct thread_pool;
+
 struct ship_space {
     /* the min and max chunk co-ords ship_space has seen for each axis
      * this is for iteration (min_x..max_x) (inclusive)
@@ -46,8 +116,52 @@ struct ship_space {
     glm::ivec3 mins;
     glm::ivec3 maxs;
 
-    std::unordered_map<glm::ivec3, chunk*, ivec3_hash> chunks;
-    std::unordered_map<topo_info *, zone_info *> zones;
+    chunk_directory chunks;
+
+    /* the air in each space which has any, indexed by the zone of the
+     * space's root (see topo_info). the ids stay dense: removing a zone
+     * moves the last one into its place, so a zone_info * or id is only
+     * good until the next edit or rebuild */
+    std::vector<zone_info> zones;
+
+    /* implicit chunks
+     *
+     * a missing chunk strictly inside mins..maxs may be enclosed by the
+     * ship, so it can't just be taken as vacuum. rather than allocating
+     * all of them, they stay out of the chunk directory and are read as
+     * implicit_chunk, which is all empty space and is never written to.
+     * ensure_chunk() materialises one when it is written.
+     *
+     * an implicit chunk is all one space, so it needs just one topo node,
+     * kept in implicit_topo. a missing node means the chunk is connected
+     * to the outside; rebuild_topology() only keeps nodes where that isn't
+     * so.
+     */
+    static chunk implicit_chunk;
+    std::unordered_map<glm::ivec3, topo_info, ivec3_hash> implicit_topo;
+
+    bool is_implicit_chunk(glm::ivec3 ch) const
+    {
+        return ch.x > mins.x && ch.x < maxs.x &&
+               ch.y > mins.y && ch.y < maxs.y &&
+               ch.z > mins.z && ch.z < maxs.z &&
+               !chunks.get(ch);
+    }
+
+    /* the chunk at chunk co-ords ch for reading: the real chunk, paged in
+     * if need be, or implicit_chunk, or null if there is nothing there at
+     * all */
+    chunk * get_chunk_for_read(glm::ivec3 ch)
+    {
+        chunk *c = chunks.get(ch);
+        if (!c)
+            return is_implicit_chunk(ch) ? &implicit_chunk : nullptr;
+        ensure_resident(ch, c);
+        return c;
+    }
+
+    /* the topo node for the implicit chunk at chunk co-ords ch */
+    topo_info * get_implicit_topo_info(glm::ivec3 ch);
 
     std::vector<wire_attachment> wire_attachments[num_wire_types];
     std::vector<wire_segment> wire_segments[num_wire_types];
@@ -60,9 +174,18 @@ struct ship_space {
     std::unordered_map<unsigned, power_wiring_data> power_wires;
     std::unordered_map<unsigned, comms_wiring_data> comms_wires;
 
+    /* the mapped ship file this ship was loaded from, if any (see
+     * ship_file.h). unwritten chunks read their blocks straight out of it,
+     * so it lives as long as the ship */
+    blob *backing;
+
     /* create an empty ship_space */
     ship_space();
 
+    /* releases the chunks and zones. the chunks' render and physics state
+     * is not touched; tear that down first if it was ever built */
+    ~ship_space();
+
     /* returns a block or null
      * finds the block at the position (x,y,z) within
      * the whole ship_space
@@ -70,6 +193,11 @@ struct ship_space {
      */
     block * get_block(glm::ivec3 block);
 
+    /* the same, to read only: a uniform chunk isn't expanded, a shared one
+     * isn't unshared and the masks stay good. use this unless the block
+     * is to be written */
+    block const * peek_block(glm::ivec3 block);
+
     topo_info * get_topo_info(glm::ivec3 block);
 
     /* returns the chunk containing the block denotated by (x, y, z)
@@ -78,10 +206,23 @@ struct ship_space {
     chunk * get_chunk_containing(glm::ivec3 block);
 
     /* returns the chunk corresponding to the chunk coordinates (x, y, z)
+     * or null; implicit chunks are null here (see above). a paged-out
+     * chunk is paged back in.
      * note this is NOT using block coordinates
      */
     chunk * get_chunk(glm::ivec3 chunk);
 
+    /* the chunks across each face of the chunk at chunk co-ords ch, as
+     * chunk::build_mesh wants them: null where there is none or it is
+     * paged out. nothing is paged in */
+    void get_mesh_neighbours(glm::ivec3 ch, chunk const **out) const;
+
+    /* bring each chunk's sealed mask up to date with its masks, across the
+     * whole ship, and mark the meshes of the chunks whose sealing changed,
+     * and their neighbours', as needing rebuilding. call before meshing.
+     * nothing is paged in */
+    void update_seals();
+
     /* returns a pointer to a new ship space
      * this ship space will have 2 x 2 rooms and will be 1 room tall
      * each room will have a floor and 4 walls of scaffolding
@@ -93,8 +234,29 @@ struct ship_space {
      */
     static ship_space * mock_ship_space(void);
 
+    /* the player's reach: from o along d, as far as the first block which
+     * isn't like the one o is in -- empty or not -- within MAX_PLAYER_REACH */
     void raycast(glm::vec3 o, glm::vec3 d, raycast_info *rc);
 
+    /* from o along d, up to max_dist blocks, as far as the first block or
+     * surface which the filter stops at. for a surface, the hit block is
+     * the one across it. the block o is in is never a hit.
+     *
+     * only the chunks' masks are looked at on the way, so paged-out chunks
+     * it passes through stay that way, unless the filter picks between
+     * types of non-empty block. the block hit is fetched for real.
+     */
+    void raycast(glm::vec3 o, glm::vec3 d, float max_dist,
+                 ray_filter const &filter, raycast_info *rc);
+
+    /* raycast() for each of n rays, all with the same filter, into the hit
+     * of the same index; the hits are just as raycast() would give them.
+     * where there is SSE2, the rays are walked four at a time in lock-step,
+     * in the order given -- so rays from the same place are best passed
+     * together */
+    void raycast_many(ray const *rays, raycast_info *hits, size_t n,
+                      ray_filter const &filter);
+
     /* ensure that the specified block_{x,y,z} can be fetched with a get_block
      *
      * this will instantiate a new containing chunk if necessary
@@ -103,31 +265,379 @@ struct ship_space {
 
     /* ensure that the specified chunk exists
      *
-     * this will instantiate a new chunk if necessary
+     * this will instantiate a new chunk if necessary, materialising
+     * it if it was implicit
      */
     chunk * ensure_chunk(glm::ivec3 chunk);
 
-    zone_info *get_zone_info(topo_info *t);
-    void insert_zone(topo_info *t, zone_info *z);
+    /* the zone of the space with root t, or null if it has no air */
+    zone_info *get_zone_info(topo_info *t)
+    {
+        return t->zone >= 0 ? &zones[t->zone] : nullptr;
+    }
 
-    /* topo info for open vacuum, so we know what pressure to force to zero */
+    /* the zone of the space the block is in, or null; without paging
+     * anything in */
+    zone_info *get_zone_info_at(glm::ivec3 block);
+
+    /* add air_amount of air to the space with root t, giving it a zone if
+     * it has none. returns the zone, or null for the outside, which never
+     * holds any air */
+    zone_info *insert_zone(topo_info *t, float air_amount);
+
+    /* take the zone away from the space with root t, if it has one.
+     * returns the air it had */
+    float remove_zone(topo_info *t);
+
+    /* the open doors (surface_door_open) and vents (surface_vent), which
+     * let air between the spaces either side of them: keyed by the block
+     * on the low side, with bit i set for one on its face 2 * i (x+, y+,
+     * z+). a door opening pools the air of the two spaces it is between;
+     * closing it leaves each with what it has. either way the spaces stay
+     * as they are, so there is nothing to merge or split.
+     *
+     * once a tick, mix_air() moves air along each link between spaces
+     * (see air_links), in proportion to the difference in pressure, and
+     * how many doors and vents there are between them. an open door on
+     * its own evens out the spaces either side in a tick; a vent takes
+     * much longer. rebuild_topology() finds them all again */
+    typedef std::unordered_map<glm::ivec3, unsigned char, ivec3_hash> face_map;
+    face_map open_doors;
+    face_map vents;
+    air_links links;
+    void mix_air();
+
+    /* topo info for open vacuum, so we know what pressure to force to zero.
+     * it is always the root of its space.
+     *
+     * the topology has two levels. within a chunk, the blocks air can get
+     * between without leaving it make up a group (see chunk_group), with
+     * portals to the groups of the neighbouring chunks. across the ship,
+     * the spaces are a union-find over the group nodes, the implicit
+     * chunks' nodes and this one.
+     *
+     * every other node points straight at the root of its space (or is
+     * it): rebuild_topology() leaves them that way, and joining or
+     * splitting spaces relabels the nodes of the smaller one. so a surface
+     * going in or out means working out the groups of its chunk again,
+     * and walking the portals from the groups either side of it -- never
+     * the whole ship */
     topo_info outside_topo_info;
     void rebuild_topology();
+
+    /* spread rebuild_topology() across threads threads, counting the
+     * caller; 1 (or 0) does it all on the caller, which is the default */
+    void set_worker_threads(unsigned threads);
+    thread_pool *workers;       /* null if there is only the caller */
+
+    /* bring the topology up to date after the surface between a and b was
+     * removed (or made air-permeable) / added. set_surface and remove_surface
+     * call these; only use them directly if you changed the surfaces yourself.
+     * within a transaction, splits are deferred to commit() */
     void update_topology_for_remove_surface(glm::ivec3 a, glm::ivec3 b);
     void update_topology_for_add_surface(glm::ivec3 a, glm::ivec3 b, int face);
 
     int num_full_rebuilds;      /* number of full rebuilds (pretty slow) performed */
     int num_fast_unifys;        /* number of incremental unify operations performed */
-    int num_fast_nosplits;      /* number of rebuilds avoided because we proved them spurious */
-    int num_false_splits;       /* number of useless rebuilds taken */
+    int num_fast_nosplits;      /* number of new surfaces proved not to split by a one-block detour */
+    int num_bounded_nosplits;   /* ... proved not to split by a search within nosplit_radius of them */
+    int num_bounded_misses;     /* ... which that search proved nothing about */
+    int num_bounded_visits;     /* blocks those searches visited, between them */
+    int num_local_nosplits;     /* ... proved not to split by walking the air around them */
+    int num_local_splits;       /* ... which did split, the smaller side being relabelled */
+    int num_chunk_solves;       /* number of times one chunk's groups were worked out again */
+
+    /* how far, in blocks along any axis, to search around a new surface
+     * for a way past it before working its chunks' groups out again (see
+     * flush_pending_splits). the search never leaves the chunks either side
+     * of the surface, so CHUNK_SIZE covers them; 0 turns it off */
+    int nosplit_radius;
 
     bool validate();
 
+    /* collapse every chunk whose blocks are all identical to the uniform
+     * representation (see chunk_blocks). invalidates block pointers.
+     * returns the number of uniform chunks; paged-out chunks are left
+     * alone, and not counted.
+     */
+    unsigned compact_chunks();
+
+    /* bytes of block storage in use across all chunks; paged-out chunks
+     * use none */
+    size_t block_memory_used();
+
     void set_surface(glm::ivec3 a, glm::ivec3 b, surface_index index,
         surface_type st);
     void remove_surface(glm::ivec3 a, glm::ivec3 b, surface_index index);
+    void set_block_type(glm::ivec3 block, block_type type);
+
+    /* edit transactions
+     *
+     * the edits above are applied to the blocks immediately, but the atmo
+     * topology is brought up to date, and the edits published to the
+     * journal, once, at the outermost commit(). so a batch of edits costs at
+     * most one full topology rebuild, rather than one per surface. outside
+     * of a transaction, each edit is its own transaction.
+     *
+     * the result is the same as making the edits one at a time.
+     * transactions nest.
+     */
+    void begin_edit();
+    void commit();
+
+    /* the edit journal
+     *
+     * every committed change to a block's type or surfaces, in order. the
+     * state derived from the blocks which ship_space does not own -- the
+     * chunk meshes and static physics, the lightfield -- is kept up to date
+     * by subscribing, and consuming the changes once per tick, so a tick's
+     * worth of edits can be coalesced into one update.
+     *
+     * the journal only holds what some subscriber has yet to consume; with
+     * no subscribers nothing is kept.
+     */
+
+    /* returns a new subscriber, which will see every change committed from
+     * now on */
+    unsigned subscribe();
+    void unsubscribe(unsigned sub);
+
+    /* calls f(block_delta const &) for each committed change sub has not
+     * yet seen, oldest first */
+    template<typename F>
+    void consume(unsigned sub, F f)
+    {
+        assert(sub < journal_readers.size() && journal_readers[sub] != no_reader);
+
+        for (size_t i = journal_readers[sub]; i < journal_committed; i++) {
+            f(journal[i]);
+        }
+
+        journal_readers[sub] = journal_committed;
+        trim_journal();
+    }
+
+    /* returns an immutable copy of the blocks as they are now (see
+     * ship_snapshot), which the caller owns. O(chunks): the snapshot shares
+     * each chunk's blocks until the chunk is next written. invalidates
+     * block pointers, as chunk_blocks copies do, and pages every chunk
+     * in */
+    ship_snapshot * snapshot();
+
+    /* undo
+     *
+     * a transaction opened with begin_undoable_edit() rather than
+     * begin_edit() is one undo step. undo() and redo() put back the block
+     * types and surfaces that step changed, as ordinary edits, so the
+     * topology and the journal follow along. the step keeps copies of the
+     * chunks it changed from before and after it, so this costs
+     * O(changed chunks), not O(ship). entities are not part of it.
+     *
+     * undo() and redo() return false if there is nothing to undo/redo.
+     * a new undo step forgets anything which could have been redone.
+     */
+    void begin_undoable_edit();
+    bool undo();
+    bool redo();
+
+    struct undo_step {
+        std::vector<glm::ivec3> where;      /* chunk co-ords */
+        std::vector<chunk_blocks> before;
+        std::vector<chunk_blocks> after;
+    };
+
+    static const unsigned max_undo_steps = 64;
+    std::deque<undo_step> undo_steps;
+    std::vector<undo_step> redo_steps;
+    bool recording_undo;                    /* the current transaction is undoable */
+    undo_step recording;
+
+    /* keep the chunk containing block as it is now in the undo step being
+     * recorded; must be called before the chunk is written */
+    void save_for_undo(glm::ivec3 block);
+
+    /* chunk residency
+     *
+     * once streaming is enabled, only the blocks of the chunks near the
+     * centers passed to update_residency() -- the player, and whatever else
+     * is being simulated -- and the max_resident most recently used chunks
+     * beyond them are kept in memory. the rest are paged out to a
+     * chunk_store, and their render and physics state torn down via
+     * on_page_out. chunks coming near a center again are read back on the
+     * store's loader thread, a frame or so ahead of being needed; a chunk
+     * which is used before then -- get_chunk(), a block_cursor stepping
+     * into it, ... -- is read back there and then.
+     *
+     * only the blocks go: each chunk's topo, entities and zones stay, as
+     * the atmosphere is simulated across the whole ship. code which walks
+     * the chunk directory itself must ensure_resident() a chunk before
+     * reading its blocks.
+     *
+     * streaming can't be turned off again.
+     */
+    void enable_streaming(char const *store_filename, unsigned max_resident);
+
+    /* once per frame, outside of any transaction: collect the chunks the
+     * loader has finished, ask for those within radius chunks of each of
+     * centers (block co-ords), and page out the least recently used beyond
+     * max_resident. chunks near a center are never paged out, even if there
+     * are more than max_resident of them */
+    void update_residency(glm::ivec3 const *centers, unsigned num_centers, int radius);
+
+    void ensure_resident(glm::ivec3 ch, chunk *c)
+    {
+        if (!c->resident)
+            page_in(ch, c);
+    }
+
+    chunk_store *store;                 /* null until streaming is enabled */
+    unsigned max_resident;
+    unsigned num_resident;
+    unsigned residency_frame;           /* update_residency() calls so far */
+    std::list<glm::ivec3> lru;          /* resident chunks, most recently used first */
+
+    /* called as c is paged out, to tear down what was built from its
+     * blocks. it will be prepared again as usual once it is back */
+    void (*on_page_out)(chunk *c);
+
+    void page_in(glm::ivec3 ch, chunk *c);
+    void page_out(glm::ivec3 ch, chunk *c);
+    void make_resident(glm::ivec3 ch, chunk *c);
+
+    /* a surface which may have split a zone, to be checked at commit */
+    struct pending_split {
+        glm::ivec3 a, b;
+        int face;
+    };
+
+    int edit_depth;
+    std::vector<pending_split> pending_splits;
+
+    static const size_t no_reader = (size_t)-1;
+    std::vector<block_delta> journal;
+    size_t journal_committed;               /* journal[0..journal_committed) are visible */
+    std::vector<size_t> journal_readers;    /* next index for each subscriber, or no_reader */
+
+    void record(block_delta const &d);
+    void trim_journal();
+    void write_surface(glm::ivec3 a, glm::ivec3 b, surface_index index, surface_type st);
+    void flush_pending_splits();
 };
 
+/* an immutable copy of the blocks of a ship_space, as they were when
+ * ship_space::snapshot() was called. it can be read from another thread
+ * while the ship goes on being edited, but must be deleted on the thread
+ * which edits the ship (see dense_blocks), and before the ship itself.
+ */
+struct ship_snapshot {
+    glm::ivec3 mins;
+    glm::ivec3 maxs;
+    std::unordered_map<glm::ivec3, chunk_blocks, ivec3_hash> chunks;
+
+    /* the block at block co-ords p, or null if there was no chunk there.
+     * implicit chunks read as empty space, as they do in the ship */
+    block const * get_block(glm::ivec3 p) const;
+};
+
+/* a position within a ship_space which remembers the chunk it is in
+ *
+ * stepping to a neighbouring block only touches the chunk directory when
+ * the step crosses a chunk boundary; within a chunk it is just an offset
+ * update. this is what the neighbour walks in the topology, raycast and
+ * lighting passes should use rather than repeated get_block() calls.
+ */
+struct block_cursor {
+    ship_space *ship;
+    glm::ivec3 pos;         /* block co-ords within the ship */
+    glm::ivec3 ch_pos;      /* chunk co-ords of the containing chunk */
+    glm::ivec3 off;         /* block co-ords within the containing chunk */
+    chunk *ch;              /* containing chunk (maybe ship_space::implicit_chunk), or null */
+    bool masks_only;        /* chunks aren't paged in, so only the masks may be read */
+
+    /* a cursor at block co-ords block. a masks_only cursor never pages a
+     * chunk in, so is only good for occupied() and blocks_light(), which
+     * read masks that stay in memory while a chunk is paged out */
+    block_cursor(ship_space *ship, glm::ivec3 block, bool masks_only = false);
+
+    /* a cursor at offset off within the chunk ch, which is at chunk co-ords ch_pos.
+     * for walks which already know their chunk; no lookup is done */
+    block_cursor(ship_space *ship, glm::ivec3 ch_pos, chunk *ch, glm::ivec3 off);
+
+    /* reposition anywhere in the ship; always does a chunk lookup */
+    void move_to(glm::ivec3 block);
+
+    /* step one block across the given face (see surface_index) */
+    void step(int face)
+    {
+        int axis = face >> 1;
+        int dir = (face & 1) ? -1 : 1;
+
+        pos[axis] += dir;
+        off[axis] += dir;
+
+        if ((unsigned)off[axis] >= CHUNK_SIZE) {
+            off[axis] -= dir * CHUNK_SIZE;
+            ch_pos[axis] += dir;
+            ch = find_chunk();
+        }
+    }
+
+    /* a cursor for the block across the given face */
+    block_cursor neighbour(int face) const
+    {
+        block_cursor n = *this;
+        n.step(face);
+        return n;
+    }
+
+    /* the block at the cursor, or null if there is no chunk here.
+     * this is writable access, so expands a uniform chunk; see peek().
+     * implicit chunks can't be written, so are null here too */
+    block * get() const
+    {
+        if (!ch || ch == &ship_space::implicit_chunk)
+            return nullptr;
+
+        ch->masks_stale = true;
+        return ch->blocks.get(off.x, off.y, off.z);
+    }
+
+    /* read-only access to the block at the cursor, or null */
+    block const * peek() const
+    {
+        return ch ? ch->blocks.peek(off.x, off.y, off.z) : nullptr;
+    }
+
+    /* whether the block at the cursor isn't empty, and whether its face
+     * blocks light, from the chunk's masks; cheaper than peek(). there is
+     * nothing where there is no chunk */
+    bool occupied() const
+    {
+        return ch && ch->occupied.test(off.x, off.y, off.z);
+    }
+
+    bool blocks_light(int face) const
+    {
+        return ch && ch->blocks_light[face].test(off.x, off.y, off.z);
+    }
+
+    /* the topo_info at the cursor; open space outside the ship is
+     * the outside node, as for ship_space::get_topo_info() */
+    topo_info * topo() const
+    {
+        if (!ch)
+            return &ship->outside_topo_info;
+        if (ch == &ship_space::implicit_chunk)
+            return ship->get_implicit_topo_info(ch_pos);
+        return ch->topo(off.x, off.y, off.z);
+    }
+
+private:
+    /* the chunk at ch_pos, as ch should hold it */
+    chunk * find_chunk() const;
+};
+
+
 /* helper */
 topo_info *
 topo_find(topo_info *p);
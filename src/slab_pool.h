@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef _WIN32
+#include <err.h> /* errx */
+#else
+#include "winerr.h"
+#endif
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <type_traits>
+#include <vector>
+
+/* allocation counters for a slab_pool */
+struct slab_pool_stats {
+    unsigned slabs;         /* slabs reserved from the heap */
+    unsigned live;          /* objects currently allocated */
+    unsigned peak;          /* high water mark of live */
+    size_t allocs;          /* total allocations served */
+    size_t frees;           /* total frees */
+    size_t reserved_bytes;  /* bytes held in slabs */
+};
+
+/* a slab allocator for fixed-size objects of type T
+ *
+ * storage is reserved from the heap PerSlab objects at a time, so objects
+ * allocated together sit together in memory. freed slots go onto a free
+ * list and are handed out again (most recently freed first) before any
+ * new slab is reserved. slabs are only returned to the heap when the pool
+ * itself is destroyed.
+ *
+ * the pool hands out raw, uninitialized storage -- construct with
+ * placement new, and destroy explicitly before calling free().
+ *
+ * not thread safe.
+ */
+template<typename T, unsigned PerSlab>
+struct slab_pool {
+    union slot {
+        slot *next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    std::vector<slot *> slabs;
+    slot *free_list;
+    slab_pool_stats stats;
+
+    slab_pool()
+        : free_list(nullptr)
+    {
+        stats.slabs = 0;
+        stats.live = 0;
+        stats.peak = 0;
+        stats.allocs = 0;
+        stats.frees = 0;
+        stats.reserved_bytes = 0;
+    }
+
+    ~slab_pool()
+    {
+        for (auto s : slabs) {
+            ::free(s);
+        }
+    }
+
+    slab_pool(slab_pool const &) = delete;
+    slab_pool & operator=(slab_pool const &) = delete;
+
+    void * alloc()
+    {
+        if (!free_list) {
+            add_slab();
+        }
+
+        slot *s = free_list;
+        free_list = s->next;
+
+        stats.allocs++;
+        stats.live++;
+        if (stats.live > stats.peak)
+            stats.peak = stats.live;
+
+        return s;
+    }
+
+    void free(void *p)
+    {
+        if (!p)
+            return;
+
+        slot *s = (slot *)p;
+        s->next = free_list;
+        free_list = s;
+
+        stats.frees++;
+        stats.live--;
+    }
+
+private:
+    void add_slab()
+    {
+        slot *slab = (slot *)malloc(sizeof(slot) * PerSlab);
+        if (!slab) {
+            errx(1, "slab_pool: failed to reserve a slab of %u objects", PerSlab);
+        }
+
+        /* thread the new slots onto the free list in address order */
+        for (unsigned i = 0; i < PerSlab; i++) {
+            slab[i].next = (i + 1 < PerSlab) ? &slab[i + 1] : free_list;
+        }
+
+        free_list = slab;
+        slabs.push_back(slab);
+
+        stats.slabs++;
+        stats.reserved_bytes += sizeof(slot) * PerSlab;
+    }
+};
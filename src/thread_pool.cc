@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+
+thread_pool::thread_pool(unsigned threads)
+    : generation(0), busy(0), stopping(false), job(nullptr), count(0), grain(1), next(0)
+{
+    for (unsigned i = 1; i < threads; i++) {
+        workers.push_back(std::thread(&thread_pool::run_worker, this));
+    }
+}
+
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &w : workers) {
+        w.join();
+    }
+}
+
+
+void
+thread_pool::take_ranges()
+{
+    for (;;) {
+        size_t begin = next.fetch_add(grain);
+        if (begin >= count)
+            return;
+
+        (*job)(begin, std::min(count, begin + grain));
+    }
+}
+
+
+void
+thread_pool::run(size_t n, size_t grain, std::function<void(size_t, size_t)> const &f)
+{
+    {
+        std::lock_guard<std::mutex> l(lock);
+        job = &f;
+        count = n;
+        this->grain = grain;
+        next = 0;
+        busy = (unsigned)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    take_ranges();
+
+    std::unique_lock<std::mutex> l(lock);
+    done.wait(l, [this] { return busy == 0; });
+    job = nullptr;
+}
+
+
+void
+thread_pool::run_worker()
+{
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> l(lock);
+
+    for (;;) {
+        wake.wait(l, [this, seen] { return stopping || generation != seen; });
+        if (stopping)
+            return;
+
+        seen = generation;
+        l.unlock();
+
+        take_ranges();
+
+        l.lock();
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
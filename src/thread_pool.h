@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stddef.h>
+#include <thread>
+#include <vector>
+
+/* a fixed set of threads which loops can be split across (see
+ * parallel_for). the thread which runs a loop works on it too, so a pool
+ * of n threads starts n - 1 of its own.
+ *
+ * one loop at a time: a pool must only be used from one thread, and not
+ * from within one of its own loops.
+ */
+struct thread_pool {
+    explicit thread_pool(unsigned threads);
+    ~thread_pool();
+
+    /* threads a loop is split across, counting the caller */
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    /* call f(begin, end) for ranges of at most grain covering [0, n),
+     * spread across the threads; returns once every range is done */
+    void run(size_t n, size_t grain, std::function<void(size_t, size_t)> const &f);
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned generation;        /* loops started; under lock */
+    unsigned busy;              /* workers yet to finish this loop; under lock */
+    bool stopping;              /* under lock */
+
+    /* the current loop. set under lock before generation moves on, and
+     * left alone until every worker is done with it */
+    std::function<void(size_t, size_t)> const *job;
+    size_t count, grain;
+    std::atomic<size_t> next;
+
+    void run_worker();
+    void take_ranges();
+};
+
+/* call f(begin, end) over [0, n) in ranges of at most grain: across pool,
+ * or all at once on this thread if pool is null or there is only one
+ * range. f must be safe to call from several threads at once */
+template<typename F>
+static inline void
+parallel_for(thread_pool *pool, size_t n, size_t grain, F f)
+{
+    if (!pool || n <= grain) {
+        if (n)
+            f(0, n);
+        return;
+    }
+
+    pool->run(n, grain, f);
+}
@@ -25,17 +25,11 @@ struct add_block_tool : tool
         if (!can_use(rc))
             return; /* n/a */
 
-        /* ensure we can access this x,y,z */
-        ship->ensure_block(rc->p);
-
-        block *bl = ship->get_block(rc->p);
-
         /* can only build on the side of an existing scaffold */
-        if (bl && rc->block->type == block_support) {
-            bl->type = block_support;
-            /* dirty the chunk */
-            ship->get_chunk_containing(rc->p)->render_chunk.valid = false;
-            mark_lightfield_update(rc->p);
+        if (rc->block->type == block_support) {
+            ship->begin_undoable_edit();
+            ship->set_block_type(rc->p, block_support);
+            ship->commit();
         }
     }
 
@@ -50,7 +44,7 @@ struct add_block_tool : tool
         if (!can_use(rc))
             return; /* n/a */
 
-        block *bl = ship->get_block(rc->p);
+        block const *bl = ship->peek_block(rc->p);
 
         /* can only build on the side of an existing scaffold */
         if ((!bl || bl->type == block_empty) && rc->block->type == block_support) {
@@ -19,7 +19,7 @@ extern void
 remove_ents_from_surface(glm::ivec3 p, int face);
 
 bool
-add_surface_tool::can_use(block *bl, block *other, int index) {
+add_surface_tool::can_use(block const *bl, block const *other, int index) {
     if (bl && bl->surfs[index] != surface_none) return false; /* already a surface here */
     return (bl && bl->type == block_support) || (other && other->type == block_support);
 }
@@ -29,16 +29,15 @@ add_surface_tool::use(raycast_info *rc) {
     if (!rc->hit)
         return;
 
-    block *bl = rc->block;
+    block const *bl = rc->block;
 
     int index = normal_to_surface_index(rc);
-    block *other_side = ship->get_block(rc->p);
+    block const *other_side = ship->peek_block(rc->p);
 
     if (can_use(bl, other_side, index)) {
+        ship->begin_undoable_edit();
         ship->set_surface(rc->bl, rc->p, (surface_index)index, st);
-
-        mark_lightfield_update(rc->bl);
-        mark_lightfield_update(rc->p);
+        ship->commit();
     }
 }
 
@@ -61,6 +60,9 @@ add_surface_tool::cycle_mode() {
         st = surface_glass;
         break;
     case surface_glass:
+        st = surface_vent;
+        break;
+    case surface_vent:
         st = surface_wall;
         break;
     default:
@@ -75,9 +77,9 @@ add_surface_tool::preview(raycast_info *rc, frame_data *frame) {
     if (!rc->hit)
         return;
 
-    block *bl = ship->get_block(rc->bl);
+    block const *bl = ship->peek_block(rc->bl);
     int index = normal_to_surface_index(rc);
-    block *other_side = ship->get_block(rc->p);
+    block const *other_side = ship->peek_block(rc->p);
 
     if (can_use(bl, other_side, index)) {
         auto mat = frame->alloc_aligned<glm::mat4>(1);
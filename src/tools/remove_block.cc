@@ -29,11 +29,12 @@ struct remove_block_tool : tool
         if (!can_use(rc))
             return;
 
-        block *bl = rc->block;
+        /* a copy: the edits below may move the block */
+        block const bl = *rc->block;
 
         /* if there was a block entity here, find and remove it. block
          * ents are "attached" to the zm surface */
-        if (bl->type == block_entity) {
+        if (bl.type == block_entity) {
             /* TODO: should this even allow entity removal? This may be nothing more than
              * historical accident.
              */
@@ -42,17 +43,21 @@ struct remove_block_tool : tool
             return;
         }
 
+        /* the block and any surfaces it leaves unsupported go as one edit,
+         * and are undone together */
+        ship->begin_undoable_edit();
+
         /* block removal */
-        bl->type = block_empty;
+        ship->set_block_type(rc->bl, block_empty);
 
         /* strip any orphaned surfaces */
         for (int index = 0; index < 6; index++) {
-            if (bl->surfs[index]) {
+            if (bl.surfs[index]) {
 
                 auto s = surface_index_to_normal(index);
 
                 auto r = rc->bl + s;
-                block *other_side = ship->get_block(r);
+                block const *other_side = ship->peek_block(r);
 
                 if (!other_side) {
                     /* expand: but this should always exist. */
@@ -60,24 +65,16 @@ struct remove_block_tool : tool
                 else if (other_side->type != block_support) {
                     /* if the other side has no scaffold, then there is nothing left to support this
                      * surface pair -- remove it */
-                    bl->surfs[index] = surface_none;
-                    other_side->surfs[index ^ 1] = surface_none;
-                    ship->get_chunk_containing(r)->render_chunk.valid = false;
+                    ship->remove_surface(rc->bl, r, (surface_index)index);
 
                     /* pop any dependent ents */
                     remove_ents_from_surface(rc->bl, index);
                     remove_ents_from_surface(r, index ^ 1);
-
-                    mark_lightfield_update(r);
-
-                    ship->update_topology_for_remove_surface(rc->bl, r);
                 }
             }
         }
 
-        /* dirty the chunk */
-        ship->get_chunk_containing(rc->bl)->render_chunk.valid = false;
-        mark_lightfield_update(rc->bl);
+        ship->commit();
     }
 
     void alt_use(raycast_info *rc) override {}
@@ -91,7 +88,7 @@ struct remove_block_tool : tool
         if (!can_use(rc))
             return;
 
-        block *bl = rc->block;
+        block const *bl = rc->block;
         if (bl->type != block_empty) {
             auto mat = frame->alloc_aligned<glm::mat4>(1);
             *mat.ptr = mat_position(rc->bl);
@@ -26,7 +26,7 @@ struct remove_surface_tool : tool
         if (!rc->hit)
             return false;
 
-        block *bl = rc->block;
+        block const *bl = rc->block;
         int index = normal_to_surface_index(rc);
         return bl && bl->surfs[index] != surface_none;
     }
@@ -38,14 +38,13 @@ struct remove_surface_tool : tool
 
         int index = normal_to_surface_index(rc);
 
+        ship->begin_undoable_edit();
         ship->remove_surface(rc->bl, rc->p, (surface_index)index);
+        ship->commit();
 
         /* remove any ents using the surface */
         remove_ents_from_surface(rc->p, index ^ 1);
         remove_ents_from_surface(rc->bl, index);
-
-        mark_lightfield_update(rc->bl);
-        mark_lightfield_update(rc->p);
     }
 
     void alt_use(raycast_info *rc) override {}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <assert.h>
+#include "../src/chunk_directory.h"
+
+/* the directory never dereferences what it stores */
+static chunk *
+fake(int i)
+{
+    return (chunk *)(size_t)(i * 64);
+}
+
+void
+grow(void)
+{
+    chunk_directory dir;
+
+    assert(dir.get(glm::ivec3(0, 0, 0)) == 0);
+    assert(dir.size() == 0);
+
+    dir.set(glm::ivec3(0, 0, 0), fake(1));
+    assert(dir.get(glm::ivec3(0, 0, 0)) == fake(1));
+    assert(dir.get(glm::ivec3(1, 0, 0)) == 0);
+    assert(dir.get(glm::ivec3(-1, 0, 0)) == 0);
+
+    /* growing in every direction must keep existing entries */
+    dir.set(glm::ivec3(3, 0, 0), fake(2));
+    dir.set(glm::ivec3(0, -5, 2), fake(3));
+    dir.set(glm::ivec3(-7, 4, -1), fake(4));
+
+    assert(dir.get(glm::ivec3(0, 0, 0)) == fake(1));
+    assert(dir.get(glm::ivec3(3, 0, 0)) == fake(2));
+    assert(dir.get(glm::ivec3(0, -5, 2)) == fake(3));
+    assert(dir.get(glm::ivec3(-7, 4, -1)) == fake(4));
+    assert(dir.get(glm::ivec3(1, 0, 0)) == 0);
+    assert(dir.size() == 4);
+
+    /* removal */
+    dir.set(glm::ivec3(3, 0, 0), 0);
+    assert(dir.get(glm::ivec3(3, 0, 0)) == 0);
+    assert(dir.size() == 3);
+}
+
+void
+iterate(void)
+{
+    chunk_directory dir;
+    int n = 0;
+
+    for (int i = 0; i < 10; i++) {
+        dir.set(glm::ivec3(i * 2, -i, i), fake(i + 1));
+    }
+
+    for (auto it = dir.begin(); it != dir.end(); ++it) {
+        assert(dir.get(it->first) == it->second);
+        n++;
+    }
+
+    assert(n == 10);
+}
+
+int
+main(void)
+{
+    grow();
+    iterate();
+}
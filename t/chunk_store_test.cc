@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <assert.h>
+#include <chrono>
+#include <thread>
+#include "../src/common.h"
+#include "../src/chunk_store.h"
+
+static char const *store_filename = "chunk_store_test.tmp";
+
+/* a line of chunks along x, each with a scaffold block and a wall at a
+ * spot which depends on the chunk, and one chunk left uniform */
+static ship_space *
+line_of_chunks(int n)
+{
+    ship_space *ship = new ship_space;
+    ship->begin_edit();
+
+    for (int i = 0; i < n; i++) {
+        glm::ivec3 p(CHUNK_SIZE * i + i % CHUNK_SIZE, 1, 2);
+        ship->ensure_chunk(glm::ivec3(i, 0, 0));
+        if (i == 3)
+            continue;
+
+        ship->set_block_type(p, block_support);
+        ship->set_surface(p, p + glm::ivec3(0, 0, 1), surface_zp, surface_wall);
+    }
+
+    ship->commit();
+    ship->rebuild_topology();
+    return ship;
+}
+
+static bool
+block_as_built(ship_space *ship, int i)
+{
+    glm::ivec3 p(CHUNK_SIZE * i + i % CHUNK_SIZE, 1, 2);
+    block const *b = ship->peek_block(p);
+
+    if (i == 3)
+        return b->type == block_empty && !b->surfs[surface_zp];
+    return b->type == block_support && b->surfs[surface_zp] == surface_wall;
+}
+
+static unsigned pages_out;
+
+static void
+count_page_out(chunk *)
+{
+    pages_out++;
+}
+
+void
+round_trip(void)
+{
+    chunk_blocks uniform;
+    uniform.uniform.type = block_support;
+
+    chunk_blocks dense;
+    dense.get(1, 2, 3)->type = block_support;
+    dense.get(4, 4, 4)->surfs[surface_xm] = surface_wall;
+
+    chunk_store *store = new chunk_store(store_filename);
+    store->write(glm::ivec3(0, 0, 0), uniform);
+    store->write(glm::ivec3(1, 0, 0), dense);
+
+    /* a uniform chunk comes back uniform */
+    chunk_blocks back;
+    store->read(glm::ivec3(0, 0, 0), &back);
+    assert(back.is_uniform());
+    assert(back.uniform.type == block_support);
+
+    store->read(glm::ivec3(1, 0, 0), &back);
+    assert(!back.is_uniform());
+    assert(!memcmp(&back.dense->cells, &dense.dense->cells, sizeof(dense.dense->cells)));
+
+    /* a chunk written again, which no longer fits, moves to the end; and
+     * stays put when it shrinks */
+    uint64_t size = store->file_size();
+    dense.get(7, 7, 7)->type = block_support;
+    store->write(glm::ivec3(1, 0, 0), dense);
+    assert(store->file_size() > size);
+
+    size = store->file_size();
+    store->write(glm::ivec3(1, 0, 0), uniform);
+    assert(store->file_size() == size);
+    store->read(glm::ivec3(1, 0, 0), &back);
+    assert(back.is_uniform());
+
+    /* the loader hands back what was asked for, generation and all */
+    store->request(glm::ivec3(0, 0, 0), 7);
+    chunk_store::loaded l;
+    while (!store->take(&l)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert(l.ch == glm::ivec3(0, 0, 0));
+    assert(l.generation == 7);
+    chunk_store::install(l, &back);
+    assert(back.is_uniform() && back.uniform.type == block_support);
+
+    delete store;
+
+    /* and the scratch file goes with the store */
+    assert(!fopen(store_filename, "rb"));
+}
+
+void
+residency(void)
+{
+    ship_space *ship = line_of_chunks(32);
+    ship->enable_streaming(store_filename, 8);
+    ship->on_page_out = count_page_out;
+    assert(ship->num_resident == 32);
+
+    /* everything but the 8 most recently used goes, and the ones around
+     * the center stay */
+    glm::ivec3 center(CHUNK_SIZE * 20, 0, 0);
+    ship->update_residency(&center, 1, 1);
+    assert(ship->num_resident == 8);
+    assert(pages_out == 24);
+    for (int i = 19; i <= 21; i++) {
+        assert(ship->chunks.get(glm::ivec3(i, 0, 0))->resident);
+    }
+
+    chunk *far = ship->chunks.get(glm::ivec3(0, 0, 0));
+    assert(!far->resident);
+    assert(far->blocks.is_uniform() && far->blocks.uniform.type == block_empty);
+    assert(!far->render_chunk.valid);
+
+    /* the topology stays behind, paged out or not, and so do the masks */
+    assert(topo_find(far->topo(1, 1, 1)) ==
+           topo_find(ship->chunks.get(glm::ivec3(20, 0, 0))->topo(1, 1, 1)));
+    assert(far->occupied.test(0, 1, 2));
+    assert(far->blocks_air[surface_zp].test(0, 1, 2));
+    assert(!far->resident);
+
+    /* which is all a masks-only cursor reads, so walking one over paged-out
+     * chunks leaves them on disk */
+    block_cursor cur(ship, glm::ivec3(0, 1, 2), true);
+    for (int x = 0; x < 3 * CHUNK_SIZE; x++, cur.step(surface_xp)) {
+        int i = x / CHUNK_SIZE;
+        assert(cur.blocks_light(surface_zp) == (x == CHUNK_SIZE * i + i % CHUNK_SIZE));
+    }
+    for (int i = 0; i < 3; i++) {
+        assert(!ship->chunks.get(glm::ivec3(i, 0, 0))->resident);
+    }
+    assert(ship->num_resident == 8);
+
+    /* reading a paged-out chunk brings it straight back */
+    for (int i = 0; i < 32; i++) {
+        assert(block_as_built(ship, i));
+    }
+    assert(ship->num_resident == 32);
+
+    /* and edits to it survive being paged out again */
+    ship->set_block_type(glm::ivec3(1, 1, 1), block_support);
+    ship->update_residency(&center, 1, 1);
+    assert(!far->resident);
+    assert(ship->peek_block(glm::ivec3(1, 1, 1))->type == block_support);
+    assert(far->resident);
+
+    /* moving the center fetches the chunks around it in the background */
+    ship->update_residency(&center, 1, 1);
+    assert(!ship->chunks.get(glm::ivec3(5, 0, 0))->resident);
+
+    center = glm::ivec3(CHUNK_SIZE * 5, 0, 0);
+    for (int tries = 0; tries < 1000; tries++) {
+        ship->update_residency(&center, 1, 1);
+        if (ship->chunks.get(glm::ivec3(4, 0, 0))->resident &&
+            ship->chunks.get(glm::ivec3(5, 0, 0))->resident &&
+            ship->chunks.get(glm::ivec3(6, 0, 0))->resident) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (int i = 4; i <= 6; i++) {
+        assert(ship->chunks.get(glm::ivec3(i, 0, 0))->resident);
+    }
+    assert(ship->num_resident <= 8);
+
+    for (int i = 0; i < 32; i++) {
+        assert(block_as_built(ship, i));
+    }
+    assert(ship->validate());
+
+    delete ship;
+}
+
+int
+main(void)
+{
+    round_trip();
+    residency();
+}
@@ -1,12 +1,402 @@
 #include <stdio.h>
 #include <assert.h>
 #include "../src/chunk.h"
+#include <vector>
 
 
 /* some light manual testing of block and grid
  */
+void
+uniform_storage(void)
+{
+    chunk_blocks blocks;
+
+    /* a fresh chunk is uniform empty space */
+    assert(blocks.is_uniform());
+    assert(blocks.peek(0, 0, 0)->type == block_empty);
+    assert(blocks.peek(0, 0, 0) == blocks.peek(7, 7, 7));
+
+    /* writable access expands, and keeps the uniform contents */
+    block *b = blocks.get(1, 2, 3);
+    assert(!blocks.is_uniform());
+    assert(b->type == block_empty);
+    b->type = block_support;
+    b->surfs[surface_xp] = surface_wall;
+
+    assert(blocks.peek(1, 2, 3)->type == block_support);
+    assert(blocks.peek(1, 2, 4)->type == block_empty);
+
+    /* not all the same, so cannot collapse */
+    assert(!blocks.compact());
+    assert(blocks.peek(1, 2, 3)->surfs[surface_xp] == surface_wall);
+
+    /* put it back, and it can */
+    b->type = block_empty;
+    b->surfs[surface_xp] = surface_none;
+    assert(blocks.compact());
+    assert(blocks.is_uniform());
+    assert(blocks.memory_used() < sizeof(block) * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+}
+
+void
+pooled(void)
+{
+    slab_pool_stats before = chunk_pool_stats();
+
+    chunk *a = new chunk();
+    chunk *b = new chunk();
+    a->blocks.expand();
+
+    assert(chunk_pool_stats().live == before.live + 2);
+    assert(chunk_blocks_pool_stats().live >= 1);
+
+    /* a dropped chunk's slot is reused by the next one */
+    delete b;
+    chunk *c = new chunk();
+    assert(c == b);
+
+    delete a;
+    delete c;
+    assert(chunk_pool_stats().live == before.live);
+}
+
+void
+copy_on_write(void)
+{
+    slab_pool_stats before = chunk_blocks_pool_stats();
+
+    chunk_blocks blocks;
+    blocks.get(1, 2, 3)->type = block_support;
+
+    /* a copy shares the full array */
+    chunk_blocks copy = blocks;
+    assert(copy.is_shared() && blocks.is_shared());
+    assert(copy.same_storage(blocks));
+    assert(copy.peek(1, 2, 3) == blocks.peek(1, 2, 3));
+    assert(chunk_blocks_pool_stats().live == before.live + 1);
+
+    /* until one side writes; the other still sees the old blocks */
+    blocks.get(1, 2, 3)->type = block_empty;
+    assert(!copy.is_shared() && !blocks.is_shared());
+    assert(!copy.same_storage(blocks));
+    assert(copy.peek(1, 2, 3)->type == block_support);
+    assert(blocks.peek(1, 2, 3)->type == block_empty);
+    assert(chunk_blocks_pool_stats().live == before.live + 2);
+
+    /* assignment shares too, and drops what was there */
+    copy = blocks;
+    assert(copy.same_storage(blocks));
+    assert(chunk_blocks_pool_stats().live == before.live + 1);
+
+    /* compacting one sharer leaves the array to the other */
+    assert(blocks.compact());
+    assert(!copy.is_uniform() && !copy.is_shared());
+    assert(copy.peek(1, 2, 3)->type == block_empty);
+    assert(chunk_blocks_pool_stats().live == before.live + 1);
+
+    /* uniform chunks are copied by value */
+    chunk_blocks empty;
+    chunk_blocks empty_copy = empty;
+    assert(empty_copy.is_uniform() && empty_copy.same_storage(empty));
+}
+
+void
+masks(void)
+{
+    chunk *c = new chunk();
+
+    /* a new chunk is empty, and blocks nothing */
+    assert(c->occupied.none());
+    for (int face = 0; face < face_count; face++) {
+        assert(c->blocks_air[face].none() && c->blocks_light[face].none());
+    }
+
+    /* a uniform chunk fills its masks */
+    c->blocks.uniform.type = block_support;
+    c->update_masks();
+    for (unsigned z = 0; z < CHUNK_SIZE; z++) {
+        for (unsigned y = 0; y < CHUNK_SIZE; y++) {
+            assert(c->occupied.row(y, z) == chunk_row_full);
+        }
+    }
+
+    /* and a dense one follows its blocks, a bit per block, rows along x */
+    c->blocks.get(1, 2, 3)->type = block_empty;
+    c->blocks.get(4, 5, 6)->surfs[surface_yp] = surface_glass;
+    c->blocks.get(4, 5, 7)->surfs[surface_zm] = surface_grate;
+    c->update_masks();
+    assert(!c->occupied.test(1, 2, 3));
+    assert(c->occupied.row(2, 3) == (chunk_row)(chunk_row_full & ~(1u << 1)));
+    assert(c->blocks_air[surface_yp].test(4, 5, 6) && !c->blocks_light[surface_yp].test(4, 5, 6));
+    assert(!c->blocks_air[surface_zm].test(4, 5, 7) && c->blocks_light[surface_zm].test(4, 5, 7));
+    assert(c->blocks_air[surface_ym].none());
+
+    /* a single block can be brought up to date on its own */
+    c->blocks.get(4, 5, 6)->surfs[surface_yp] = surface_none;
+    c->update_masks(4, 5, 6);
+    assert(c->blocks_air[surface_yp].none());
+
+    delete c;
+}
+
+void
+collision_faces(void)
+{
+    chunk *c = new chunk;
+    glm::ivec3 all(CHUNK_SIZE - 1);
+    chunk const *none[face_count] = {};
+    int n = 0;
+    auto count = [&](glm::ivec3, int) { n++; };
+
+    /* a uniform chunk of scaffolding is only solid on the outside */
+    c->blocks.uniform.type = block_support;
+    c->collision_faces(glm::ivec3(0), all, none, count);
+    assert(n == 6 * CHUNK_SIZE * CHUNK_SIZE);
+
+    c->blocks.uniform.type = block_empty;
+    n = 0;
+    c->collision_faces(glm::ivec3(0), all, none, count);
+    assert(n == 0);
+
+    /* two scaffolding blocks side by side don't collide where they meet;
+     * a wall between two empty blocks is there once; an open door isn't
+     * there at all; and a wall up against scaffolding is its face */
+    c->blocks.get(3, 3, 3)->type = block_support;
+    c->blocks.get(4, 3, 3)->type = block_support;
+    c->blocks.get(1, 1, 1)->surfs[surface_xp] = surface_wall;
+    c->blocks.get(2, 1, 1)->surfs[surface_xm] = surface_wall;
+    c->blocks.get(5, 5, 5)->surfs[surface_zp] = surface_door_open;
+    c->blocks.get(5, 5, 6)->surfs[surface_zm] = surface_door_open;
+    c->blocks.get(3, 3, 3)->surfs[surface_zp] = surface_wall;
+    c->blocks.get(3, 3, 4)->surfs[surface_zm] = surface_wall;
+
+    n = 0;
+    c->collision_faces(glm::ivec3(0), all, none, [&](glm::ivec3 p, int face) {
+        assert(p != glm::ivec3(3, 3, 4));
+        assert(p != glm::ivec3(2, 1, 1));
+        assert(!(p == glm::ivec3(3, 3, 3) && face == surface_xp));
+        n++;
+    });
+    assert(n == 10 + 1);
+
+    /* only the blocks asked about */
+    n = 0;
+    c->collision_faces(glm::ivec3(4, 0, 0), all, none, count);
+    assert(n == 5);
+
+    /* a surface at the edge of the chunk is there from this side */
+    c->blocks.get(CHUNK_SIZE - 1, 0, 0)->surfs[surface_xp] = surface_glass;
+    n = 0;
+    c->collision_faces(glm::ivec3(CHUNK_SIZE - 1, 0, 0), glm::ivec3(CHUNK_SIZE - 1, 0, 0), none, count);
+    assert(n == 1);
+
+    delete c;
+
+    /* two chunks of scaffolding side by side by x don't collide where they
+     * meet; a wall between them is there once, from the lower one; and a
+     * neighbour's scaffolding hides this one's surfaces */
+    chunk *a = new chunk;
+    chunk *b = new chunk;
+    a->blocks.uniform.type = block_support;
+    b->blocks.uniform.type = block_support;
+    chunk const *a_side[face_count] = { b, nullptr, nullptr, nullptr, nullptr, nullptr };
+    chunk const *b_side[face_count] = { nullptr, a, nullptr, nullptr, nullptr, nullptr };
+
+    n = 0;
+    a->collision_faces(glm::ivec3(0), all, a_side, count);
+    b->collision_faces(glm::ivec3(0), all, b_side, count);
+    assert(n == 2 * 5 * CHUNK_SIZE * CHUNK_SIZE);
+
+    a->blocks.uniform.type = block_empty;
+    b->blocks.uniform.type = block_empty;
+    a->blocks.get(CHUNK_SIZE - 1, 2, 2)->surfs[surface_xp] = surface_wall;
+    b->blocks.get(0, 2, 2)->surfs[surface_xm] = surface_wall;
+    a->blocks.get(CHUNK_SIZE - 1, 4, 4)->surfs[surface_xp] = surface_wall;
+    b->blocks.get(0, 4, 4)->type = block_support;
+    b->blocks.get(0, 4, 4)->surfs[surface_xm] = surface_wall;
+
+    n = 0;
+    a->collision_faces(glm::ivec3(0), all, a_side, [&](glm::ivec3 p, int face) {
+        assert(p == glm::ivec3(CHUNK_SIZE - 1, 2, 2) && face == surface_xp);
+        n++;
+    });
+    b->collision_faces(glm::ivec3(0), all, b_side, [&](glm::ivec3 p, int face) {
+        assert(p == glm::ivec3(0, 4, 4));
+        n++;
+    });
+    assert(n == 1 + 6);
+
+    /* and without the neighbour, the wall is there from both sides */
+    n = 0;
+    b->collision_faces(glm::ivec3(0, 2, 2), glm::ivec3(0, 2, 2), none, count);
+    assert(n == 1);
+
+    delete a;
+    delete b;
+}
+
+/* a unit cube, two triangles a face, wound to face out, and one triangle
+ * inside it */
+static sw_mesh *
+test_scaffold(void)
+{
+    static vertex verts[6 * 4 + 3];
+    static unsigned indices[6 * 6 + 3];
+    unsigned v = 0, i = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        int u = (axis + 1) % 3, w = (axis + 2) % 3;
+        for (int side = 0; side < 2; side++) {
+            int const corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+            unsigned const quad[] = { 0, 1, 2, 0, 2, 3 };
+            for (unsigned q : quad)
+                indices[i++] = v + q;
+            for (int k = 0; k < 4; k++) {
+                float p[3];
+                p[axis] = side ? 0.0f : 1.0f;
+                p[u] = (float)corners[side ? 3 - k : k][0];
+                p[w] = (float)corners[side ? 3 - k : k][1];
+                verts[v++] = vertex(p[0], p[1], p[2], 0, 0, 0, 0);
+            }
+        }
+    }
+
+    for (int k = 0; k < 3; k++) {
+        indices[i++] = v;
+        verts[v++] = vertex(0.5f, 0.25f * k, 0.5f, 0, 0, 0, 0);
+    }
+
+    sw_mesh *m = new sw_mesh();
+    m->verts = verts;
+    m->indices = indices;
+    m->num_vertices = v;
+    m->num_indices = i;
+    return m;
+}
+
+void
+mesh_culling(void)
+{
+    sw_mesh *scaffold = test_scaffold();
+    sw_mesh *surfs[6];
+    for (int face = 0; face < face_count; face++) {
+        surfs[face] = new sw_mesh();
+        surfs[face]->verts = scaffold->verts + 6 * 4;
+        surfs[face]->indices = scaffold->indices + 6 * 6;
+        surfs[face]->num_vertices = 3;
+        surfs[face]->num_indices = 3;
+    }
+
+    mesh_parts parts(scaffold);
+    chunk const *none[face_count] = {};
+    std::vector<vertex> verts;
+    std::vector<unsigned> indices;
+    /* sealed on its own, with nothing around it; see ship_space::update_seals */
+    auto triangles = [&](chunk *c, chunk const *const *neighbours) {
+        c->update_masks();
+        c->sealed = c->scaffolding;
+        c->update_seals(none);
+
+        verts.clear();
+        indices.clear();
+        c->build_mesh(&parts, surfs, neighbours, &verts, &indices);
+        return indices.size() / 3;
+    };
+
+    mesher_init();
+
+    /* empty space draws nothing; a lone scaffold is drawn whole */
+    chunk *c = new chunk;
+    assert(triangles(c, none) == 0);
+    c->blocks.get(3, 3, 3)->type = block_support;
+    assert(triangles(c, none) == 13);
+
+    /* two side by side hide each other's faces where they meet */
+    c->blocks.get(4, 3, 3)->type = block_support;
+    assert(triangles(c, none) == 2 * (13 - 2));
+
+    /* a scaffold walled in on every side is left out altogether, and so
+     * are the walls facing into it; those facing out stay */
+    c->blocks.get(4, 3, 3)->type = block_empty;
+    for (int face = 0; face < face_count; face++) {
+        glm::ivec3 q(3, 3, 3);
+        q[face >> 1] += (face & 1) ? -1 : 1;
+        c->blocks.get(3, 3, 3)->surfs[face] = surface_wall;
+        c->blocks.get(q.x, q.y, q.z)->surfs[face ^ 1] = surface_wall;
+    }
+    assert(triangles(c, none) == 6);
+
+    /* but through glass, the inside of the scaffold can be seen, and the
+     * face behind the glass, and the walls facing in */
+    c->blocks.get(3, 3, 3)->surfs[surface_zp] = surface_glass;
+    c->blocks.get(3, 3, 4)->surfs[surface_zm] = surface_glass;
+    assert(triangles(c, none) == 1 + 2 + 6 + 6);
+    delete c;
+
+    /* a bulkhead three deep, walled in all round, is sealed right through;
+     * open at one end, the lattice can be seen into all the way */
+    c = new chunk;
+    for (int k = 1; k <= 3; k++) {
+        for (int j = 1; j <= 3; j++) {
+            for (int i = 1; i <= 3; i++) {
+                glm::ivec3 p(i, j, k);
+                c->blocks.get(i, j, k)->type = block_support;
+                for (int face = 0; face < face_count; face++) {
+                    glm::ivec3 q = p;
+                    q[face >> 1] += (face & 1) ? -1 : 1;
+                    if (q.x < 1 || q.x > 3 || q.y < 1 || q.y > 3 || q.z < 1 || q.z > 3) {
+                        c->blocks.get(i, j, k)->surfs[face] = surface_wall;
+                        c->blocks.get(q.x, q.y, q.z)->surfs[face ^ 1] = surface_wall;
+                    }
+                }
+            }
+        }
+    }
+    assert(triangles(c, none) == 6);
+
+    for (int k = 1; k <= 3; k++) {
+        for (int i = 1; i <= 3; i++) {
+            c->blocks.get(i, 3, k)->surfs[surface_yp] = surface_none;
+            c->blocks.get(i, 4, k)->surfs[surface_ym] = surface_none;
+        }
+    }
+    assert(triangles(c, none) == 27 + 9 * 2 + 5 + 5);
+    delete c;
+
+    /* like surfaces side by side are drawn as one */
+    c = new chunk;
+    for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < 4; i++) {
+            c->blocks.get(i, j, 2)->surfs[surface_zp] = surface_wall;
+        }
+    }
+    assert(triangles(c, none) == 1);
+
+    /* and around one which isn't alike, in as few rectangles as the
+     * rows and columns allow */
+    c->blocks.get(1, 1, 2)->surfs[surface_zp] = surface_glass;
+    assert(triangles(c, none) == 5);
+    delete c;
+
+    /* across a chunk boundary, given the chunk there */
+    chunk *a = new chunk, *b = new chunk;
+    a->blocks.get(CHUNK_SIZE - 1, 0, 0)->type = block_support;
+    b->blocks.get(0, 0, 0)->type = block_support;
+    chunk const *beside[face_count] = {};
+    beside[surface_xp] = b;
+    assert(triangles(a, none) == 13);
+    assert(triangles(a, beside) == 13 - 2);
+    delete a;
+    delete b;
+}
+
 int
 main(void)
 {
+    uniform_storage();
+    pooled();
+    copy_on_write();
+    masks();
+    collision_faces();
+    mesh_culling();
 }
-
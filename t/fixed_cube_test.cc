@@ -4,10 +4,82 @@
 #include "../src/fixed_cube.h"
 
 
-/* some light manual testing of block and grid
+/* every layout must map each cell of the cube to a distinct index,
+ * and coords() must undo index()
  */
+template<class Layout, unsigned N>
+void
+layout_roundtrip(void)
+{
+    bool seen[N * N * N] = { false };
+
+    for (unsigned z = 0; z < N; z++) {
+        for (unsigned y = 0; y < N; y++) {
+            for (unsigned x = 0; x < N; x++) {
+                unsigned i = Layout::template index<N>(x, y, z);
+                assert(i < N * N * N);
+                assert(!seen[i]);
+                seen[i] = true;
+
+                unsigned cx, cy, cz;
+                Layout::template coords<N>(i, &cx, &cy, &cz);
+                assert(cx == x && cy == y && cz == z);
+            }
+        }
+    }
+}
+
+/* for_each visits every cell once, with the co-ords get() agrees with */
+template<class Layout>
+void
+for_each_visits_all(void)
+{
+    fixed_cube<int, 8, Layout> c;
+
+    c.for_each([](unsigned x, unsigned y, unsigned z, int &v) {
+        v = (int)(x + 10 * y + 100 * z);
+    });
+
+    for (unsigned z = 0; z < 8; z++)
+        for (unsigned y = 0; y < 8; y++)
+            for (unsigned x = 0; x < 8; x++)
+                assert(*c.get(x, y, z) == (int)(x + 10 * y + 100 * z));
+
+    int count = 0;
+    c.for_each([&count](unsigned, unsigned, unsigned, int &) { count++; });
+    assert(count == 8 * 8 * 8);
+}
+
+void
+morton_neighbours(void)
+{
+    /* the first 8 cells in morton order are a 2x2x2 block */
+    for (unsigned i = 0; i < 8; i++) {
+        unsigned x, y, z;
+        layout_morton::coords<8>(i, &x, &y, &z);
+        assert(x < 2 && y < 2 && z < 2);
+    }
+
+    assert(layout_morton::index<8>(1, 0, 0) == 1);
+    assert(layout_morton::index<8>(0, 1, 0) == 2);
+    assert(layout_morton::index<8>(0, 0, 1) == 4);
+}
+
 int
 main(void)
 {
-}
+    layout_roundtrip<layout_x_fastest, 8>();
+    layout_roundtrip<layout_x_fastest, 5>();
+    layout_roundtrip<layout_z_fastest, 8>();
+    layout_roundtrip<layout_z_fastest, 5>();
+    layout_roundtrip<layout_morton, 8>();
+    layout_roundtrip<layout_morton, 16>();
+
+    for_each_visits_all<layout_x_fastest>();
+    for_each_visits_all<layout_z_fastest>();
+    for_each_visits_all<layout_morton>();
 
+    morton_neighbours();
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include "../src/common.h"
+#include "../src/blob.h"
+#include "../src/ship_file.h"
+#include "../src/component/door_component.h"
+
+static char const *filename = "ship_file_test.ship";
+
+/* a sealed, pressurized box of scaffolding from lo to hi (inclusive), split
+ * in two by a wall across x = split|split+1 */
+static ship_space *
+two_rooms(glm::ivec3 lo, glm::ivec3 hi, int split)
+{
+    ship_space *ship = new ship_space;
+    ship->begin_edit();
+
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int y = lo.y; y <= hi.y; y++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                glm::ivec3 p(x, y, z);
+                ship->set_block_type(p, block_support);
+
+                for (int face = 0; face < face_count; face++) {
+                    glm::ivec3 q = p + surface_index_to_normal(face);
+                    bool edge = q.x < lo.x || q.x > hi.x || q.y < lo.y || q.y > hi.y ||
+                                q.z < lo.z || q.z > hi.z;
+                    if (edge || (face == surface_xp && x == split)) {
+                        ship->set_surface(p, q, (surface_index)face, surface_wall);
+                    }
+                }
+            }
+        }
+    }
+
+    ship->commit();
+    ship->rebuild_topology();
+
+    topo_info *a = topo_find(ship->get_topo_info(lo));
+    topo_info *b = topo_find(ship->get_topo_info(hi));
+    ship->insert_zone(a, 1.5f * a->size);
+    ship->insert_zone(b, 3.0f * b->size);
+
+    return ship;
+}
+
+void
+round_trip(void)
+{
+    glm::ivec3 lo(-3, 1, 1), hi(20, 9, 6);
+    ship_space *ship = two_rooms(lo, hi, 5);
+
+    wire_attachment wa;
+    wa.transform = glm::mat4(1);
+    wa.rank = 0;
+    wa.parent = 0;
+    ship->wire_attachments[wire_type_power].push_back(wa);
+    wa.parent = 1;
+    ship->wire_attachments[wire_type_power].push_back(wa);
+    ship->wire_segments[wire_type_power].push_back(wire_segment{ 0, 1 });
+    c_entity e = { 42 };
+    ship->entity_to_attach_lookups[wire_type_power][e].insert(1);
+
+    door_component_manager doors;
+    doors.create_component_instance_data(4);
+    doors.assign_entity(e);
+    *doors.get_instance_data(e).pos = 0.5f;
+    *doors.get_instance_data(e).mesh = (hw_mesh *)&doors;
+
+    component_manager *managers[] = { &doors };
+    assert(save_ship(ship, filename, managers, 1));
+
+    door_component_manager loaded_doors;
+    component_manager *loaded_managers[] = { &loaded_doors };
+    ship_space *loaded = load_ship(filename, loaded_managers, 1);
+    assert(loaded);
+    assert(loaded->chunks.size() == ship->chunks.size());
+    assert(loaded->mins == ship->mins && loaded->maxs == ship->maxs);
+
+    /* the same blocks, spaces and air */
+    for (auto ch : ship->chunks) {
+        chunk *other = loaded->get_chunk(ch.first);
+        assert(other);
+        assert(other->blocks.is_uniform() == ch.second->blocks.is_uniform());
+
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    block const *a = ch.second->blocks.peek(x, y, z);
+                    block const *b = other->blocks.peek(x, y, z);
+                    assert(!memcmp(a, b, sizeof(block)));
+
+                    glm::ivec3 p = CHUNK_SIZE * ch.first + glm::ivec3(x, y, z);
+                    topo_info *ta = topo_find(ship->get_topo_info(p));
+                    topo_info *tb = topo_find(loaded->get_topo_info(p));
+                    assert(ta->size == tb->size);
+
+                    zone_info *za = ship->get_zone_info(ta);
+                    zone_info *zb = loaded->get_zone_info(tb);
+                    assert(!za == !zb);
+                    if (za) {
+                        assert(za->air_amount == zb->air_amount);
+                    }
+                }
+            }
+        }
+    }
+    assert(loaded->zones.size() == ship->zones.size());
+
+    /* the wiring */
+    assert(loaded->wire_attachments[wire_type_power].size() == 2);
+    assert(loaded->wire_attachments[wire_type_power][1].parent == 1);
+    assert(loaded->wire_segments[wire_type_power].size() == 1);
+    assert(loaded->wire_segments[wire_type_power][0].second == 1);
+    assert(loaded->entity_to_attach_lookups[wire_type_power][e].count(1));
+    assert(loaded->wire_attachments[wire_type_comms].empty());
+
+    /* the components; pointers don't survive */
+    assert(loaded_doors.buffer.num == 1);
+    assert(loaded_doors.exists(e));
+    assert(*loaded_doors.get_instance_data(e).pos == 0.5f);
+    assert(*loaded_doors.get_instance_data(e).mesh == nullptr);
+
+    /* the block arrays were not copied, until written */
+    chunk *c = loaded->get_chunk_containing(glm::ivec3(0, 1, 1));
+    char const *mapped = (char const *)loaded->backing->data;
+    assert(!c->blocks.is_uniform());
+    assert((char const *)c->blocks.dense >= mapped &&
+           (char const *)c->blocks.dense < mapped + loaded->backing->len);
+
+    loaded->set_block_type(glm::ivec3(0, 1, 1), block_empty);
+    assert((char const *)c->blocks.dense < mapped ||
+           (char const *)c->blocks.dense >= mapped + loaded->backing->len);
+    assert(ship->get_block(glm::ivec3(0, 1, 1))->type == block_support);
+
+    /* and saving a loaded ship gives the same ship again */
+    loaded->set_block_type(glm::ivec3(0, 1, 1), block_support);
+    assert(save_ship(loaded, filename));
+    ship_space *again = load_ship(filename);
+    assert(again && again->chunks.size() == ship->chunks.size());
+    assert(again->get_block(glm::ivec3(0, 1, 1))->type == block_support);
+
+    delete again;
+    delete loaded;
+    delete ship;
+    remove(filename);
+}
+
+void
+refuse_bad_files(void)
+{
+    FILE *f = fopen(filename, "wb");
+    fputs("definitely not a ship, but long enough to have a header's worth of bytes "
+          "in it, so that the magic is what gets checked and not the length", f);
+    fclose(f);
+    assert(!load_ship(filename));
+
+    /* a ship file which claims more chunks than it holds */
+    ship_space *ship = two_rooms(glm::ivec3(1, 1, 1), glm::ivec3(6, 6, 6), 3);
+    assert(save_ship(ship, filename));
+    delete ship;
+
+    f = fopen(filename, "r+b");
+    ship_file_header h;
+    assert(fread(&h, sizeof(h), 1, f) == 1);
+    h.num_chunks = 1000000;
+    fseek(f, 0, SEEK_SET);
+    fwrite(&h, sizeof(h), 1, f);
+    fclose(f);
+    assert(!load_ship(filename));
+
+    /* one whose chunks aren't where its bounds say, or are there twice */
+    for (int bad = 0; bad < 3; bad++) {
+        ship = two_rooms(glm::ivec3(1, 1, 1), glm::ivec3(CHUNK_SIZE + 2), 3);
+        assert(save_ship(ship, filename));
+        delete ship;
+
+        f = fopen(filename, "r+b");
+        assert(fread(&h, sizeof(h), 1, f) == 1);
+        ship_file_chunk dir[2];
+        fseek(f, h.chunks_offset, SEEK_SET);
+        assert(fread(dir, sizeof(dir[0]), 2, f) == 2);
+
+        if (bad == 0)
+            dir[0].ch[0] = 1 << 24;                 /* far outside the bounds */
+        else if (bad == 1)
+            memcpy(dir[1].ch, dir[0].ch, sizeof(dir[0].ch));
+        else
+            h.maxs[0] = 1 << 24;                    /* bounds far bigger than the chunks */
+
+        fseek(f, 0, SEEK_SET);
+        fwrite(&h, sizeof(h), 1, f);
+        fseek(f, h.chunks_offset, SEEK_SET);
+        fwrite(dir, sizeof(dir[0]), 2, f);
+        fclose(f);
+        assert(!load_ship(filename));
+    }
+
+    remove(filename);
+}
+
+int
+main(void)
+{
+    round_trip();
+    refuse_bad_files();
+}
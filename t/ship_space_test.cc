@@ -1,7 +1,11 @@
 #include <stdio.h>
 #include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
 #include "../src/common.h"
 #include "../src/ship_space.h"
+#include "../src/thread_pool.h"
 
 void
 simple(void)
@@ -49,6 +53,16 @@ simple(void)
     b = space.get_block(glm::ivec3(0, 8, 0));
     assert(b != 0);
     assert(b->type == block_support);
+
+    /* reading through peek_block leaves a uniform chunk, and its masks, be */
+    chunk *c = space.chunks.get(glm::ivec3(1, 1, 1));
+    c->masks_stale = false;
+    assert(c->blocks.is_uniform());
+    assert(space.peek_block(glm::ivec3(CHUNK_SIZE + 1)) == c->blocks.peek(1, 1, 1));
+    assert(space.peek_block(glm::ivec3(CHUNK_SIZE + 1))->type == block_empty);
+    assert(c->blocks.is_uniform());
+    assert(!c->masks_stale);
+    assert(!space.peek_block(glm::ivec3(2 * CHUNK_SIZE)));
 }
 
 void
@@ -108,13 +122,1188 @@ ensure(void)
 
 }
 
+void
+cursor(void)
+{
+    ship_space space;
+
+    for (int i = -1; i < 1; i++) {
+        for (int j = -1; j < 1; j++) {
+            space.ensure_chunk(glm::ivec3(i, j, 0));
+        }
+    }
+
+    /* walk a cursor in every direction, across chunk boundaries and off
+     * the edge of the ship, and check it agrees with get_block */
+    for (int face = 0; face < face_count; face++) {
+        glm::ivec3 p(-3, 2, 1);
+        block_cursor cur(&space, p);
+
+        for (int i = 0; i < 2 * CHUNK_SIZE; i++) {
+            assert(cur.pos == p);
+            assert(cur.get() == space.get_block(p));
+            assert(cur.topo() == space.get_topo_info(p));
+
+            cur.step(face);
+            p += surface_index_to_normal(face);
+        }
+    }
+}
+
+/* one block at a time along the ray, through get_block: what
+ * ship_space::raycast should agree with */
+static bool
+naive_raycast(ship_space *ship, glm::vec3 o, glm::vec3 d, float max_dist, glm::ivec3 *hit)
+{
+    d = glm::normalize(d);
+    glm::ivec3 v((int)floorf(o.x), (int)floorf(o.y), (int)floorf(o.z));
+    glm::ivec3 step;
+    glm::vec3 t_max;
+
+    for (int a = 0; a < 3; a++) {
+        step[a] = d[a] > 0 ? 1 : -1;
+        t_max[a] = (v[a] + (d[a] > 0) - o[a]) / d[a];
+    }
+
+    for (;;) {
+        int a = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+        if (t_max[a] > max_dist)
+            return false;
+
+        v[a] += step[a];
+        t_max[a] = (v[a] + (d[a] > 0) - o[a]) / d[a];
+
+        block *bl = ship->get_block(v);
+        if (bl && bl->type != block_empty) {
+            *hit = v;
+            return true;
+        }
+    }
+}
+
+void
+raycasts(void)
+{
+    ship_space *ship = new ship_space;
+    ship->ensure_chunk(glm::ivec3(0, 0, 0));
+    ship->set_block_type(glm::ivec3(20 * CHUNK_SIZE + 3, 2, 2), block_support);
+    ship->set_surface(glm::ivec3(5, 2, 2), glm::ivec3(6, 2, 2), surface_xp, surface_wall);
+
+    ray_filter blocks = { 1 << block_support | 1 << block_entity, 0 };
+    ray_filter walls = { 0, surface_blocks_air };
+
+    /* a long way, past the absent chunks in between; and not when that's
+     * further than the ray goes */
+    raycast_info rc;
+    glm::vec3 o(0.5f, 2.5f, 2.5f);
+    ship->raycast(o, glm::vec3(1, 0, 0), 1000, blocks, &rc);
+    assert(rc.hit && !rc.inside);
+    assert(rc.bl == glm::ivec3(20 * CHUNK_SIZE + 3, 2, 2));
+    assert(rc.n == glm::ivec3(-1, 0, 0));
+    assert(rc.p == glm::ivec3(20 * CHUNK_SIZE + 2, 2, 2));
+    assert(fabsf(rc.t - (20 * CHUNK_SIZE + 2.5f)) < 1e-3f);
+    assert(rc.block && rc.block->type == block_support);
+
+    ship->raycast(o, glm::vec3(1, 0, 0), 100, blocks, &rc);
+    assert(!rc.hit);
+
+    /* the block hit is only looked at: a uniform chunk stays uniform */
+    ship->ensure_chunk(glm::ivec3(-2, 0, 0))->blocks.uniform.type = block_support;
+    ship->raycast(o, glm::vec3(-1, 0, 0), 100, blocks, &rc);
+    assert(rc.hit && rc.block && rc.block->type == block_support);
+    assert(ship->chunks.get(glm::ivec3(-2, 0, 0))->blocks.is_uniform());
+
+    /* surfaces stop the ray only when asked; the block hit is the one
+     * across the surface, whichever way the ray goes */
+    ship->raycast(o, glm::vec3(1, 0, 0), 1000, walls, &rc);
+    assert(rc.hit);
+    assert(rc.bl == glm::ivec3(6, 2, 2) && rc.p == glm::ivec3(5, 2, 2));
+
+    ship->raycast(glm::vec3(500.5f, 2.5f, 2.5f), glm::vec3(-1, 0, 0), 1000, walls, &rc);
+    assert(rc.hit);
+    assert(rc.bl == glm::ivec3(5, 2, 2) && rc.p == glm::ivec3(6, 2, 2));
+    assert(rc.n == glm::ivec3(1, 0, 0));
+
+    /* the player's reach: out of a block, to the first empty one */
+    ship->raycast(glm::vec3(20 * CHUNK_SIZE + 3.5f, 2.5f, 2.5f), glm::vec3(0, 0, 1), &rc);
+    assert(rc.hit && rc.inside);
+    assert(rc.bl == glm::ivec3(20 * CHUNK_SIZE + 3, 2, 3));
+
+    ship->raycast(glm::vec3(20 * CHUNK_SIZE + 0.5f, 2.5f, 2.5f), glm::vec3(1, 0, 0), &rc);
+    assert(rc.hit && !rc.inside);
+    assert(rc.bl == glm::ivec3(20 * CHUNK_SIZE + 3, 2, 2));
+    delete ship;
+
+    /* and any which way through a scattering of blocks in some chunks,
+     * with others left empty or missing */
+    ship = new ship_space;
+    srand(5);
+    for (int i = 0; i < 40; i++) {
+        glm::ivec3 ch(rand() % 6, rand() % 6, rand() % 6);
+        ship->ensure_chunk(ch);
+        if (i % 4 == 0)
+            continue;
+        for (int j = 0; j < 64; j++) {
+            glm::ivec3 p = CHUNK_SIZE * ch + glm::ivec3(rand() % (CHUNK_SIZE - 1), rand() % CHUNK_SIZE,
+                                                        rand() % CHUNK_SIZE);
+            ship->set_block_type(p, block_support);
+            if (j % 4 == 0)
+                ship->set_surface(p, p + glm::ivec3(1, 0, 0), surface_xp, j % 8 ? surface_wall : surface_grate);
+        }
+    }
+
+    std::vector<ray> rays;
+    int hits = 0;
+    for (int i = 0; i < 2000; i++) {
+        glm::vec3 from(rand() % 1000 / 10.0f - 25, rand() % 1000 / 10.0f - 25, rand() % 1000 / 10.0f - 25);
+        glm::vec3 dir(rand() % 1000 - 499.5f, rand() % 1000 - 499.5f, rand() % 1000 - 499.5f);
+        glm::ivec3 expected;
+        bool expect_hit = naive_raycast(ship, from, dir, 80, &expected);
+
+        ship->raycast(from, dir, 80, blocks, &rc);
+        assert(rc.hit == expect_hit);
+        assert(!rc.hit || rc.bl == expected);
+        hits += rc.hit;
+        rays.push_back(ray{ from, dir, 80 });
+    }
+    assert(hits > 100);
+
+    /* a batch of them gives the same, whatever order they're walked in,
+     * stopping at surfaces or empty blocks too */
+    for (ray_filter f : { blocks, walls, ray_filter{ 1 << block_empty, surface_blocks_light } }) {
+        std::vector<raycast_info> batch(rays.size());
+        ship->raycast_many(rays.data(), batch.data(), rays.size(), f);
+
+        for (size_t i = 0; i < rays.size(); i++) {
+            ship->raycast(rays[i].o, rays[i].d, rays[i].max_dist, f, &rc);
+            assert(batch[i].hit == rc.hit && batch[i].inside == rc.inside);
+            if (rc.hit) {
+                assert(batch[i].bl == rc.bl && batch[i].n == rc.n);
+                assert(batch[i].t == rc.t && batch[i].block == rc.block);
+            }
+        }
+    }
+
+    std::vector<raycast_info> few(3);
+    ship->raycast_many(rays.data(), few.data(), 3, blocks);
+    for (int i = 0; i < 3; i++) {
+        ship->raycast(rays[i].o, rays[i].d, rays[i].max_dist, blocks, &rc);
+        assert(few[i].hit == rc.hit && (!rc.hit || few[i].bl == rc.bl));
+    }
+
+    /* and none at all */
+    ship->raycast_many(rays.data(), few.data(), 0, blocks);
+    ship->raycast_many(nullptr, nullptr, 0, blocks);
+
+    delete ship;
+}
+
 /* some more quick and dirty 'testing'
  * mostly checking we compile and nothing
  * blows up obviously
  */
+void
+chunk_boundaries(void)
+{
+    ship_space space;
+
+    chunk *neg = space.ensure_chunk(glm::ivec3(-1, 0, 0));
+    chunk *pos = space.ensure_chunk(glm::ivec3(0, 0, 0));
+
+    /* chunk -1 spans blocks -CHUNK_SIZE..-1, chunk 0 spans 0..CHUNK_SIZE-1 */
+    assert(space.get_chunk_containing(glm::ivec3(-CHUNK_SIZE - 1, 0, 0)) == 0);
+    assert(space.get_chunk_containing(glm::ivec3(-CHUNK_SIZE, 0, 0)) == neg);
+    assert(space.get_chunk_containing(glm::ivec3(-1, 0, 0)) == neg);
+    assert(space.get_chunk_containing(glm::ivec3(0, 0, 0)) == pos);
+    assert(space.get_chunk_containing(glm::ivec3(CHUNK_SIZE - 1, 0, 0)) == pos);
+    assert(space.get_chunk_containing(glm::ivec3(CHUNK_SIZE, 0, 0)) == 0);
+
+    /* and the offset within the chunk is taken from its minimum corner */
+    assert(space.get_block(glm::ivec3(-CHUNK_SIZE, 0, 0)) == neg->blocks.get(0, 0, 0));
+    assert(space.get_block(glm::ivec3(-1, 0, 0)) == neg->blocks.get(CHUNK_SIZE - 1, 0, 0));
+}
+
+/* walls around the box of blocks lo..hi (inclusive) */
+static void
+seal_box(ship_space *ship, glm::ivec3 lo, glm::ivec3 hi)
+{
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int y = lo.y; y <= hi.y; y++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                glm::ivec3 p(x, y, z);
+                for (int face = 0; face < face_count; face++) {
+                    glm::ivec3 q = p + surface_index_to_normal(face);
+                    if (glm::min(q, lo) != lo || glm::max(q, hi) != hi) {
+                        ship->set_block_type(q, block_support);
+                        ship->set_surface(p, q, (surface_index)face, surface_wall);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* two sealed rooms side by side, with air at different pressures */
+static ship_space *
+pressurized_ship(void)
+{
+    ship_space *ship = new ship_space;
+    ship->ensure_chunk(glm::ivec3(0, 0, 0));
+    ship->ensure_chunk(glm::ivec3(1, 0, 0));
+
+    seal_box(ship, glm::ivec3(1, 1, 1), glm::ivec3(6, 6, 6));
+    seal_box(ship, glm::ivec3(7, 1, 1), glm::ivec3(12, 6, 6));
+    ship->rebuild_topology();
+
+    topo_info *a = topo_find(ship->get_topo_info(glm::ivec3(3, 3, 3)));
+    topo_info *b = topo_find(ship->get_topo_info(glm::ivec3(9, 3, 3)));
+    assert(a != b);
+    ship->insert_zone(a, 10.0f * a->size);
+    ship->insert_zone(b, 20.0f * b->size);
+
+    return ship;
+}
+
+/* partition off the end of a room with a wall across the plane x = px|px+1 */
+static void
+partition(ship_space *ship, int px)
+{
+    for (int z = 1; z < 7; z++) {
+        for (int y = 1; y < 7; y++) {
+            glm::ivec3 a(px, y, z);
+            ship->set_block_type(a, block_support);
+            ship->set_surface(a, a + glm::ivec3(1, 0, 0), surface_xp, surface_wall);
+        }
+    }
+}
+
+/* partition the first room, knock a hole from its far half into the
+ * second room, then partition the second room */
+static void
+apply_edits(ship_space *ship)
+{
+    partition(ship, 3);
+    ship->remove_surface(glm::ivec3(6, 3, 3), glm::ivec3(7, 3, 3), surface_xp);
+    partition(ship, 9);
+}
+
+static std::vector<block_delta> seen;
+
+static void
+see_all(ship_space *ship, unsigned sub)
+{
+    ship->consume(sub, [](block_delta const &d) { seen.push_back(d); });
+}
+
+void
+transactions(void)
+{
+    ship_space *one_by_one = pressurized_ship();
+    ship_space *batched = pressurized_ship();
+
+    unsigned sub_a = one_by_one->subscribe();
+    unsigned sub_b = batched->subscribe();
+
+    seen.clear();
+    apply_edits(one_by_one);
+    see_all(one_by_one, sub_a);
+    std::vector<block_delta> one_by_one_seen = seen;
+    assert(!seen.empty());
+
+    seen.clear();
+    int rebuilds = batched->num_full_rebuilds;
+    batched->begin_edit();
+    apply_edits(batched);
+    see_all(batched, sub_b);
+    assert(seen.empty());
+    batched->commit();
+    see_all(batched, sub_b);
+
+    /* the topology was brought up to date once, and the journal has the
+     * same changes as for the edits made one at a time */
+    assert(batched->num_full_rebuilds - rebuilds <= 2);
+    assert(seen.size() == one_by_one_seen.size());
+    for (size_t i = 0; i < seen.size(); i++) {
+        assert(seen[i].p == one_by_one_seen[i].p);
+        assert(seen[i].face == one_by_one_seen[i].face);
+        assert(seen[i].old_value == one_by_one_seen[i].old_value);
+        assert(seen[i].new_value == one_by_one_seen[i].new_value);
+    }
+
+    /* consumed changes are not seen again, and are dropped */
+    seen.clear();
+    see_all(batched, sub_b);
+    assert(seen.empty());
+    assert(batched->journal.empty());
+
+    /* and it is the same as making the edits one at a time: the same
+     * blocks, the same spaces, and the same air in each */
+    for (auto ch : one_by_one->chunks) {
+        chunk *other = batched->get_chunk(ch.first);
+        assert(other);
+
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    block const *a = ch.second->blocks.peek(x, y, z);
+                    block const *b = other->blocks.peek(x, y, z);
+                    assert(a->type == b->type);
+                    for (int face = 0; face < face_count; face++) {
+                        assert(a->surfs[face] == b->surfs[face]);
+                    }
+
+                    glm::ivec3 p = CHUNK_SIZE * ch.first + glm::ivec3(x, y, z);
+                    topo_info *ta = topo_find(one_by_one->get_topo_info(p));
+                    topo_info *tb = topo_find(batched->get_topo_info(p));
+                    assert(ta->size == tb->size);
+                    assert((ta == &one_by_one->outside_topo_info) == (tb == &batched->outside_topo_info));
+
+                    zone_info *za = one_by_one->get_zone_info(ta);
+                    zone_info *zb = batched->get_zone_info(tb);
+                    assert(!za == !zb);
+                    if (za) {
+                        assert(fabsf(za->air_amount - zb->air_amount) <= 1e-3f * za->air_amount);
+                    }
+                }
+            }
+        }
+    }
+
+    assert(one_by_one->zones.size() == batched->zones.size());
+
+    /* the walls really did split the rooms, and the air went with them */
+    topo_info *near = topo_find(batched->get_topo_info(glm::ivec3(2, 3, 3)));
+    topo_info *mid = topo_find(batched->get_topo_info(glm::ivec3(5, 3, 3)));
+    topo_info *far = topo_find(batched->get_topo_info(glm::ivec3(11, 3, 3)));
+    assert(near != mid && mid != far && near != far);
+    assert(fabsf(batched->get_zone_info(near)->air_amount - 10.0f * near->size) < 1e-2f);
+    assert(fabsf(batched->get_zone_info(mid)->air_amount + batched->get_zone_info(far)->air_amount -
+                 (10.0f * 3 * 36 + 20.0f * 6 * 36)) < 1e-1f);
+
+    delete one_by_one;
+    delete batched;
+}
+
+void
+journal(void)
+{
+    ship_space *ship = new ship_space;
+    glm::ivec3 a(1, 1, 1), b(2, 1, 1);
+
+    /* nothing is kept without a subscriber */
+    ship->set_block_type(a, block_support);
+    assert(ship->journal.empty());
+
+    unsigned mesher = ship->subscribe();
+    unsigned light = ship->subscribe();
+
+    ship->set_surface(a, b, surface_xp, surface_wall);
+    ship->set_surface(a, b, surface_xp, surface_wall);     /* no change */
+    ship->set_block_type(b, block_support);
+
+    seen.clear();
+    see_all(ship, mesher);
+    assert(seen.size() == 2);
+    assert(seen[0].p == a && seen[0].face == surface_xp);
+    assert(seen[0].old_value == surface_none && seen[0].new_value == surface_wall);
+    assert(seen[1].p == b && seen[1].face == -1);
+    assert(seen[1].old_value == block_empty && seen[1].new_value == block_support);
+
+    /* kept until every subscriber has seen it */
+    assert(ship->journal.size() == 2);
+    ship->remove_surface(a, b, surface_xp);
+    seen.clear();
+    see_all(ship, light);
+    assert(seen.size() == 3);
+    assert(ship->journal.size() == 1);
+
+    ship->unsubscribe(mesher);
+    assert(ship->journal.empty());
+
+    /* the slot is reused */
+    assert(ship->subscribe() == mesher);
+
+    delete ship;
+}
+
+/* true if every block of a and b is the same type with the same surfaces */
+static bool
+same_blocks(ship_space *a, ship_space *b)
+{
+    for (auto ch : a->chunks) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    glm::ivec3 p = CHUNK_SIZE * ch.first + glm::ivec3(x, y, z);
+                    block const *ba = ch.second->blocks.peek(x, y, z);
+                    block const *bb = block_cursor(b, p).peek();
+                    block_type tb = bb ? bb->type : block_empty;
+                    if (ba->type != tb)
+                        return false;
+
+                    for (int face = 0; face < face_count; face++) {
+                        surface_type sb = bb ? bb->surfs[face] : surface_none;
+                        if (ba->surfs[face] != sb)
+                            return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void
+snapshots(void)
+{
+    ship_space *ship = pressurized_ship();
+    glm::ivec3 a(3, 3, 3), b(4, 3, 3);
+
+    ship_snapshot *snap = ship->snapshot();
+    assert(snap->chunks.size() == ship->chunks.size());
+
+    /* nothing is copied up front */
+    chunk *c = ship->get_chunk(glm::ivec3(0, 0, 0));
+    assert(snap->chunks.at(glm::ivec3(0, 0, 0)).same_storage(c->blocks));
+
+    ship->set_block_type(a, block_support);
+    ship->set_surface(a, b, surface_xp, surface_wall);
+
+    /* the snapshot still sees the ship as it was */
+    assert(snap->get_block(a)->type == block_empty);
+    assert(snap->get_block(a)->surfs[surface_xp] == surface_none);
+    assert(ship->get_block(a)->type == block_support);
+    assert(!snap->chunks.at(glm::ivec3(0, 0, 0)).same_storage(c->blocks));
+
+    /* and whatever is outside the ship is still nothing */
+    assert(!snap->get_block(glm::ivec3(-100, 0, 0)));
+
+    delete snap;
+    delete ship;
+}
+
+void
+undo_redo(void)
+{
+    ship_space *ship = pressurized_ship();
+    ship_space *original = pressurized_ship();
+
+    assert(!ship->undo());
+
+    /* two undoable edits, and one which isn't: the latter is not undone */
+    ship->begin_undoable_edit();
+    partition(ship, 3);
+    ship->commit();
+
+    ship->set_block_type(glm::ivec3(12, 3, 3), block_support);
+    original->set_block_type(glm::ivec3(12, 3, 3), block_support);
+
+    ship->begin_undoable_edit();
+    ship->remove_surface(glm::ivec3(6, 3, 3), glm::ivec3(7, 3, 3), surface_xp);
+    ship->commit();
+
+    ship_space *edited = pressurized_ship();
+    partition(edited, 3);
+    edited->set_block_type(glm::ivec3(12, 3, 3), block_support);
+    edited->remove_surface(glm::ivec3(6, 3, 3), glm::ivec3(7, 3, 3), surface_xp);
+    assert(same_blocks(ship, edited));
+
+    /* only the chunks the edits touched were kept */
+    assert(ship->undo_steps.size() == 2);
+    assert(ship->undo_steps[1].where.size() == 1);
+
+    assert(ship->undo());
+    assert(ship->undo());
+    assert(!ship->undo());
+    assert(same_blocks(ship, original) && same_blocks(original, ship));
+
+    /* the topology followed: the rooms are whole again */
+    topo_info *near = topo_find(ship->get_topo_info(glm::ivec3(2, 3, 3)));
+    topo_info *mid = topo_find(ship->get_topo_info(glm::ivec3(5, 3, 3)));
+    assert(near == mid);
+    assert(ship->validate());
+
+    assert(ship->redo());
+    assert(ship->redo());
+    assert(!ship->redo());
+    assert(same_blocks(ship, edited) && same_blocks(edited, ship));
+
+    near = topo_find(ship->get_topo_info(glm::ivec3(2, 3, 3)));
+    mid = topo_find(ship->get_topo_info(glm::ivec3(5, 3, 3)));
+    assert(near != mid);
+
+    /* a new step forgets the redo */
+    assert(ship->undo());
+    ship->begin_undoable_edit();
+    ship->set_block_type(glm::ivec3(2, 2, 2), block_support);
+    ship->commit();
+    assert(!ship->redo());
+
+    delete ship;
+    delete original;
+    delete edited;
+}
+
+/* a room big enough that the chunk in its middle is never written to */
+static ship_space *
+big_room(bool materialise_all)
+{
+    ship_space *ship = new ship_space;
+    ship->ensure_chunk(glm::ivec3(0, 0, 0));
+    ship->ensure_chunk(glm::ivec3(2, 2, 2));
+
+    if (materialise_all) {
+        ship->ensure_chunk(glm::ivec3(1, 1, 1));
+    }
+
+    seal_box(ship, glm::ivec3(4, 4, 4), glm::ivec3(19, 19, 19));
+    ship->rebuild_topology();
+    return ship;
+}
+
+void
+implicit_chunks(void)
+{
+    ship_space *ship = big_room(false);
+    ship_space *full = big_room(true);
+
+    glm::ivec3 middle(12, 12, 12);
+    assert(ship->get_chunk(glm::ivec3(1, 1, 1)) == 0);
+    assert(ship->chunks.size() == 26);
+    assert(full->chunks.size() == 27);
+
+    /* the middle reads as empty space, but isn't writable */
+    block_cursor cur(ship, middle);
+    assert(cur.peek() && cur.peek()->type == block_empty);
+    assert(cur.get() == 0);
+    assert(ship->get_block(middle) == 0);
+
+    /* the middle is part of the room, not the outside */
+    topo_info *room = topo_find(ship->get_topo_info(glm::ivec3(5, 5, 5)));
+    assert(topo_find(ship->get_topo_info(middle)) == room);
+    assert(room != topo_find(&ship->outside_topo_info));
+    assert(room->size == 16 * 16 * 16);
+
+    /* and the spaces are just as if every chunk existed */
+    for (auto ch : full->chunks) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                for (int x = 0; x < CHUNK_SIZE; x++) {
+                    glm::ivec3 p = CHUNK_SIZE * ch.first + glm::ivec3(x, y, z);
+                    topo_info *a = topo_find(full->get_topo_info(p));
+                    topo_info *b = topo_find(ship->get_topo_info(p));
+                    assert(a->size == b->size);
+                    assert((a == topo_find(&full->outside_topo_info)) ==
+                           (b == topo_find(&ship->outside_topo_info)));
+                }
+            }
+        }
+    }
+
+    /* writing to it materialises it, still within the room */
+    ship->ensure_block(middle)->type = block_support;
+    assert(ship->get_chunk(glm::ivec3(1, 1, 1)));
+    assert(topo_find(ship->get_topo_info(middle)) == room);
+
+    ship->rebuild_topology();
+    room = topo_find(ship->get_topo_info(glm::ivec3(5, 5, 5)));
+    assert(topo_find(ship->get_topo_info(middle)) == room);
+    assert(room->size == 16 * 16 * 16);
+
+    /* opening the room up makes it all outside */
+    ship_space *open = big_room(false);
+    open->remove_surface(glm::ivec3(4, 12, 12), glm::ivec3(3, 12, 12), surface_xm);
+    assert(topo_find(open->get_topo_info(middle)) == topo_find(&open->outside_topo_info));
+    open->rebuild_topology();
+    assert(topo_find(open->get_topo_info(middle)) == topo_find(&open->outside_topo_info));
+    assert(open->implicit_topo.empty());
+
+    delete ship;
+    delete full;
+    delete open;
+}
+
+/* true if a and b have the same spaces, of the same sizes, over the
+ * blocks lo..hi (inclusive) */
+static bool
+same_spaces(ship_space *a, ship_space *b, glm::ivec3 lo, glm::ivec3 hi)
+{
+    std::unordered_map<topo_info *, topo_info *> a_to_b, b_to_a;
+
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int y = lo.y; y <= hi.y; y++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                glm::ivec3 p(x, y, z);
+                topo_info *ta = topo_find(a->get_topo_info(p));
+                topo_info *tb = topo_find(b->get_topo_info(p));
+
+                if (ta->size != tb->size ||
+                    (ta == &a->outside_topo_info) != (tb == &b->outside_topo_info) ||
+                    a_to_b.insert(std::make_pair(ta, tb)).first->second != tb ||
+                    b_to_a.insert(std::make_pair(tb, ta)).first->second != ta) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void
+local_splits(void)
+{
+    /* partitioning rooms, and knocking holes between them, takes no full
+     * rebuilds; the air is shared out just as a rebuild would */
+    ship_space *ship = pressurized_ship();
+    int rebuilds = ship->num_full_rebuilds;
+    int splits = ship->num_local_splits;
+    apply_edits(ship);
+    assert(ship->num_full_rebuilds == rebuilds);
+    assert(ship->num_local_splits - splits == 2);
+
+    topo_info *near = topo_find(ship->get_topo_info(glm::ivec3(2, 3, 3)));
+    topo_info *mid = topo_find(ship->get_topo_info(glm::ivec3(5, 3, 3)));
+    topo_info *far = topo_find(ship->get_topo_info(glm::ivec3(11, 3, 3)));
+    assert(near != mid && mid != far && near != far);
+    assert(near->size == 3 * 36 && far->size == 3 * 36);
+    assert(fabsf(ship->get_zone_info(near)->air_amount - 10.0f * near->size) < 1e-2f);
+    delete ship;
+
+    /* lots of surfaces put in and taken out in one corner of a big room,
+     * either side of a chunk boundary, open to the implicit chunk in its
+     * middle, and through the walls to the outside. after every batch, the
+     * spaces are the same as those a full rebuild finds */
+    ship_space *local = big_room(false);
+    ship_space *rebuilt = big_room(false);
+    rebuilds = local->num_full_rebuilds;
+    splits = local->num_local_splits;
+
+    srand(1);
+    for (int batch = 0; batch < 300; batch++) {
+        local->begin_edit();
+        rebuilt->begin_edit();
+
+        for (int n = rand() % 4; n >= 0; n--) {
+            glm::ivec3 p(5 + rand() % 6, 4 + rand() % 4, 4 + rand() % 4);
+            int face = rand() % face_count;
+            glm::ivec3 q = p + surface_index_to_normal(face);
+            bool add = rand() % 3 != 0;
+            ship_space *ships[] = { local, rebuilt };
+
+            for (auto s : ships) {
+                if (add) {
+                    s->set_surface(p, q, (surface_index)face, surface_wall);
+                }
+                else {
+                    s->remove_surface(p, q, (surface_index)face);
+                }
+            }
+        }
+
+        local->commit();
+        rebuilt->commit();
+        rebuilt->rebuild_topology();
+
+        assert(same_spaces(local, rebuilt, glm::ivec3(0, 0, 0), glm::ivec3(23, 23, 23)));
+        for (size_t i = 0; i < local->zones.size(); i++) {
+            topo_info *root = local->zones[i].root;
+            assert(topo_find(root) == root && root->zone == (int)i);
+        }
+    }
+
+    assert(local->num_full_rebuilds == rebuilds);
+    assert(local->num_local_splits > splits);
+    assert(local->implicit_topo.size() == 1);
+
+    delete local;
+    delete rebuilt;
+}
+
+void
+chunk_groups(void)
+{
+    ship_space *ship = pressurized_ship();
+    chunk *first = ship->chunks.get(glm::ivec3(0, 0, 0));
+    int rebuilds = ship->num_full_rebuilds;
+
+    /* blocks are grouped within their chunk: the first room is all one
+     * group, but the second room is in two chunks */
+    assert(ship->get_topo_info(glm::ivec3(1, 1, 1)) == ship->get_topo_info(glm::ivec3(6, 6, 6)));
+    assert(ship->get_topo_info(glm::ivec3(7, 3, 3)) != ship->get_topo_info(glm::ivec3(8, 3, 3)));
+    assert(topo_find(ship->get_topo_info(glm::ivec3(7, 3, 3))) ==
+           topo_find(ship->get_topo_info(glm::ivec3(8, 3, 3))));
+
+    /* partitioning the first room works out just its chunk's groups again,
+     * a time for each surface which couldn't be proved not to split it */
+    int solves = ship->num_chunk_solves;
+    size_t groups = first->groups.size();
+    partition(ship, 3);
+    assert(ship->num_chunk_solves - solves <= 2);
+    assert(first->groups.size() == groups + 1);
+    assert(ship->get_topo_info(glm::ivec3(3, 3, 3)) != ship->get_topo_info(glm::ivec3(4, 3, 3)));
+
+    /* a wall on the boundary between chunks changes only the portals */
+    solves = ship->num_chunk_solves;
+    partition(ship, 7);
+    assert(ship->num_chunk_solves == solves);
+    topo_info *slice = topo_find(ship->get_topo_info(glm::ivec3(7, 3, 3)));
+    topo_info *rest = topo_find(ship->get_topo_info(glm::ivec3(8, 3, 3)));
+    assert(slice != rest);
+    assert(slice->size == 36 && rest->size == 5 * 36);
+    assert(fabsf(ship->get_zone_info(slice)->air_amount - 20.0f * slice->size) < 1e-2f);
+
+    /* and opening them up again joins the groups back up */
+    ship->remove_surface(glm::ivec3(3, 3, 3), glm::ivec3(4, 3, 3), surface_xp);
+    assert(first->groups.size() == groups);
+    assert(ship->get_topo_info(glm::ivec3(3, 3, 3)) == ship->get_topo_info(glm::ivec3(4, 3, 3)));
+    ship->remove_surface(glm::ivec3(7, 3, 3), glm::ivec3(8, 3, 3), surface_xp);
+    assert(topo_find(ship->get_topo_info(glm::ivec3(7, 3, 3))) ==
+           topo_find(ship->get_topo_info(glm::ivec3(8, 3, 3))));
+
+    assert(ship->num_full_rebuilds == rebuilds);
+    assert(ship->validate());
+    delete ship;
+}
+
+/* a wall across the plane x = px|px+1, with holes in two opposite corners */
+static void
+partition_with_holes(ship_space *ship, int px)
+{
+    for (int z = 1; z < 7; z++) {
+        for (int y = 1; y < 7; y++) {
+            glm::ivec3 a(px, y, z);
+            ship->set_block_type(a, block_support);
+            if ((y == 1 && z == 1) || (y == 6 && z == 6))
+                continue;
+
+            ship->set_surface(a, a + glm::ivec3(1, 0, 0), surface_xp, surface_wall);
+        }
+    }
+}
+
+void
+bounded_nosplits(void)
+{
+    /* filling in one of the holes in a partition leaves the way round
+     * through the other, too far off for a one-block detour; the bounded
+     * search finds it, within the chunk, without its groups being worked
+     * out again */
+    ship_space *ship = pressurized_ship();
+    partition_with_holes(ship, 3);
+    ship->nosplit_radius = CHUNK_SIZE;
+
+    int solves = ship->num_chunk_solves;
+    int fast = ship->num_fast_nosplits;
+    int bounded = ship->num_bounded_nosplits;
+    int visits = ship->num_bounded_visits;
+    ship->set_surface(glm::ivec3(3, 1, 1), glm::ivec3(4, 1, 1), surface_xp, surface_wall);
+    assert(ship->num_fast_nosplits == fast);
+    assert(ship->num_bounded_nosplits - bounded == 1);
+    assert(ship->num_bounded_visits > visits);
+    assert(ship->num_chunk_solves == solves);
+    assert(topo_find(ship->get_topo_info(glm::ivec3(3, 1, 1))) ==
+           topo_find(ship->get_topo_info(glm::ivec3(4, 1, 1))));
+
+    /* and across a chunk boundary, where the way round has to cross
+     * between the chunks somewhere else */
+    partition_with_holes(ship, 7);
+    bounded = ship->num_bounded_nosplits;
+    ship->set_surface(glm::ivec3(7, 1, 1), glm::ivec3(8, 1, 1), surface_xp, surface_wall);
+    assert(ship->num_bounded_nosplits - bounded == 1);
+    assert(topo_find(ship->get_topo_info(glm::ivec3(7, 1, 1))) ==
+           topo_find(ship->get_topo_info(glm::ivec3(8, 1, 1))));
+
+    /* the last hole really does split the room, which the search can't
+     * prove otherwise */
+    int misses = ship->num_bounded_misses;
+    int splits = ship->num_local_splits;
+    ship->set_surface(glm::ivec3(7, 6, 6), glm::ivec3(8, 6, 6), surface_xp, surface_wall);
+    assert(ship->num_bounded_misses - misses == 1);
+    assert(ship->num_local_splits - splits == 1);
+    assert(topo_find(ship->get_topo_info(glm::ivec3(7, 6, 6))) !=
+           topo_find(ship->get_topo_info(glm::ivec3(8, 6, 6))));
+    assert(ship->validate());
+    delete ship;
+
+    /* too small a radius gives up on the way round, and leaves it to
+     * working the chunk out again, which gets the same answer */
+    ship = pressurized_ship();
+    partition_with_holes(ship, 3);
+    ship->nosplit_radius = 2;
+
+    solves = ship->num_chunk_solves;
+    misses = ship->num_bounded_misses;
+    int nosplits = ship->num_local_nosplits;
+    ship->set_surface(glm::ivec3(3, 1, 1), glm::ivec3(4, 1, 1), surface_xp, surface_wall);
+    assert(ship->num_bounded_misses - misses == 1);
+    assert(ship->num_chunk_solves - solves == 1);
+    assert(ship->num_local_nosplits - nosplits == 1);
+    assert(ship->get_topo_info(glm::ivec3(3, 1, 1)) == ship->get_topo_info(glm::ivec3(4, 1, 1)));
+    delete ship;
+}
+
+static float
+total_air(ship_space *ship)
+{
+    float air = 0;
+    for (auto const &z : ship->zones) {
+        air += z.air_amount;
+    }
+
+    return air;
+}
+
+void
+seals(void)
+{
+    /* a bulkhead across the boundary between two chunks, walled in all
+     * round, is sealed right through, in both */
+    ship_space *ship = new ship_space;
+    glm::ivec3 lo(CHUNK_SIZE - 2, 1, 1), hi(CHUNK_SIZE + 1, 3, 3);
+    for (int k = lo.z; k <= hi.z; k++) {
+        for (int j = lo.y; j <= hi.y; j++) {
+            for (int i = lo.x; i <= hi.x; i++) {
+                glm::ivec3 p(i, j, k);
+                ship->ensure_block(p);
+                ship->set_block_type(p, block_support);
+                for (int face = 0; face < face_count; face++) {
+                    glm::ivec3 q = p + surface_index_to_normal(face);
+                    if (glm::min(q, lo) != lo || glm::max(q, hi) != hi) {
+                        ship->ensure_block(q);
+                        ship->set_surface(p, q, (surface_index)face, surface_wall);
+                    }
+                }
+            }
+        }
+    }
+
+    auto all_sealed = [&](bool sealed) {
+        for (int k = lo.z; k <= hi.z; k++) {
+            for (int j = lo.y; j <= hi.y; j++) {
+                for (int i = lo.x; i <= hi.x; i++) {
+                    chunk *c = ship->chunks.get(glm::ivec3(i >> CHUNK_SHIFT, 0, 0));
+                    if (c->sealed.test(i & CHUNK_MASK, j, k) != sealed)
+                        return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    chunk *a = ship->chunks.get(glm::ivec3(0, 0, 0));
+    ship->update_seals();
+    assert(all_sealed(true));
+
+    /* open at the far end, it can be seen into all the way back through
+     * the first chunk, which is to be meshed again */
+    a->render_chunk.valid = true;
+    ship->set_surface(hi, hi + glm::ivec3(1, 0, 0), surface_xp, surface_none);
+    ship->update_seals();
+    assert(all_sealed(false));
+    assert(!a->render_chunk.valid);
+
+    /* and shut again, sealed again */
+    ship->set_surface(hi, hi + glm::ivec3(1, 0, 0), surface_xp, surface_glass);
+    ship->update_seals();
+    assert(all_sealed(false));
+    ship->set_surface(hi, hi + glm::ivec3(1, 0, 0), surface_xp, surface_wall);
+    ship->update_seals();
+    assert(all_sealed(true));
+
+    /* nothing has changed since, so there is nothing to do */
+    a->render_chunk.valid = true;
+    ship->update_seals();
+    assert(a->render_chunk.valid);
+
+    delete ship;
+}
+
+void
+zone_ids(void)
+{
+    /* zones are numbered densely, and the root of each space knows its
+     * zone's id */
+    ship_space *ship = pressurized_ship();
+    topo_info *a = topo_find(ship->get_topo_info(glm::ivec3(3, 3, 3)));
+    topo_info *b = topo_find(ship->get_topo_info(glm::ivec3(9, 3, 3)));
+    assert(ship->zones.size() == 2);
+    assert(a->zone == 0 && b->zone == 1);
+    assert(ship->get_zone_info_at(glm::ivec3(3, 3, 3)) == &ship->zones[0]);
+    assert(ship->get_zone_info_at(glm::ivec3(9, 3, 3))->root == b);
+
+    /* the outside never has one */
+    assert(!ship->get_zone_info_at(glm::ivec3(0, 0, 0)));
+    assert(!ship->insert_zone(&ship->outside_topo_info, 1.0f));
+
+    /* a space split off gets the next id */
+    float air = total_air(ship);
+    partition(ship, 3);
+    assert(ship->zones.size() == 3);
+    assert(a->zone == 0 && b->zone == 1);
+    assert(fabsf(total_air(ship) - air) < 1e-2f);
+    assert(ship->validate());
+
+    /* removing a zone moves the last into its place */
+    topo_info *last = ship->zones[2].root;
+    float last_air = ship->zones[2].air_amount;
+    air -= ship->zones[0].air_amount;
+    ship->remove_zone(a);
+    assert(a->zone == -1 && last->zone == 0);
+    assert(ship->zones.size() == 2 && ship->zones[0].air_amount == last_air);
+    assert(!ship->get_zone_info(a));
+
+    /* joining spaces joins their zones, and a rebuild keeps the ids dense
+     * without losing any air */
+    ship->remove_surface(glm::ivec3(6, 3, 3), glm::ivec3(7, 3, 3), surface_xp);
+    assert(fabsf(total_air(ship) - air) < 1e-2f);
+    assert(ship->validate());
+
+    ship->rebuild_topology();
+    assert(fabsf(total_air(ship) - air) < 1e-2f);
+    assert(ship->validate());
+
+    /* and a space opened to the outside loses its air */
+    ship->remove_surface(glm::ivec3(9, 3, 6), glm::ivec3(9, 3, 7), surface_zp);
+    assert(!ship->get_zone_info_at(glm::ivec3(9, 3, 3)));
+    ship->rebuild_topology();
+    assert(!ship->get_zone_info_at(glm::ivec3(9, 3, 3)));
+    assert(ship->validate());
+
+    delete ship;
+}
+
+void
+doors(void)
+{
+    /* a door in the wall between the two rooms, shut */
+    ship_space *ship = pressurized_ship();
+    glm::ivec3 a(6, 3, 3), b(7, 3, 3);
+    ship->set_surface(a, b, surface_xp, surface_door);
+
+    topo_info *left = topo_find(ship->get_topo_info(a));
+    topo_info *right = topo_find(ship->get_topo_info(b));
+    float air = total_air(ship);
+    int rebuilds = ship->num_full_rebuilds;
+    int solves = ship->num_chunk_solves;
+    int unifys = ship->num_fast_unifys;
+
+    /* opening it pools the air of the rooms, but leaves them as separate
+     * spaces, each with its own zone */
+    ship->set_surface(a, b, surface_xp, surface_door_open);
+    assert(ship->open_doors.size() == 1);
+    assert(topo_find(ship->get_topo_info(a)) == left);
+    assert(topo_find(ship->get_topo_info(b)) == right);
+    assert(ship->zones.size() == 2);
+    float density = air / (left->size + right->size);
+    assert(fabsf(ship->get_zone_info(left)->air_amount - density * left->size) < 1e-2f);
+    assert(fabsf(ship->get_zone_info(right)->air_amount - density * right->size) < 1e-2f);
+
+    /* air let into one side mixes through to the other */
+    ship->get_zone_info(left)->air_amount += 100.0f;
+    ship->mix_air();
+    density = (air + 100.0f) / (left->size + right->size);
+    assert(fabsf(ship->get_zone_info(right)->air_amount - density * right->size) < 1e-2f);
+
+    /* shutting it leaves each with what it has */
+    ship->set_surface(a, b, surface_xp, surface_door);
+    assert(ship->open_doors.empty());
+    ship->get_zone_info(left)->air_amount += 100.0f;
+    ship->mix_air();
+    assert(fabsf(ship->get_zone_info(right)->air_amount - density * right->size) < 1e-2f);
+
+    /* none of which touched the topology */
+    assert(ship->num_full_rebuilds == rebuilds);
+    assert(ship->num_chunk_solves == solves);
+    assert(ship->num_fast_unifys == unifys);
+
+    /* a rebuild finds the open doors again */
+    ship->set_surface(a, b, surface_xp, surface_door_open);
+    ship->open_doors.clear();
+    ship->rebuild_topology();
+    assert(ship->open_doors.size() == 1);
+    assert(ship->open_doors.begin()->first == a && ship->open_doors.begin()->second == 1);
+
+    /* and a door open to the outside vents the room, and then the one
+     * through the door from it */
+    glm::ivec3 c(9, 3, 6), d(9, 3, 7);
+    ship->set_surface(c, d, surface_zp, surface_door);
+    ship->set_surface(c, d, surface_zp, surface_door_open);
+    assert(!ship->get_zone_info_at(c));
+    for (int tick = 0; tick < 1000 && ship->get_zone_info_at(a); tick++) {
+        ship->mix_air();
+    }
+    assert(!ship->get_zone_info_at(a) && !ship->get_zone_info_at(b));
+    assert(ship->validate());
+
+    delete ship;
+}
+
+void
+vents(void)
+{
+    /* two vents in the wall between the rooms link them, without touching
+     * the topology */
+    ship_space *ship = pressurized_ship();
+    glm::ivec3 a(6, 3, 3), b(7, 3, 3);
+    ship->set_surface(a, b, surface_xp, surface_vent);
+    ship->set_surface(a + glm::ivec3(0, 1, 0), b + glm::ivec3(0, 1, 0), surface_xp, surface_vent);
+    ship->mix_air();
+    assert(ship->vents.size() == 2);
+    assert(ship->links.a.size() == 1);
+    assert(ship->links.vents[0] == 2 && ship->links.doors[0] == 0);
+
+    topo_info *left = topo_find(ship->get_topo_info(a));
+    topo_info *right = topo_find(ship->get_topo_info(b));
+    assert(left != right);
+
+    /* the air goes from high pressure to low, a little at a time, and
+     * none is lost on the way */
+    float air = total_air(ship);
+    float before = ship->get_zone_info(right)->air_amount / right->size;
+    ship->mix_air();
+    float after_left = ship->get_zone_info(left)->air_amount / left->size;
+    float after_right = ship->get_zone_info(right)->air_amount / right->size;
+    assert(after_right < before && after_left < after_right);
+    assert(fabsf(total_air(ship) - air) < 1e-1f);
+
+    for (int tick = 0; tick < 1000; tick++) {
+        ship->mix_air();
+    }
+    float density = air / (left->size + right->size);
+    assert(fabsf(ship->get_zone_info(left)->air_amount - density * left->size) < 1e-1f);
+    assert(fabsf(ship->get_zone_info(right)->air_amount - density * right->size) < 1e-1f);
+
+    /* the links keep up with vents and doors coming and going */
+    ship->set_surface(a, b, surface_xp, surface_wall);
+    assert(!ship->links.stale);
+    assert(ship->links.vents[0] == 1);
+    ship->set_surface(a, b, surface_xp, surface_door);
+    ship->set_surface(a, b, surface_xp, surface_door_open);
+    assert(ship->links.vents[0] == 1 && ship->links.doors[0] == 1);
+    ship->set_surface(a + glm::ivec3(0, 1, 0), b + glm::ivec3(0, 1, 0), surface_xp, surface_wall);
+    ship->set_surface(a, b, surface_xp, surface_door);
+    assert(ship->links.a.empty());
+
+    /* and a hole in the wall makes the rooms one space, which needs no
+     * link; they're found again on the next tick */
+    ship->set_surface(a, b, surface_xp, surface_vent);
+    assert(ship->links.a.size() == 1);
+    ship->remove_surface(a + glm::ivec3(0, 0, 1), b + glm::ivec3(0, 0, 1), surface_xp);
+    assert(ship->links.stale);
+    ship->mix_air();
+    assert(!ship->links.stale && ship->links.a.empty());
+    assert(ship->vents.size() == 1);
+
+    assert(ship->validate());
+    delete ship;
+}
+
+/* rooms of 6x6x6 blocks on a grid of n x n chunks, each room with a zone,
+ * some of them joined up and some open to the outside */
+static ship_space *
+room_grid(int n, unsigned threads)
+{
+    ship_space *ship = new ship_space;
+    ship->set_worker_threads(threads);
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            ship->ensure_chunk(glm::ivec3(x, y, 0));
+        }
+    }
+
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            glm::ivec3 lo(8 * x + 1, 8 * y + 1, 1);
+            seal_box(ship, lo, lo + glm::ivec3(5, 5, 5));
+        }
+    }
+    ship->rebuild_topology();
+
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            topo_info *t = topo_find(ship->get_topo_info(glm::ivec3(8 * x + 3, 8 * y + 3, 3)));
+            ship->insert_zone(t, (float)(x + n * y) * t->size);
+        }
+    }
+
+    /* join some rooms to their neighbour with a sealed tunnel, and open
+     * some up to the outside */
+    srand(2);
+    for (int i = 0; i < n * n; i++) {
+        glm::ivec3 p(8 * (rand() % (n - 1)) + 6, 8 * (rand() % n) + 1 + rand() % 6, 1 + rand() % 6);
+        glm::ivec3 dx(1, 0, 0);
+        if (rand() % 4) {
+            seal_box(ship, p + dx, p + dx + dx);
+            ship->remove_surface(p + dx + dx, p + dx + dx + dx, surface_xp);
+        }
+        ship->remove_surface(p, p + dx, surface_xp);
+    }
+
+    return ship;
+}
+
+void
+worker_threads(void)
+{
+    /* a rebuild spread across threads finds the same spaces, and shares
+     * out the air the same way, as one on a single thread, however the
+     * chunks are split up between them */
+    const int n = 8;
+    ship_space *serial = room_grid(n, 1);
+    serial->rebuild_topology();
+    assert(!serial->workers);
+
+    unsigned counts[] = { 2, 3, 8 };
+    for (auto threads : counts) {
+        ship_space *ship = room_grid(n, threads);
+        ship->rebuild_topology();
+
+        assert(ship->workers->size() == threads);
+        assert(same_spaces(serial, ship, glm::ivec3(0, 0, 0), glm::ivec3(8 * n - 1, 8 * n - 1, 7)));
+        assert(topo_find(&ship->outside_topo_info) == &ship->outside_topo_info);
+        assert(ship->zones.size() == serial->zones.size());
+
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                glm::ivec3 p(8 * x + 3, 8 * y + 3, 3);
+                zone_info *a = serial->get_zone_info(topo_find(serial->get_topo_info(p)));
+                zone_info *b = ship->get_zone_info(topo_find(ship->get_topo_info(p)));
+                assert(!a == !b);
+                assert(!a || fabsf(a->air_amount - b->air_amount) < 1e-2f);
+            }
+        }
+
+        /* and a second rebuild changes nothing */
+        ship->rebuild_topology();
+        assert(same_spaces(serial, ship, glm::ivec3(0, 0, 0), glm::ivec3(8 * n - 1, 8 * n - 1, 7)));
+        assert(ship->validate());
+        delete ship;
+    }
+
+    delete serial;
+}
+
 int
 main(void)
 {
     simple();
     ensure();
+    cursor();
+    raycasts();
+    chunk_boundaries();
+    transactions();
+    journal();
+    snapshots();
+    undo_redo();
+    implicit_chunks();
+    seals();
+    local_splits();
+    chunk_groups();
+    bounded_nosplits();
+    zone_ids();
+    doors();
+    vents();
+    worker_threads();
 }
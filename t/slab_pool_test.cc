@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <assert.h>
+#include "../src/slab_pool.h"
+
+struct thing {
+    int a, b, c;
+};
+
+void
+recycle(void)
+{
+    slab_pool<thing, 4> pool;
+    void *p[6];
+
+    for (int i = 0; i < 6; i++) {
+        p[i] = pool.alloc();
+        assert(p[i]);
+    }
+
+    /* 6 objects at 4 per slab */
+    assert(pool.stats.slabs == 2);
+    assert(pool.stats.live == 6);
+
+    /* objects from one slab are contiguous */
+    assert((char *)p[1] - (char *)p[0] == (char *)p[2] - (char *)p[1]);
+
+    pool.free(p[3]);
+    pool.free(p[1]);
+    assert(pool.stats.live == 4);
+    assert(pool.stats.peak == 6);
+
+    /* freed slots come back, most recent first, without a new slab */
+    assert(pool.alloc() == p[1]);
+    assert(pool.alloc() == p[3]);
+    assert(pool.stats.slabs == 2);
+    assert(pool.stats.allocs == 8);
+    assert(pool.stats.frees == 2);
+}
+
+int
+main(void)
+{
+    recycle();
+}